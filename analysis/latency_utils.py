@@ -171,6 +171,44 @@ def remove_clock_drift(df: pd.DataFrame, window_size: int = 1000) -> tuple[pd.Da
     return _drift_result(result, raw - slope * elapsed, slope, True)
 
 
+def load_clock_log(filepath: os.PathLike[str] | str) -> pd.DataFrame:
+    """Load a receiver ``--clock-log`` CSV (clock-v1), one completed round per row.
+
+    ``estimated_offset_ns`` is the receiver's CLOCK_REALTIME minus the sender's,
+    filtered over recent low-delay rounds, as of ``t2_receiver_unix_ns``.
+    """
+    path = Path(filepath)
+    if not path.exists():
+        raise FileNotFoundError(f"File not found: {path}")
+    frame = pd.read_csv(path, comment="#")
+    required = {"t2_receiver_unix_ns", "estimated_offset_ns", "delay_ns"}
+    if not required <= set(frame.columns):
+        raise ValueError(f"Not a clock-v1 log: {path}")
+    return frame.sort_values("t2_receiver_unix_ns", ignore_index=True)
+
+
+def apply_clock_log(df: pd.DataFrame, clock: pd.DataFrame) -> pd.DataFrame:
+    """Correct one-way latency with the in-band offset estimates.
+
+    The offset is interpolated linearly at each record's ``rx_ns`` and held
+    flat outside the logged rounds; ``receive_latency_synced_ns`` is the
+    receive latency with it removed.  With no rounds the column is left
+    missing, so an unsynchronized run cannot pass for a corrected one.
+    """
+    if "rx_ns" not in df.columns or "receive_latency_ns" not in df.columns:
+        raise ValueError("Dataframe is missing rx_ns or receive_latency_ns")
+    result = df.copy()
+    if clock.empty:
+        result["clock_offset_ns"] = np.nan
+    else:
+        result["clock_offset_ns"] = np.interp(
+            pd.to_numeric(result["rx_ns"]).astype("float64"),
+            clock["t2_receiver_unix_ns"].astype("float64"),
+            clock["estimated_offset_ns"].astype("float64"))
+    result["receive_latency_synced_ns"] = result["receive_latency_ns"] - result["clock_offset_ns"]
+    return result
+
+
 def require_corrected_latency(df: pd.DataFrame) -> None:
     if "latency_corrected_us" not in df.columns:
         raise ValueError("Clock-drift processing did not produce latency_corrected_us")
@@ -105,7 +105,7 @@ done
 
 if [[ ${ROLE} == receiver ]]; then
   : > "${SNAPSHOT}/capabilities"
-  for binary in receiver_baseline receiver_batched receiver_threaded; do
+  for binary in receiver receiver_baseline receiver_batched receiver_threaded; do
     path="${PROJECT_ROOT}/build/${BUILD_SUBDIR}/${binary}"
     [[ -x ${path} ]] || { echo "Missing final receiver binary: ${path}" >&2; exit 1; }
     previous=$(getcap -n "${path}" | cut -d' ' -f2-)
@@ -0,0 +1,135 @@
+// Measures what each timestamp source costs and how finely it resolves.
+//
+// The receivers stamp every batch and every sampled packet, and the sender
+// stamps every syscall, so the clock read is itself part of the per-packet
+// budget under test. This reports, per source, the mean cost of a back-to-back
+// read and the smallest nonzero step between consecutive reads (the observed
+// resolution), then holds the calibrated cycle clock against CLOCK_MONOTONIC_RAW
+// for a while to show how far it drifts between re-anchors.
+//
+// Usage: clock_bench [cpu] [reads] [drift_seconds]
+
+#include "common/thread_utils.hpp"
+#include "common/time.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+namespace {
+
+struct Result {
+  double ns_per_read;
+  std::uint64_t resolution;
+};
+
+// The running sum is printed, so the compiler cannot drop the reads.
+std::uint64_t sink = 0;
+
+template <typename Read>
+Result measure(Read read, std::uint64_t reads) {
+  std::uint64_t resolution = ~0ULL;
+  auto previous = read();
+  const auto started = nll::mono_ns();
+  for (std::uint64_t index = 0; index < reads; ++index) {
+    const auto value = read();
+    if (value > previous && value - previous < resolution) resolution = value - previous;
+    sink += value;
+    previous = value;
+  }
+  const auto elapsed = nll::mono_ns() - started;
+  return {static_cast<double>(elapsed) / static_cast<double>(reads),
+          resolution == ~0ULL ? 0 : resolution};
+}
+
+std::uint64_t clock_ns(clockid_t clock) noexcept {
+  timespec ts;
+  clock_gettime(clock, &ts);
+  return static_cast<std::uint64_t>(ts.tv_sec) * nll::a_billi +
+         static_cast<std::uint64_t>(ts.tv_nsec);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int cpu = argc > 1 ? std::atoi(argv[1]) : -1;
+  const std::uint64_t reads = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10'000'000;
+  const double drift_seconds = argc > 3 ? std::atof(argv[3]) : 3.0;
+  if (reads == 0) {
+    std::fprintf(stderr, "Usage: clock_bench [cpu] [reads] [drift_seconds]\n");
+    return 2;
+  }
+  if (cpu >= 0) nll::thread::pin_to_core(cpu);
+
+  const bool calibrated = nll::select_timestamp_source(nll::ClockSource::cycles);
+  const auto &clock = nll::timestamp_clock;
+  std::printf("{\n  \"cpu\": %d,\n  \"reads\": %llu,\n  \"cycle_counter\": {\"available\": %s, "
+              "\"frequency_hz\": %.1f, \"resolution_ns\": %.3f},\n  \"sources\": [\n",
+              cpu, static_cast<unsigned long long>(reads), calibrated ? "true" : "false",
+              clock.frequency_hz(), clock.resolution_ns());
+
+  // Resolution is in the source's own unit: ticks for the raw counter,
+  // nanoseconds for everything else.
+  const struct {
+    const char *name;
+    const char *unit;
+    bool needs_counter;
+    Result (*run)(std::uint64_t);
+  } sources[] = {
+      {"clock_gettime_monotonic_raw", "ns", false,
+       [](std::uint64_t n) { return measure([] { return clock_ns(CLOCK_MONOTONIC_RAW); }, n); }},
+      {"clock_gettime_monotonic", "ns", false,
+       [](std::uint64_t n) { return measure([] { return clock_ns(CLOCK_MONOTONIC); }, n); }},
+      {"clock_gettime_realtime", "ns", false,
+       [](std::uint64_t n) { return measure([] { return clock_ns(CLOCK_REALTIME); }, n); }},
+      {"clock_gettime_monotonic_coarse", "ns", false,
+       [](std::uint64_t n) { return measure([] { return clock_ns(CLOCK_MONOTONIC_COARSE); }, n); }},
+      {"raw_counter", "ticks", true,
+       [](std::uint64_t n) { return measure(nll::read_cycles, n); }},
+      {"cycle_clock_mono", "ns", true,
+       [](std::uint64_t n) { return measure([] { return nll::timestamp_clock.mono_ns(); }, n); }},
+      {"cycle_clock_real", "ns", true,
+       [](std::uint64_t n) { return measure([] { return nll::timestamp_clock.real_ns(); }, n); }},
+  };
+  bool first = true;
+  for (const auto &source : sources) {
+    if (source.needs_counter && !calibrated) continue;
+    const auto result = source.run(reads);
+    std::printf("%s    {\"source\": \"%s\", \"ns_per_read\": %.3f, \"resolution\": %llu, "
+                "\"resolution_unit\": \"%s\"}",
+                first ? "" : ",\n", source.name, result.ns_per_read,
+                static_cast<unsigned long long>(result.resolution), source.unit);
+    first = false;
+  }
+  std::printf("\n  ],\n");
+
+  // Drift: compare against CLOCK_MONOTONIC_RAW every 100 ms without re-anchoring,
+  // then once more after re-anchoring at that spacing. The first figure is what
+  // a run would see if the owner thread never maintained the clock; reanchor()
+  // slews rather than steps, so the second is taken one interval later.
+  long long worst_error = 0;
+  const auto steps = static_cast<int>(drift_seconds * 10.0);
+  for (int step = 0; calibrated && step < steps; ++step) {
+    nll::sleep_ns(100'000'000ULL);
+    const auto reference = nll::mono_ns();
+    const auto stamp = clock.mono_ns();
+    const auto error = static_cast<long long>(stamp) - static_cast<long long>(reference);
+    if (std::llabs(error) > std::llabs(worst_error)) worst_error = error;
+  }
+  long long reanchored_error = 0;
+  if (calibrated) {
+    for (int round = 0; round < 2; ++round) {
+      nll::timestamp_clock.reanchor();
+      nll::sleep_ns(100'000'000ULL);
+    }
+    const auto reference = nll::mono_ns();
+    reanchored_error = static_cast<long long>(clock.mono_ns()) - static_cast<long long>(reference);
+  }
+  std::printf("  \"drift\": {\"seconds\": %.1f, \"worst_error_ns\": %lld, "
+              "\"error_after_reanchor_ns\": %lld, \"reanchor_correction_ns\": %llu},\n",
+              drift_seconds, worst_error, reanchored_error,
+              static_cast<unsigned long long>(clock.max_correction_ns()));
+  std::printf("  \"checksum\": %llu\n}\n", static_cast<unsigned long long>(sink & 0xFFFF));
+  return 0;
+}
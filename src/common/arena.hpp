@@ -0,0 +1,231 @@
+#pragma once
+
+#include "common/log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nll::memory {
+
+// Pre-faulted, optionally hugepage-backed memory for hot-path buffers.
+//
+// Receive slots, mmsghdr arrays, the SPSC ring and the sender's payload slabs
+// used to be ordinary heap allocations. Their pages were first touched inside
+// the timed interval, so the opening milliseconds of every run paid minor
+// faults, and a 2 MiB receive buffer spread over 512 base pages kept missing
+// in the TLB. An Arena is sized once, before timing starts, by summing what
+// each component asks for. It is mapped in one piece, preferring:
+//
+//   hugetlb  MAP_HUGETLB: explicit 2 MiB pages from the reserved pool
+//            (vm.nr_hugepages); fails if the pool is empty
+//   thp      2 MiB-aligned anonymous memory with MADV_HUGEPAGE, which
+//            transparent hugepages may back when
+//            /sys/kernel/mm/transparent_hugepage/enabled allows it
+//   normal   base pages
+//
+// "auto" tries them in that order. Every mapping is populated with
+// MAP_POPULATE and then mlock()ed where RLIMIT_MEMLOCK allows, so no page is
+// faulted in or reclaimed during the run. Allocation is a bump pointer; memory
+// is returned only when the arena is destroyed, and objects with non-trivial
+// destructors are destroyed then, in reverse order of construction.
+enum class PagePolicy : std::uint8_t { automatic, hugetlb, thp, normal };
+
+inline constexpr std::size_t huge_page_bytes = 2U << 20;
+
+inline const char *page_policy_name(PagePolicy policy) noexcept {
+  switch (policy) {
+  case PagePolicy::automatic: return "auto";
+  case PagePolicy::hugetlb: return "hugetlb";
+  case PagePolicy::thp: return "thp";
+  case PagePolicy::normal: return "normal";
+  }
+  return "unknown";
+}
+
+inline std::optional<PagePolicy> parse_page_policy(std::string_view text) noexcept {
+  if (text == "auto") return PagePolicy::automatic;
+  if (text == "hugetlb") return PagePolicy::hugetlb;
+  if (text == "thp") return PagePolicy::thp;
+  if (text == "normal") return PagePolicy::normal;
+  return std::nullopt;
+}
+
+constexpr std::size_t align_up(std::size_t value, std::size_t alignment) noexcept {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Bytes a component will take from an arena, padded for alignment, so callers
+// can size the arena by summing these before creating it.
+template <typename T>
+constexpr std::size_t bytes_for(std::size_t count = 1) noexcept {
+  return align_up(sizeof(T) * count + alignof(T), alignof(std::max_align_t));
+}
+
+struct ArenaReport {
+  PagePolicy requested = PagePolicy::automatic;
+  PagePolicy backing = PagePolicy::normal;  // what the mapping actually uses
+  std::size_t mapped_bytes = 0;
+  std::size_t used_bytes = 0;
+  bool locked = false;
+};
+
+class Arena {
+public:
+  Arena(std::size_t bytes, PagePolicy policy) {
+    report_.requested = policy;
+    const auto size = align_up(std::max<std::size_t>(bytes, 1), huge_page_bytes);
+    if (policy == PagePolicy::automatic || policy == PagePolicy::hugetlb) {
+      if (map(size, MAP_HUGETLB)) report_.backing = PagePolicy::hugetlb;
+      else if (policy == PagePolicy::hugetlb)
+        NLL_WARN("MAP_HUGETLB arena of %zu bytes failed (%s); falling back\n", size,
+                 std::strerror(errno));
+    }
+    if (!base_ && policy != PagePolicy::normal) {
+      if (map_aligned(size)) report_.backing = PagePolicy::thp;
+    }
+    if (!base_ && map(size, 0)) report_.backing = PagePolicy::normal;
+    if (!base_) throw std::bad_alloc();
+    report_.mapped_bytes = size;
+    // Locking is best-effort: without CAP_IPC_LOCK the default 8 MiB
+    // RLIMIT_MEMLOCK may be too small, and MAP_POPULATE has already faulted
+    // every page in.
+    report_.locked = ::mlock(base_, size) == 0;
+  }
+
+  ~Arena() {
+    for (auto it = destructors_.rbegin(); it != destructors_.rend(); ++it) it->destroy(it->object);
+    if (base_) ::munmap(base_, report_.mapped_bytes);
+  }
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  [[nodiscard]] void *allocate(std::size_t bytes, std::size_t alignment) {
+    const auto start = align_up(report_.used_bytes, alignment);
+    if (start + bytes > report_.mapped_bytes) throw std::bad_alloc();
+    report_.used_bytes = start + bytes;
+    return static_cast<std::byte *>(base_) + start;
+  }
+
+  template <typename T, typename... Args>
+  T &make(Args &&...args) {
+    auto *object = ::new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    if constexpr (!std::is_trivially_destructible_v<T>)
+      destructors_.push_back({object, [](void *pointer) { static_cast<T *>(pointer)->~T(); }});
+    return *object;
+  }
+
+  // Value-initialized; restricted to trivial types so nothing needs destroying.
+  template <typename T>
+  std::span<T> make_array(std::size_t count) {
+    static_assert(std::is_trivially_destructible_v<T>);
+    auto *first = static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+    std::uninitialized_value_construct_n(first, count);
+    return {first, count};
+  }
+
+  [[nodiscard]] const ArenaReport &report() const noexcept { return report_; }
+
+private:
+  struct Destructor {
+    void *object;
+    void (*destroy)(void *);
+  };
+
+  bool map(std::size_t size, int extra_flags) noexcept {
+    void *memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE | extra_flags, -1, 0);
+    if (memory == MAP_FAILED) return false;
+    base_ = memory;
+    return true;
+  }
+
+  // THP can only back 2 MiB-aligned ranges, and the advice has to precede
+  // the first touch, so populate with MADV_POPULATE_WRITE after madvise rather
+  // than with MAP_POPULATE.
+  bool map_aligned(std::size_t size) noexcept {
+    const auto reserved = size + huge_page_bytes;
+    void *memory = ::mmap(nullptr, reserved, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED) return false;
+    const auto address = reinterpret_cast<std::uintptr_t>(memory);
+    const auto aligned = align_up(address, huge_page_bytes);
+    if (aligned > address) ::munmap(memory, aligned - address);
+    const auto tail = address + reserved - (aligned + size);
+    if (tail) ::munmap(reinterpret_cast<void *>(aligned + size), tail);
+    base_ = reinterpret_cast<void *>(aligned);
+    if (::madvise(base_, size, MADV_HUGEPAGE) != 0) {
+      ::munmap(base_, size);
+      base_ = nullptr;
+      return false;
+    }
+#ifdef MADV_POPULATE_WRITE
+    if (::madvise(base_, size, MADV_POPULATE_WRITE) == 0) return true;
+#endif
+    auto *bytes = static_cast<volatile std::byte *>(base_);
+    for (std::size_t offset = 0; offset < size; offset += 4096) bytes[offset] = std::byte{0};
+    return true;
+  }
+
+  void *base_ = nullptr;
+  ArenaReport report_;
+  std::vector<Destructor> destructors_;
+};
+
+// Page faults taken between start() and stop(), from getrusage(). Scope is
+// RUSAGE_THREAD for one loop or RUSAGE_SELF for every thread of the process.
+struct PageFaults {
+  std::uint64_t minor = 0;
+  std::uint64_t major = 0;
+};
+
+class FaultCounter {
+public:
+  explicit FaultCounter(int scope) noexcept : scope_(scope) {}
+  void start() noexcept { start_ = read(); }
+  [[nodiscard]] PageFaults stop() const noexcept {
+    const auto end = read();
+    return {end.minor - start_.minor, end.major - start_.major};
+  }
+
+private:
+  [[nodiscard]] PageFaults read() const noexcept {
+    rusage usage{};
+    if (::getrusage(scope_, &usage) != 0) return {};
+    return {static_cast<std::uint64_t>(usage.ru_minflt), static_cast<std::uint64_t>(usage.ru_majflt)};
+  }
+
+  int scope_;
+  PageFaults start_;
+};
+
+inline void accumulate(PageFaults &total, const PageFaults &part) noexcept {
+  total.minor += part.minor;
+  total.major += part.major;
+}
+
+// Writes the "arena" and "page_faults" members of a stats object.
+inline void write_json(std::FILE *file, const ArenaReport &arena, const PageFaults &faults) {
+  std::fprintf(file, "  \"arena\": {\"requested\": \"%s\", \"backing\": \"%s\", "
+      "\"mapped_bytes\": %zu, \"used_bytes\": %zu, \"locked\": %s},\n",
+      page_policy_name(arena.requested), page_policy_name(arena.backing), arena.mapped_bytes,
+      arena.used_bytes, arena.locked ? "true" : "false");
+  std::fprintf(file, "  \"page_faults\": {\"minor\": %llu, \"major\": %llu},\n",
+               static_cast<unsigned long long>(faults.minor),
+               static_cast<unsigned long long>(faults.major));
+}
+
+} // namespace nll::memory
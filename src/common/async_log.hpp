@@ -0,0 +1,324 @@
+#pragma once
+
+#include "common/spsc_queue.hpp"
+#include "common/time.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+namespace nll::log {
+
+// Asynchronous backend for the NLL_* macros.
+//
+// vlogf formats and writes on the calling thread, so one warning from a send
+// or receive loop costs a vfprintf and a stderr write, plus a mutex with
+// NLL_LOG_THREADSAFE. Here the calling thread only copies the timestamp, the
+// level, the format pointer and the raw arguments into a fixed 256-byte
+// record on its own SPSC ring; a background thread renders the format and
+// writes the line. Format strings must outlive the process (the macros are
+// always called with literals); %s arguments are copied into the record, and
+// truncated once its string space runs out. A full ring drops the record and
+// counts it rather than waiting.
+enum class ArgKind : std::uint8_t {
+  int_value, unsigned_value, long_value, unsigned_long_value, long_long_value,
+  unsigned_long_long_value, double_value, string, null_string, pointer
+};
+
+struct LogRecord {
+  static constexpr std::size_t max_args = 8;
+  static constexpr std::size_t string_capacity = 160;
+
+  std::uint64_t mono_ns = 0;
+  const char *format = nullptr;
+  std::uint8_t level = 0;
+  std::uint8_t arg_count = 0;
+  std::uint8_t string_bytes = 0;
+  std::array<ArgKind, max_args> kinds{};
+  std::array<std::uint64_t, max_args> args{};  // value bits, or a string offset
+  char strings[string_capacity];
+};
+static_assert(sizeof(LogRecord) == 256);
+
+namespace detail {
+
+// The kind a printf argument of type T is read back as: its default argument
+// promotion, so the conversion in the format sees exactly what it was given.
+template <typename T> consteval ArgKind kind_of() {
+  using D = std::decay_t<T>;
+  if constexpr (std::is_enum_v<D>) return kind_of<std::underlying_type_t<D>>();
+  else if constexpr (std::is_same_v<D, char *> || std::is_same_v<D, const char *>) return ArgKind::string;
+  else if constexpr (std::is_pointer_v<D> || std::is_null_pointer_v<D>) return ArgKind::pointer;
+  else if constexpr (std::is_floating_point_v<D>) {
+    static_assert(!std::is_same_v<D, long double>, "long double is not captured");
+    return ArgKind::double_value;
+  } else if constexpr (std::is_same_v<D, unsigned int>) return ArgKind::unsigned_value;
+  else if constexpr (std::is_same_v<D, long>) return ArgKind::long_value;
+  else if constexpr (std::is_same_v<D, unsigned long>) return ArgKind::unsigned_long_value;
+  else if constexpr (std::is_same_v<D, long long>) return ArgKind::long_long_value;
+  else if constexpr (std::is_same_v<D, unsigned long long>) return ArgKind::unsigned_long_long_value;
+  else {
+    static_assert(std::is_integral_v<D> && sizeof(D) < sizeof(long), "unsupported log argument");
+    return ArgKind::int_value;  // bool, char, short and int promote to int
+  }
+}
+
+template <typename T> void capture(LogRecord &record, const T &value) noexcept {
+  constexpr auto kind = kind_of<T>();
+  const auto index = record.arg_count++;
+  record.kinds[index] = kind;
+  if constexpr (kind == ArgKind::string) {
+    const char *text = value;
+    if constexpr (!std::is_array_v<T>)
+      if (text == nullptr) { record.kinds[index] = ArgKind::null_string; return; }
+    const std::size_t offset = record.string_bytes;
+    const std::size_t room = LogRecord::string_capacity - offset;
+    if (room == 0) { record.args[index] = LogRecord::string_capacity - 1; return; }
+    const std::size_t length = ::strnlen(text, room - 1);
+    std::memcpy(record.strings + offset, text, length);
+    record.strings[offset + length] = '\0';
+    record.args[index] = offset;
+    record.string_bytes = static_cast<std::uint8_t>(offset + length + 1);
+  } else if constexpr (kind == ArgKind::pointer) {
+    record.args[index] = reinterpret_cast<std::uintptr_t>(static_cast<const void *>(value));
+  } else if constexpr (kind == ArgKind::double_value) {
+    record.args[index] = std::bit_cast<std::uint64_t>(static_cast<double>(value));
+  } else {
+    record.args[index] = static_cast<std::uint64_t>(value);
+  }
+}
+
+} // namespace detail
+
+// Renders record's format with its captured arguments into out, always
+// NUL-terminated; returns the length written. Each conversion is handed to
+// snprintf with the argument read back as the type it was passed as.
+inline std::size_t render(const LogRecord &record, char *out, std::size_t size) noexcept {
+  if (size == 0) return 0;
+  std::size_t used = 0;
+  std::size_t next_arg = 0;
+  const auto put = [&](const char *text, std::size_t length) {
+    const auto count = std::min(length, size - 1 - used);
+    std::memcpy(out + used, text, count);
+    used += count;
+  };
+  const auto arg_int = [&](int &value) {
+    if (next_arg >= record.arg_count) return false;
+    value = static_cast<int>(record.args[next_arg++]);
+    return true;
+  };
+  for (const char *cursor = record.format; *cursor != '\0' && used + 1 < size;) {
+    if (*cursor != '%') {
+      const char *percent = std::strchr(cursor, '%');
+      const auto length = percent ? static_cast<std::size_t>(percent - cursor) : std::strlen(cursor);
+      put(cursor, length);
+      cursor += length;
+      continue;
+    }
+    if (cursor[1] == '%') { put("%", 1); cursor += 2; continue; }
+    // %[flags][width][.precision][length]conversion, copied out as its own format.
+    const char *end = cursor + 1;
+    int stars[2] = {};
+    int star_count = 0;
+    bool usable = true;
+    while (*end != '\0' && std::strchr("-+ #0", *end)) ++end;
+    for (int part = 0; part < 2; ++part) {
+      if (part == 1) { if (*end != '.') break; ++end; }
+      if (*end == '*') { usable = usable && arg_int(stars[star_count++]); ++end; }
+      else while (*end >= '0' && *end <= '9') ++end;
+    }
+    while (*end != '\0' && std::strchr("hlLqjzt", *end)) ++end;
+    if (*end == '\0') { put(cursor, std::strlen(cursor)); break; }
+    ++end;
+    char spec[32];
+    const auto spec_length = static_cast<std::size_t>(end - cursor);
+    if (!usable || spec_length >= sizeof(spec) || next_arg >= record.arg_count || end[-1] == 'n') {
+      put(cursor, spec_length);
+      cursor = end;
+      continue;
+    }
+    std::memcpy(spec, cursor, spec_length);
+    spec[spec_length] = '\0';
+    cursor = end;
+    const auto index = next_arg++;
+    const auto bits = record.args[index];
+    const auto print = [&](auto value) {
+      char *target = out + used;
+      const auto room = size - used;
+      int written = 0;
+      if (star_count == 0) written = std::snprintf(target, room, spec, value);
+      else if (star_count == 1) written = std::snprintf(target, room, spec, stars[0], value);
+      else written = std::snprintf(target, room, spec, stars[0], stars[1], value);
+      if (written > 0) used += std::min(static_cast<std::size_t>(written), room - 1);
+    };
+    switch (record.kinds[index]) {
+    case ArgKind::int_value: print(static_cast<int>(bits)); break;
+    case ArgKind::unsigned_value: print(static_cast<unsigned int>(bits)); break;
+    case ArgKind::long_value: print(static_cast<long>(bits)); break;
+    case ArgKind::unsigned_long_value: print(static_cast<unsigned long>(bits)); break;
+    case ArgKind::long_long_value: print(static_cast<long long>(bits)); break;
+    case ArgKind::unsigned_long_long_value: print(static_cast<unsigned long long>(bits)); break;
+    case ArgKind::double_value: print(std::bit_cast<double>(bits)); break;
+    case ArgKind::string: print(static_cast<const char *>(record.strings + bits)); break;
+    case ArgKind::null_string: print("(null)"); break;
+    case ArgKind::pointer: print(reinterpret_cast<const void *>(static_cast<std::uintptr_t>(bits))); break;
+    }
+  }
+  out[used] = '\0';
+  return used;
+}
+
+// Writes one rendered line; the synchronous path and the backend share it.
+using LineSink = void (*)(std::FILE *, int level, std::uint64_t mono_ns, const char *text);
+
+// Per-thread rings feeding one writer thread.
+//
+// A thread's ring is allocated by register_thread(), which the send and
+// receive loops call after pinning so neither the registration mutex nor the
+// 128 KiB allocation lands on the data path. Any other thread gets its ring
+// the first time it logs. A ring stays registered until the logger is
+// destroyed, so a record pushed just before a thread exits is still written.
+// Threads beyond max_threads get no ring and push() returns false, which the
+// caller treats as "log synchronously".
+class AsyncLogger {
+public:
+  static constexpr std::size_t ring_capacity = 512;
+  // The sender's 128 workers, plus the main, writer and helper threads.
+  static constexpr std::size_t max_threads = 128 + 32;
+  using Ring = SPSCQueue<LogRecord, ring_capacity>;
+
+  AsyncLogger(std::FILE *out, LineSink sink) noexcept
+      : out_(out), sink_(sink), id_(next_id().fetch_add(1, std::memory_order_relaxed) + 1) {}
+  AsyncLogger(const AsyncLogger &) = delete;
+  AsyncLogger &operator=(const AsyncLogger &) = delete;
+  ~AsyncLogger() { stop(); }
+
+  void start() {
+    if (running_.exchange(true, std::memory_order_acq_rel)) return;
+    writer_ = std::thread([this] {
+      while (running_.load(std::memory_order_acquire))
+        if (drain() == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+  }
+
+  // Stops accepting records, writes everything queued, and reports drops.
+  void stop() {
+    if (!running_.exchange(false, std::memory_order_acq_rel)) return;
+    writer_.join();
+    drain();  // the writer is gone: this thread is now the only consumer
+    const auto lost = dropped();
+    if (lost != reported_dropped_) {
+      char text[96];
+      std::snprintf(text, sizeof(text), "%llu log messages dropped: a thread's ring was full\n",
+                    static_cast<unsigned long long>(lost - reported_dropped_));
+      sink_(out_, 1, nll::mono_ns(), text);
+      reported_dropped_ = lost;
+    }
+    std::fflush(out_);
+  }
+
+  [[nodiscard]] bool running() const noexcept { return running_.load(std::memory_order_relaxed); }
+
+  // Gives the calling thread its ring now rather than on its first record.
+  // False when every ring is taken.
+  bool register_thread() noexcept { return thread_ring() != nullptr; }
+
+  // Captures one record on the calling thread's ring. False only when the
+  // thread has no ring; a full ring counts the record as dropped.
+  template <typename... Args>
+  bool push(int level, std::uint64_t mono_ns, const char *format, const Args &...args) noexcept {
+    static_assert(sizeof...(Args) <= LogRecord::max_args, "too many log arguments");
+    auto *ring = thread_ring();
+    if (ring == nullptr) return false;
+    auto slot = ring->queue.try_alloc();
+    if (!slot) {
+      ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return true;
+    }
+    LogRecord &record = **slot;
+    record.mono_ns = mono_ns;
+    record.format = format;
+    record.level = static_cast<std::uint8_t>(level);
+    record.arg_count = 0;
+    record.string_bytes = 0;
+    (detail::capture(record, args), ...);
+    ring->queue.commit();
+    return true;
+  }
+
+  // Consumer side: renders and writes every queued record. Called by the
+  // writer thread, or by anyone once it is stopped.
+  std::size_t drain() {
+    std::size_t written = 0;
+    char text[1024];
+    const auto count = registered_.load(std::memory_order_acquire);
+    for (std::size_t index = 0; index < count; ++index) {
+      auto &queue = rings_[index]->queue;
+      for (auto record = queue.front(); record; record = queue.front()) {
+        render(**record, text, sizeof(text));
+        sink_(out_, (*record)->level, (*record)->mono_ns, text);
+        queue.pop();
+        ++written;
+      }
+    }
+    return written;
+  }
+
+  [[nodiscard]] std::uint64_t dropped() const noexcept {
+    std::uint64_t total = 0;
+    const auto count = registered_.load(std::memory_order_acquire);
+    for (std::size_t index = 0; index < count; ++index)
+      total += rings_[index]->dropped.load(std::memory_order_relaxed);
+    return total;
+  }
+
+private:
+  struct ThreadRing {
+    Ring queue;
+    std::atomic<std::uint64_t> dropped{0};  // written by the producer only
+  };
+
+  static std::atomic<std::uint64_t> &next_id() noexcept {
+    static std::atomic<std::uint64_t> id{0};
+    return id;
+  }
+
+  ThreadRing *thread_ring() noexcept {
+    // Keyed by logger id, not address, so a logger constructed where a
+    // destroyed one lived never inherits its freed rings.
+    thread_local std::uint64_t owner = 0;
+    thread_local ThreadRing *ring = nullptr;
+    if (owner == id_) return ring;
+    owner = id_;
+    ring = nullptr;
+    const std::lock_guard<std::mutex> guard(register_mutex_);
+    const auto index = registered_.load(std::memory_order_relaxed);
+    if (index == max_threads) return nullptr;
+    rings_[index] = std::make_unique<ThreadRing>();
+    ring = rings_[index].get();
+    registered_.store(index + 1, std::memory_order_release);
+    return ring;
+  }
+
+  std::FILE *out_;
+  LineSink sink_;
+  std::uint64_t id_;
+  std::atomic<bool> running_{false};
+  std::thread writer_;
+  std::mutex register_mutex_;  // registration only; never on the push path
+  std::array<std::unique_ptr<ThreadRing>, max_threads> rings_{};
+  std::atomic<std::size_t> registered_{0};
+  std::uint64_t reported_dropped_ = 0;
+};
+
+} // namespace nll::log
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace nll::clock_sync {
+
+// In-band clock offset and drift between sender and receiver.
+//
+// One-way latency subtracts a sender CLOCK_REALTIME stamp from a receiver one,
+// so it is only as good as chrony's agreement between the hosts, which
+// sync_clocks.sh checks once before the run. The sender instead probes the
+// receiver's data port at a low rate throughout the run, over the same path as
+// the load, and each round yields the four NTP timestamps:
+//   t1 probe sent (sender)   t2 probe received (receiver)
+//   t3 reply sent (receiver) t4 reply received (sender)
+// offset = ((t2 - t1) + (t3 - t4)) / 2 is the receiver's clock minus the
+// sender's, exact when the two directions take equally long; delay =
+// (t4 - t1) - (t3 - t2) is the round trip, and half of it bounds the error.
+// The next probe carries t4 back, so the receiver completes every round too.
+struct Sample {
+  std::uint32_t round = 0;
+  std::uint64_t local_mono_ns = 0;  // when the round completed, on this host
+  std::uint64_t t1 = 0, t2 = 0, t3 = 0, t4 = 0;
+  std::int64_t offset_ns = 0;
+  std::uint64_t delay_ns = 0;
+};
+
+// Fills offset and delay from the four stamps; false for a round whose stamps
+// are missing or contradict each other (negative delay).
+inline bool complete(Sample &sample) noexcept {
+  if (!sample.t1 || !sample.t2 || !sample.t3 || !sample.t4) return false;
+  if (sample.t4 < sample.t1 || sample.t3 < sample.t2) return false;
+  const auto round_trip = sample.t4 - sample.t1;
+  const auto turnaround = sample.t3 - sample.t2;
+  if (turnaround > round_trip) return false;
+  sample.delay_ns = round_trip - turnaround;
+  // Each difference is an offset plus a one-way trip: far inside 63 bits.
+  const auto outbound = static_cast<std::int64_t>(sample.t2 - sample.t1);
+  const auto inbound = static_cast<std::int64_t>(sample.t3 - sample.t4);
+  sample.offset_ns = (outbound + inbound) / 2;
+  return true;
+}
+
+// Offset and drift from the most recent window_size rounds.
+//
+// A round that queued behind the load has a long, and usually lopsided, delay,
+// so only rounds within delay_slack of the window's shortest delay are used
+// (NTP's clock filter makes the same choice). A least-squares line through
+// their offsets against local time gives the drift as its slope and the
+// offset at the newest round as its end point; a single usable round gives its
+// own offset and no drift.
+class Estimator {
+public:
+  static constexpr std::size_t window_size = 64;
+
+  struct Estimate {
+    std::int64_t offset_ns = 0;  // receiver minus sender, at the newest round
+    double drift_ppb = 0.0;      // rate at which that offset grows
+    std::uint32_t used = 0;      // rounds behind the estimate
+  };
+
+  // Slack above the window's shortest delay: a quarter of it, at least 5 us.
+  static constexpr std::uint64_t delay_slack(std::uint64_t minimum_delay_ns) noexcept {
+    return minimum_delay_ns / 4 > 5'000 ? minimum_delay_ns / 4 : 5'000;
+  }
+
+  const Estimate &add(const Sample &sample) noexcept {
+    window_[count_ % window_size] = sample;
+    ++count_;
+    if (sample.delay_ns < minimum_delay_ns_) minimum_delay_ns_ = sample.delay_ns;
+    refit(sample.local_mono_ns);
+    return estimate_;
+  }
+
+  [[nodiscard]] const Estimate &estimate() const noexcept { return estimate_; }
+  [[nodiscard]] std::uint64_t samples() const noexcept { return count_; }
+  // Over the whole run, not just the window.
+  [[nodiscard]] std::uint64_t minimum_delay_ns() const noexcept { return count_ ? minimum_delay_ns_ : 0; }
+
+private:
+  void refit(std::uint64_t newest_ns) noexcept {
+    const std::size_t held = count_ < window_size ? static_cast<std::size_t>(count_) : window_size;
+    std::uint64_t shortest = UINT64_MAX;
+    for (std::size_t index = 0; index < held; ++index)
+      if (window_[index].delay_ns < shortest) shortest = window_[index].delay_ns;
+    const auto limit = shortest + delay_slack(shortest);
+    // Sums relative to the newest round keep the doubles small.
+    double n = 0, sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+    for (std::size_t index = 0; index < held; ++index) {
+      const auto &round = window_[index];
+      if (round.delay_ns > limit) continue;
+      const double x = (static_cast<double>(round.local_mono_ns) - static_cast<double>(newest_ns)) / 1e9;
+      const double y = static_cast<double>(round.offset_ns);
+      n += 1; sum_x += x; sum_y += y; sum_xx += x * x; sum_xy += x * y;
+    }
+    estimate_.used = static_cast<std::uint32_t>(n);
+    const double spread = n * sum_xx - sum_x * sum_x;
+    if (n < 2 || spread <= 0.0) {
+      estimate_.offset_ns = static_cast<std::int64_t>(sum_y / n);
+      estimate_.drift_ppb = 0.0;
+      return;
+    }
+    const double slope = (n * sum_xy - sum_x * sum_y) / spread;  // ns per second
+    estimate_.offset_ns = static_cast<std::int64_t>((sum_y - slope * sum_x) / n);
+    estimate_.drift_ppb = slope;
+  }
+
+  std::array<Sample, window_size> window_{};
+  std::uint64_t count_ = 0;
+  std::uint64_t minimum_delay_ns_ = UINT64_MAX;
+  Estimate estimate_{};
+};
+
+} // namespace nll::clock_sync
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "common/log.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
+#include <netinet/in.h>
+#include <optional>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace nll::control {
+
+// Live receiver counters over a side-channel UDP socket.
+//
+// Finding a zero-loss rate used to mean one sender and one receiver process
+// per grid point. With --control PORT the receiver also answers snapshot
+// requests on a second port, so a sender can run many trial windows against
+// one receiver and difference its counters between them. The exchange is one
+// fixed-size datagram each way, in network byte order like message_header.
+// It is plain UDP, so loopback, a veth pair and the benchmark link all work.
+inline constexpr std::uint16_t control_magic = 0x6585;
+inline constexpr std::uint8_t control_version = 1;
+
+enum class Op : std::uint8_t { snapshot = 1 };
+
+struct __attribute__((packed)) request {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t op;
+  uint32_t token; // echoed, so a late reply to an earlier request is ignored
+
+  void to_network() { magic = htobe16(magic); token = htobe32(token); }
+  void to_host() { magic = be16toh(magic); token = be32toh(token); }
+};
+
+// Monotonic totals since the receiver started; a client differences two of
+// them. processing_latency_sum_ns is the receive-to-finish residence that the
+// timeseries reports as a mean, and pending_socket_bytes is the receive queue
+// at the moment of the reply.
+struct __attribute__((packed)) reply {
+  uint16_t magic;
+  uint8_t version;
+  uint8_t op;
+  uint32_t token;
+  uint64_t mono_ns;
+  uint64_t datagrams_received;
+  uint64_t valid_packets;
+  uint64_t unique_valid_packets;
+  uint64_t receive_sequence_gaps;
+  uint64_t spsc_overflow;
+  uint64_t processed_packets;
+  uint64_t processing_latency_sum_ns;
+  uint64_t pending_socket_bytes;
+
+  void to_network() {
+    magic = htobe16(magic);
+    token = htobe32(token);
+    mono_ns = htobe64(mono_ns);
+    datagrams_received = htobe64(datagrams_received);
+    valid_packets = htobe64(valid_packets);
+    unique_valid_packets = htobe64(unique_valid_packets);
+    receive_sequence_gaps = htobe64(receive_sequence_gaps);
+    spsc_overflow = htobe64(spsc_overflow);
+    processed_packets = htobe64(processed_packets);
+    processing_latency_sum_ns = htobe64(processing_latency_sum_ns);
+    pending_socket_bytes = htobe64(pending_socket_bytes);
+  }
+
+  void to_host() {
+    magic = be16toh(magic);
+    token = be32toh(token);
+    mono_ns = be64toh(mono_ns);
+    datagrams_received = be64toh(datagrams_received);
+    valid_packets = be64toh(valid_packets);
+    unique_valid_packets = be64toh(unique_valid_packets);
+    receive_sequence_gaps = be64toh(receive_sequence_gaps);
+    spsc_overflow = be64toh(spsc_overflow);
+    processed_packets = be64toh(processed_packets);
+    processing_latency_sum_ns = be64toh(processing_latency_sum_ns);
+    pending_socket_bytes = be64toh(pending_socket_bytes);
+  }
+};
+
+// Client side: a connected UDP socket to the receiver's control port.
+class Client {
+public:
+  explicit Client(const sockaddr_in &receiver) {
+    fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_ < 0) {
+      NLL_ERROR("Control socket failed: %s\n", std::strerror(errno));
+      return;
+    }
+    if (::connect(fd_, reinterpret_cast<const sockaddr *>(&receiver), sizeof(receiver)) < 0) {
+      NLL_ERROR("Control connect failed: %s\n", std::strerror(errno));
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+  ~Client() { if (fd_ >= 0) ::close(fd_); }
+  Client(const Client &) = delete;
+  Client &operator=(const Client &) = delete;
+
+  [[nodiscard]] bool valid() const noexcept { return fd_ >= 0; }
+
+  // Retries a lost request or reply; nullopt if the receiver never answered.
+  std::optional<reply> snapshot(int attempts = 5, int timeout_ms = 200) {
+    for (int attempt = 0; attempt < attempts && fd_ >= 0; ++attempt) {
+      const auto token = ++token_;
+      request message{.magic = control_magic, .version = control_version,
+                      .op = static_cast<uint8_t>(Op::snapshot), .token = token};
+      message.to_network();
+      if (::send(fd_, &message, sizeof(message), 0) != sizeof(message)) continue;
+      pollfd readable{.fd = fd_, .events = POLLIN, .revents = 0};
+      while (::poll(&readable, 1, timeout_ms) > 0) {
+        reply answer{};
+        if (::recv(fd_, &answer, sizeof(answer), 0) != sizeof(answer)) break;
+        answer.to_host();
+        if (answer.magic == control_magic && answer.version == control_version &&
+            answer.token == token)
+          return answer;
+      }
+    }
+    return std::nullopt;
+  }
+
+private:
+  int fd_ = -1;
+  std::uint32_t token_ = 0;
+};
+
+} // namespace nll::control
@@ -0,0 +1,445 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace nll::placement {
+
+// CPU roles used to be assigned by hand in each YAML config. That is fine for
+// the two Pi 4 systems the configs were written for and wrong on nearly every
+// other host shape: an SMT sibling handed to the worker, a sender sharing L2
+// with the receiver, or the receiver placed far from the NIC's interrupts. This
+// module reads the topology and NIC affinity from sysfs and procfs and proposes
+// a placement by fixed rules:
+//
+//   ingress  shares a cache with the core that takes the NIC's interrupts
+//            (the softirq has just written the skb there) without being that
+//            core, so it does not compete with the interrupt handler
+//   worker   on another physical core, preferably behind the same last-level
+//            cache as ingress, so the SPSC handoff stays on chip
+//   sender   on cores that share no L2 with ingress, when there are any
+//
+// Every path is resolved under a root directory, so tests point discovery at a
+// fake tree instead of the host's /sys and /proc.
+
+struct Cpu {
+  int id = -1;
+  int package = 0;
+  int core = 0;
+  int node = 0;
+  std::vector<int> smt_siblings;  // includes id
+  std::vector<int> l2_shared;     // includes id; empty if unknown
+  std::vector<int> llc_shared;    // includes id; empty if unknown
+};
+
+struct NicAffinity {
+  std::string interface;
+  std::vector<int> irqs;
+  std::vector<int> irq_cpus;      // union of the IRQs' effective affinity
+  std::vector<int> busiest_cpus;  // CPUs that have actually serviced them, most first
+  std::vector<int> rps_cpus;
+  std::vector<int> xps_cpus;
+};
+
+struct Topology {
+  std::vector<Cpu> cpus;
+  std::optional<NicAffinity> nic;
+
+  [[nodiscard]] const Cpu *find(int id) const noexcept {
+    for (const auto &cpu : cpus)
+      if (cpu.id == id) return &cpu;
+    return nullptr;
+  }
+};
+
+struct Request {
+  bool receiver = true;  // false plans a sender-only host
+  bool worker = false;
+  std::uint32_t sender_threads = 0;
+};
+
+struct Plan {
+  int irq_cpu = -1;
+  int ingress_cpu = -1;
+  int worker_cpu = -1;
+  std::vector<int> sender_cpus;
+  // One line per rule that could not be met on this host.
+  std::vector<std::string> notes;
+};
+
+// "0-3,8,10-11" as written in cpulist files; nullopt on malformed input.
+inline std::optional<std::vector<int>> parse_cpu_list(std::string_view text) {
+  std::vector<int> cpus;
+  while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back())))
+    text.remove_suffix(1);
+  while (!text.empty()) {
+    const auto comma = text.find(',');
+    const auto item = text.substr(0, comma);
+    const auto dash = item.find('-');
+    int first = 0, last = 0;
+    const auto head = item.substr(0, dash);
+    auto result = std::from_chars(head.data(), head.data() + head.size(), first);
+    if (head.empty() || result.ec != std::errc{} || result.ptr != head.data() + head.size())
+      return std::nullopt;
+    last = first;
+    if (dash != std::string_view::npos) {
+      const auto tail = item.substr(dash + 1);
+      result = std::from_chars(tail.data(), tail.data() + tail.size(), last);
+      if (tail.empty() || result.ec != std::errc{} || result.ptr != tail.data() + tail.size() ||
+          last < first)
+        return std::nullopt;
+    }
+    for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    if (comma == std::string_view::npos) break;
+    text.remove_prefix(comma + 1);
+  }
+  return cpus;
+}
+
+// "00000000,0000000f" as written in rps_cpus and smp_affinity: hex words, most
+// significant first. An all-zero mask parses to an empty list.
+inline std::optional<std::vector<int>> parse_cpu_mask(std::string_view text) {
+  std::vector<int> cpus;
+  int bit = 0;
+  for (auto position = text.size(); position-- > 0;) {
+    const char c = text[position];
+    if (c == ',' || std::isspace(static_cast<unsigned char>(c))) continue;
+    int nibble = 0;
+    if (c >= '0' && c <= '9') nibble = c - '0';
+    else if (c >= 'a' && c <= 'f') nibble = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F') nibble = c - 'A' + 10;
+    else return std::nullopt;
+    for (int offset = 0; offset < 4; ++offset)
+      if (nibble & (1 << offset)) cpus.push_back(bit + offset);
+    bit += 4;
+  }
+  std::sort(cpus.begin(), cpus.end());
+  return cpus;
+}
+
+inline std::string format_cpu_list(const std::vector<int> &cpus) {
+  std::string text;
+  for (const int cpu : cpus) {
+    if (!text.empty()) text += ',';
+    text += std::to_string(cpu);
+  }
+  return text;
+}
+
+namespace detail {
+
+inline std::optional<std::string> read_line(const std::filesystem::path &path) {
+  std::ifstream file(path);
+  std::string line;
+  if (!file || !std::getline(file, line)) return std::nullopt;
+  return line;
+}
+
+inline int read_int(const std::filesystem::path &path, int fallback) {
+  const auto line = read_line(path);
+  int value = 0;
+  if (!line) return fallback;
+  const auto result = std::from_chars(line->data(), line->data() + line->size(), value);
+  return result.ec == std::errc{} ? value : fallback;
+}
+
+inline std::vector<int> read_list(const std::filesystem::path &path) {
+  const auto line = read_line(path);
+  if (!line) return {};
+  return parse_cpu_list(*line).value_or(std::vector<int>{});
+}
+
+inline std::vector<int> read_mask(const std::filesystem::path &path) {
+  const auto line = read_line(path);
+  if (!line) return {};
+  return parse_cpu_mask(*line).value_or(std::vector<int>{});
+}
+
+inline void merge(std::vector<int> &into, const std::vector<int> &from) {
+  into.insert(into.end(), from.begin(), from.end());
+  std::sort(into.begin(), into.end());
+  into.erase(std::unique(into.begin(), into.end()), into.end());
+}
+
+inline bool contains(const std::vector<int> &cpus, int cpu) {
+  return std::find(cpus.begin(), cpus.end(), cpu) != cpus.end();
+}
+
+// Matches "eth0", "eth0-rx-0", "eth0-TxRx-3" but not "eth01".
+inline bool names_interface(std::string_view action, std::string_view interface) {
+  if (action.substr(0, interface.size()) != interface) return false;
+  return action.size() == interface.size() || action[interface.size()] == '-' ||
+         action[interface.size()] == '@';
+}
+
+inline std::vector<int> read_queue_masks(const std::filesystem::path &queues,
+                                         std::string_view prefix, const char *file) {
+  std::vector<int> cpus;
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(queues, ec)) {
+    const auto name = entry.path().filename().string();
+    if (name.rfind(prefix, 0) != 0) continue;
+    merge(cpus, read_mask(entry.path() / file));
+  }
+  return cpus;
+}
+
+} // namespace detail
+
+inline std::vector<Cpu> discover_cpus(const std::filesystem::path &root) {
+  const auto base = root / "sys/devices/system/cpu";
+  auto online = detail::read_list(base / "online");
+  if (online.empty()) {
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(base, ec)) {
+      const auto name = entry.path().filename().string();
+      int id = 0;
+      if (name.size() > 3 && name.rfind("cpu", 0) == 0 &&
+          std::from_chars(name.data() + 3, name.data() + name.size(), id).ptr ==
+              name.data() + name.size())
+        online.push_back(id);
+    }
+    std::sort(online.begin(), online.end());
+  }
+  std::map<int, int> node_of;
+  std::error_code ec;
+  for (const auto &entry : std::filesystem::directory_iterator(root / "sys/devices/system/node", ec)) {
+    const auto name = entry.path().filename().string();
+    int node = 0;
+    if (name.rfind("node", 0) != 0 ||
+        std::from_chars(name.data() + 4, name.data() + name.size(), node).ptr !=
+            name.data() + name.size())
+      continue;
+    for (const int cpu : detail::read_list(entry.path() / "cpulist")) node_of[cpu] = node;
+  }
+  std::vector<Cpu> cpus;
+  for (const int id : online) {
+    const auto directory = base / ("cpu" + std::to_string(id));
+    Cpu cpu{.id = id,
+            .package = detail::read_int(directory / "topology/physical_package_id", 0),
+            .core = detail::read_int(directory / "topology/core_id", id),
+            .node = node_of.contains(id) ? node_of[id] : 0,
+            .smt_siblings = detail::read_list(directory / "topology/thread_siblings_list"),
+            .l2_shared = {}, .llc_shared = {}};
+    if (cpu.smt_siblings.empty()) cpu.smt_siblings = {id};
+    int llc_level = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(directory / "cache", ec)) {
+      if (entry.path().filename().string().rfind("index", 0) != 0) continue;
+      const auto type = detail::read_line(entry.path() / "type");
+      if (type && *type == "Instruction") continue;
+      const int level = detail::read_int(entry.path() / "level", 0);
+      const auto shared = detail::read_list(entry.path() / "shared_cpu_list");
+      if (level == 2) cpu.l2_shared = shared;
+      if (level > llc_level) { llc_level = level; cpu.llc_shared = shared; }
+    }
+    cpus.push_back(std::move(cpu));
+  }
+  return cpus;
+}
+
+inline std::optional<NicAffinity> discover_nic(const std::filesystem::path &root,
+                                               const std::string &interface) {
+  if (interface.empty()) return std::nullopt;
+  NicAffinity nic{.interface = interface, .irqs = {}, .irq_cpus = {}, .busiest_cpus = {},
+                  .rps_cpus = {}, .xps_cpus = {}};
+  const auto net = root / "sys/class/net" / interface;
+  if (!std::filesystem::exists(net)) return std::nullopt;
+
+  // /proc/interrupts: "IRQ:" then one count per CPU column, then the chip,
+  // the trigger and the action names. The header row names the CPU columns,
+  // which are not contiguous when some CPUs are offline.
+  std::ifstream interrupts(root / "proc/interrupts");
+  std::string line;
+  std::vector<int> columns;
+  std::map<int, std::uint64_t> serviced;
+  if (std::getline(interrupts, line)) {
+    std::istringstream header(line);
+    std::string name;
+    while (header >> name)
+      if (name.rfind("CPU", 0) == 0) columns.push_back(std::atoi(name.c_str() + 3));
+  }
+  while (std::getline(interrupts, line)) {
+    std::istringstream row(line);
+    std::string label;
+    if (!(row >> label) || label.empty() || label.back() != ':') continue;
+    int irq = 0;
+    if (std::from_chars(label.data(), label.data() + label.size() - 1, irq).ptr !=
+        label.data() + label.size() - 1)
+      continue;
+    std::vector<std::uint64_t> counts;
+    std::string token;
+    std::vector<std::string> rest;
+    while (row >> token) {
+      if (rest.empty() && counts.size() < columns.size() &&
+          std::all_of(token.begin(), token.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)); }))
+        counts.push_back(std::strtoull(token.c_str(), nullptr, 10));
+      else
+        rest.push_back(token);
+    }
+    bool matches = false;
+    for (const auto &word : rest) {
+      std::string_view action(word);
+      if (!action.empty() && action.back() == ',') action.remove_suffix(1);
+      if (detail::names_interface(action, interface)) matches = true;
+    }
+    if (!matches) continue;
+    nic.irqs.push_back(irq);
+    for (std::size_t column = 0; column < counts.size(); ++column)
+      serviced[columns[column]] += counts[column];
+    const auto irq_directory = root / "proc/irq" / std::to_string(irq);
+    auto affinity = detail::read_list(irq_directory / "effective_affinity_list");
+    if (affinity.empty()) affinity = detail::read_list(irq_directory / "smp_affinity_list");
+    detail::merge(nic.irq_cpus, affinity);
+  }
+  std::vector<std::pair<std::uint64_t, int>> ranked;
+  for (const auto &[cpu, count] : serviced)
+    if (count) ranked.emplace_back(count, cpu);
+  std::sort(ranked.begin(), ranked.end(),
+            [](const auto &left, const auto &right) {
+              return left.first != right.first ? left.first > right.first : left.second < right.second;
+            });
+  for (const auto &[count, cpu] : ranked) nic.busiest_cpus.push_back(cpu);
+  nic.rps_cpus = detail::read_queue_masks(net / "queues", "rx-", "rps_cpus");
+  nic.xps_cpus = detail::read_queue_masks(net / "queues", "tx-", "xps_cpus");
+  return nic;
+}
+
+inline Topology discover(const std::filesystem::path &root, const std::string &interface) {
+  return {.cpus = discover_cpus(root), .nic = discover_nic(root, interface)};
+}
+
+// The CPU that will run the NIC's receive softirq. An IRQ pinned to a subset
+// of the CPUs is taken at its word; one left spread over every CPU is placed by
+// where it has actually been serviced. RPS, when configured, moves protocol
+// processing to its own set, which then takes precedence.
+inline int interrupt_cpu(const Topology &topology) {
+  if (!topology.nic) return -1;
+  const auto &nic = *topology.nic;
+  const auto online = [&](int cpu) { return topology.find(cpu) != nullptr; };
+  for (const int cpu : nic.rps_cpus)
+    if (online(cpu)) return cpu;
+  const bool pinned = !nic.irq_cpus.empty() && nic.irq_cpus.size() < topology.cpus.size();
+  if (pinned)
+    for (const int cpu : nic.busiest_cpus)
+      if (detail::contains(nic.irq_cpus, cpu) && online(cpu)) return cpu;
+  if (pinned)
+    for (const int cpu : nic.irq_cpus)
+      if (online(cpu)) return cpu;
+  for (const int cpu : nic.busiest_cpus)
+    if (online(cpu)) return cpu;
+  return -1;
+}
+
+inline Plan plan(const Topology &topology, const Request &request) {
+  Plan result;
+  if (topology.cpus.empty()) {
+    result.notes.emplace_back("no online CPUs found");
+    return result;
+  }
+  std::vector<int> used;
+  const auto shares = [](const std::vector<int> &group, int cpu) {
+    return detail::contains(group, cpu);
+  };
+  const auto same_core = [&](const Cpu &left, const Cpu &right) {
+    return left.id == right.id || shares(left.smt_siblings, right.id) ||
+           (left.package == right.package && left.core == right.core);
+  };
+  // First free CPU in topology order accepted by the strictest filter that
+  // accepts any.
+  using Filter = std::function<bool(const Cpu &)>;
+  const auto pick = [&](std::initializer_list<Filter> tiers) {
+    for (const auto &accept : tiers)
+      for (const auto &cpu : topology.cpus)
+        if (!detail::contains(used, cpu.id) && accept(cpu)) return cpu.id;
+    return -1;
+  };
+  const auto any = [](const Cpu &) { return true; };
+
+  result.irq_cpu = interrupt_cpu(topology);
+  const Cpu *irq = topology.find(result.irq_cpu);
+  if (!irq) result.notes.emplace_back("NIC interrupt CPU unknown; placement ignores interrupts");
+  const auto not_irq = [&](const Cpu &cpu) { return !irq || cpu.id != irq->id; };
+
+  const Cpu *ingress = nullptr;
+  const Cpu *worker = nullptr;
+  if (request.receiver) {
+    result.ingress_cpu = pick({
+        [&](const Cpu &cpu) { return irq && not_irq(cpu) && shares(irq->l2_shared, cpu.id); },
+        [&](const Cpu &cpu) { return irq && not_irq(cpu) && shares(irq->llc_shared, cpu.id); },
+        [&](const Cpu &cpu) { return irq && not_irq(cpu) && cpu.node == irq->node; },
+        not_irq, any});
+    ingress = topology.find(result.ingress_cpu);
+    used.push_back(ingress->id);
+    if (irq && ingress->id == irq->id)
+      result.notes.emplace_back("ingress shares the interrupt CPU");
+    else if (irq && !shares(irq->l2_shared, ingress->id) && !shares(irq->llc_shared, ingress->id))
+      result.notes.emplace_back("ingress shares no cache with the interrupt CPU");
+  }
+
+  if (ingress && request.worker) {
+    const auto other_core = [&](const Cpu &cpu) { return !same_core(cpu, *ingress); };
+    result.worker_cpu = pick({
+        [&](const Cpu &cpu) { return not_irq(cpu) && other_core(cpu) && shares(ingress->llc_shared, cpu.id); },
+        [&](const Cpu &cpu) { return not_irq(cpu) && other_core(cpu) && cpu.node == ingress->node; },
+        [&](const Cpu &cpu) { return not_irq(cpu) && other_core(cpu); },
+        other_core, any});
+    worker = topology.find(result.worker_cpu);
+    if (!worker) {
+      result.notes.emplace_back("no CPU left for the worker");
+    } else {
+      used.push_back(worker->id);
+      if (same_core(*worker, *ingress))
+        result.notes.emplace_back("worker is an SMT sibling of ingress");
+    }
+  }
+
+  // The sender runs beside the receiver only on loopback or single-host runs;
+  // its threads then keep out of the receiver's L2, and in every case spread
+  // over physical cores before doubling up on SMT siblings.
+  const auto clear_of_receiver = [&](const Cpu &cpu) {
+    for (const Cpu *receiver : {ingress, worker})
+      if (receiver && (shares(receiver->l2_shared, cpu.id) || same_core(cpu, *receiver)))
+        return false;
+    return true;
+  };
+  std::vector<int> senders;
+  const auto own_core = [&](const Cpu &cpu) {
+    return std::none_of(senders.begin(), senders.end(),
+                        [&](int id) { return same_core(cpu, *topology.find(id)); });
+  };
+  bool crowded = false;
+  for (std::uint32_t thread = 0; thread < request.sender_threads; ++thread) {
+    int cpu = pick({
+        [&](const Cpu &cpu) { return not_irq(cpu) && clear_of_receiver(cpu) && own_core(cpu); },
+        [&](const Cpu &cpu) { return not_irq(cpu) && clear_of_receiver(cpu); },
+        clear_of_receiver});
+    if (cpu < 0) {
+      cpu = pick({not_irq, any});
+      crowded = crowded || cpu >= 0;
+    }
+    if (cpu < 0) {
+      result.notes.emplace_back("no CPU left for sender thread " + std::to_string(thread));
+      break;
+    }
+    senders.push_back(cpu);
+    used.push_back(cpu);
+  }
+  if (crowded) result.notes.emplace_back("sender shares L2 with the receiver");
+  result.sender_cpus = std::move(senders);
+  return result;
+}
+
+} // namespace nll::placement
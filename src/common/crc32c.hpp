@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+namespace nll {
+
+// CRC32C (Castagnoli) for payload integrity checks.
+//
+// Qualification runs verify every datagram at line rate, so the check cannot
+// be a byte-at-a-time table walk. Both targets have a CRC32C instruction that
+// folds eight bytes per issue (SSE4.2 crc32q, ARMv8 crc32cx; the Pi 4's A72
+// implements it), selected once at first use. Hosts without it fall back to
+// slicing-by-8, which also consumes eight bytes per step from eight tables.
+namespace crc32c_detail {
+
+inline constexpr std::uint32_t polynomial = 0x82F6'3B78U; // reflected
+
+constexpr std::array<std::array<std::uint32_t, 256>, 8> make_tables() {
+  std::array<std::array<std::uint32_t, 256>, 8> tables{};
+  for (std::uint32_t byte = 0; byte < 256; ++byte) {
+    std::uint32_t crc = byte;
+    for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ (polynomial & (0U - (crc & 1U)));
+    tables[0][byte] = crc;
+  }
+  for (std::size_t slice = 1; slice < 8; ++slice)
+    for (std::uint32_t byte = 0; byte < 256; ++byte)
+      tables[slice][byte] = (tables[slice - 1][byte] >> 8) ^ tables[0][tables[slice - 1][byte] & 0xFFU];
+  return tables;
+}
+
+inline constexpr auto tables = make_tables();
+
+inline std::uint32_t portable(std::uint32_t crc, const std::byte *data, std::size_t size) noexcept {
+  while (size >= 8) {
+    std::uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    word = le64toh(word) ^ crc;
+    crc = tables[7][word & 0xFF] ^ tables[6][(word >> 8) & 0xFF] ^
+          tables[5][(word >> 16) & 0xFF] ^ tables[4][(word >> 24) & 0xFF] ^
+          tables[3][(word >> 32) & 0xFF] ^ tables[2][(word >> 40) & 0xFF] ^
+          tables[1][(word >> 48) & 0xFF] ^ tables[0][word >> 56];
+    data += 8;
+    size -= 8;
+  }
+  while (size--) crc = (crc >> 8) ^ tables[0][(crc ^ std::to_integer<std::uint32_t>(*data++)) & 0xFFU];
+  return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+inline std::uint32_t hardware(std::uint32_t crc, const std::byte *data, std::size_t size) noexcept {
+  std::uint64_t wide = crc;
+  while (size >= 8) {
+    std::uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    wide = _mm_crc32_u64(wide, word);
+    data += 8;
+    size -= 8;
+  }
+  crc = static_cast<std::uint32_t>(wide);
+  while (size--) crc = _mm_crc32_u8(crc, std::to_integer<std::uint8_t>(*data++));
+  return crc;
+}
+inline bool hardware_available() noexcept { return __builtin_cpu_supports("sse4.2"); }
+inline constexpr const char *hardware_name = "sse4.2";
+#elif defined(__aarch64__)
+__attribute__((target("+crc")))
+inline std::uint32_t hardware(std::uint32_t crc, const std::byte *data, std::size_t size) noexcept {
+  while (size >= 8) {
+    std::uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc = __crc32cd(crc, word);
+    data += 8;
+    size -= 8;
+  }
+  while (size--) crc = __crc32cb(crc, std::to_integer<std::uint8_t>(*data++));
+  return crc;
+}
+inline bool hardware_available() noexcept { return (::getauxval(AT_HWCAP) & HWCAP_CRC32) != 0; }
+inline constexpr const char *hardware_name = "armv8-crc";
+#else
+inline std::uint32_t hardware(std::uint32_t crc, const std::byte *data, std::size_t size) noexcept {
+  return portable(crc, data, size);
+}
+inline bool hardware_available() noexcept { return false; }
+inline constexpr const char *hardware_name = "slicing-by-8";
+#endif
+
+using Function = std::uint32_t (*)(std::uint32_t, const std::byte *, std::size_t) noexcept;
+
+inline Function selected() noexcept {
+  static const Function function = hardware_available() ? &hardware : &portable;
+  return function;
+}
+
+} // namespace crc32c_detail
+
+inline std::uint32_t crc32c(const void *data, std::size_t size, std::uint32_t crc = 0) noexcept {
+  return ~crc32c_detail::selected()(~crc, static_cast<const std::byte *>(data), size);
+}
+
+inline const char *crc32c_implementation() noexcept {
+  return crc32c_detail::hardware_available() ? crc32c_detail::hardware_name : "slicing-by-8";
+}
+
+// Integrity-checked payload layout: message_header, a seeded pattern, then the
+// CRC32C of everything before it, little-endian, in the last four bytes. The
+// pattern is written once per send slot; only the header and trailer change
+// per packet, so sealing costs one CRC pass.
+inline constexpr std::size_t payload_trailer_bytes = sizeof(std::uint32_t);
+
+inline void fill_payload_pattern(std::byte *payload, std::size_t size, std::uint64_t seed) noexcept {
+  std::uint64_t state = seed ^ 0x6e6c'6c70'6174'7465ULL; // "nllpatte"
+  for (std::size_t offset = 0; offset < size; offset += sizeof(state)) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    const auto value = htole64(state * 0x2545'F491'4F6C'DD1DULL);
+    std::memcpy(payload + offset, &value, std::min(sizeof(value), size - offset));
+  }
+}
+
+inline void seal_payload(std::byte *payload, std::size_t size) noexcept {
+  const auto crc = htole32(crc32c(payload, size - payload_trailer_bytes));
+  std::memcpy(payload + size - payload_trailer_bytes, &crc, sizeof(crc));
+}
+
+inline bool payload_intact(const std::byte *payload, std::size_t size) noexcept {
+  if (size < payload_trailer_bytes) return false;
+  std::uint32_t stored;
+  std::memcpy(&stored, payload + size - payload_trailer_bytes, sizeof(stored));
+  return le32toh(stored) == crc32c(payload, size - payload_trailer_bytes);
+}
+
+} // namespace nll
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace nll {
+
+// Sequence accounting per source, for fan-in runs with many publishers.
+//
+// The global SequenceTracker sees one interleaved stream: with two senders, or
+// one sender whose workers draw sequences from a shared counter, a loss on one
+// flow and a lead on another cancel or masquerade as reordering. Each source
+// here gets its own high watermark instead, kept in a fixed open-addressing
+// table: linear probing over one 64-byte entry per slot, at most half full, so
+// a lookup is a multiply and, almost always, a single cache line. Storage is
+// the caller's (the receiver takes it from its pre-faulted arena), and a source
+// arriving once max_flows are tracked is counted in untracked_packets rather
+// than evicting one that is.
+//
+// Per-flow state is RFC 3550 style rather than a bitmap: loss is the observed
+// sequence span less the arrivals, so a duplicate hides one lost datagram. The
+// global tracker still counts duplicates exactly.
+class FlowTable {
+public:
+  struct alignas(64) Entry {
+    std::uint64_t key = 0;  // 0: empty slot
+    std::uint64_t packets = 0;
+    std::uint64_t reordered = 0;  // arrivals below the flow's high watermark
+    std::uint64_t gap_events = 0;  // jumps past the high watermark
+    std::uint64_t first_receive_mono_ns = 0;
+    std::uint64_t last_receive_mono_ns = 0;
+    std::uint32_t minimum_sequence = 0;
+    std::uint32_t highest_sequence = 0;
+    std::uint16_t flow_id = 0;  // from the flow_tag, if the sender wrote one
+    bool tagged = false;
+
+    [[nodiscard]] std::uint64_t lost() const noexcept {
+      const std::uint64_t span = std::uint64_t{highest_sequence} - minimum_sequence + 1;
+      return packets >= span ? 0 : span - packets;
+    }
+  };
+  static_assert(sizeof(Entry) == 64);
+
+  // Slots for max_flows sources at no more than half occupancy.
+  static constexpr std::size_t slots_for(std::uint32_t max_flows) noexcept {
+    return std::bit_ceil(std::size_t{max_flows} * 2);
+  }
+
+  // IPv4 address and UDP port, both in network byte order; never 0 for a
+  // bound sender, which leaves 0 free to mark empty slots.
+  static constexpr std::uint64_t source_key(std::uint32_t address, std::uint16_t port) noexcept {
+    return (std::uint64_t{address} << 16 | port) + 1;
+  }
+
+  FlowTable() = default;
+  FlowTable(std::span<Entry> slots, std::uint32_t max_flows) noexcept
+      : slots_(slots), max_flows_(max_flows),
+        shift_(64 - static_cast<unsigned>(std::countr_zero(slots.size()))) {}
+
+  [[nodiscard]] bool enabled() const noexcept { return !slots_.empty(); }
+
+  // The source's entry, or nullptr once the table is full and key is new.
+  Entry *observe(std::uint64_t key, std::uint32_t sequence, std::uint64_t now_ns) noexcept {
+    Entry *entry = find(key);
+    if (entry == nullptr) { ++untracked_packets_; return nullptr; }
+    if (entry->packets == 0) {
+      entry->minimum_sequence = entry->highest_sequence = sequence;
+      entry->first_receive_mono_ns = now_ns;
+    } else if (sequence > entry->highest_sequence) {
+      if (sequence - entry->highest_sequence > 1) ++entry->gap_events;
+      entry->highest_sequence = sequence;
+    } else {
+      ++entry->reordered;
+      if (sequence < entry->minimum_sequence) entry->minimum_sequence = sequence;
+    }
+    ++entry->packets;
+    entry->last_receive_mono_ns = now_ns;
+    return entry;
+  }
+
+  [[nodiscard]] std::uint32_t flows() const noexcept { return flows_; }
+  [[nodiscard]] std::uint32_t max_flows() const noexcept { return max_flows_; }
+  [[nodiscard]] std::uint64_t untracked_packets() const noexcept { return untracked_packets_; }
+  // Occupied and empty slots alike, in table order; skip key == 0.
+  [[nodiscard]] std::span<const Entry> slots() const noexcept { return slots_; }
+
+  static constexpr std::uint32_t address_of(std::uint64_t key) noexcept {
+    return static_cast<std::uint32_t>((key - 1) >> 16);
+  }
+  static constexpr std::uint16_t port_of(std::uint64_t key) noexcept {
+    return static_cast<std::uint16_t>(key - 1);
+  }
+
+private:
+  Entry *find(std::uint64_t key) noexcept {
+    const std::size_t mask = slots_.size() - 1;
+    for (std::size_t slot = (key * 0x9E37'79B9'7F4A'7C15ULL) >> shift_;; slot = (slot + 1) & mask) {
+      Entry &entry = slots_[slot];
+      if (entry.key == key) return &entry;
+      if (entry.key != 0) continue;
+      // An empty slot ends the probe: the key is new.
+      if (flows_ == max_flows_) return nullptr;
+      ++flows_;
+      entry.key = key;
+      return &entry;
+    }
+  }
+
+  std::span<Entry> slots_;
+  std::uint64_t untracked_packets_ = 0;
+  std::uint32_t max_flows_ = 0;
+  std::uint32_t flows_ = 0;
+  unsigned shift_ = 64;
+};
+
+} // namespace nll
@@ -8,8 +8,13 @@ I want 4 log levels
 
 I'll also add a threadsafe flag so the logs aren't garbled from multiple
 threads.
+
+NLL_LOG_ASYNC (on by default) lets a program hand formatting and writing to a
+background thread for as long as an AsyncScope is alive, see async_log.hpp.
+Outside one, or with NLL_LOG_ASYNC=0, logging stays synchronous.
 */
 
+#include "common/async_log.hpp"
 #include "common/time.hpp"
 #include <cinttypes>
 #include <cstdarg>
@@ -24,6 +29,10 @@ threads.
 #define NLL_LOG_THREADSAFE 0
 #endif
 
+#ifndef NLL_LOG_ASYNC
+#define NLL_LOG_ASYNC 1
+#endif
+
 #if NLL_LOG_THREADSAFE
 #include <mutex>
 #endif
@@ -73,29 +82,90 @@ inline void init_stderr_line_buffering() {
   setvbuf(stderr, buf, _IOLBF, sizeof(buf)); // _IOLBF = IO Line Buffer
 }
 
+namespace detail {
+inline void write_prefix(std::FILE *out, int lvl, std::uint64_t t) {
+  std::fputs(lvl_color(lvl), out);
+  std::fprintf(out, "[%s %12" PRIu64 " %09" PRIu64 "] ", lvl_name(lvl),
+               static_cast<std::uint64_t>(t / a_billi), // s
+               static_cast<std::uint64_t>(t % a_billi)  // ns
+  );
+}
+
+// the async writer's sink: same line as vlogf, text already formatted
+inline void write_line(std::FILE *out, int lvl, std::uint64_t t, const char *text) {
+#if NLL_LOG_THREADSAFE
+  const std::lock_guard<std::mutex> g(log_mutex());
+#endif
+  write_prefix(out, lvl, t);
+  std::fputs(text, out);
+  std::fputs("\x1b[0m", out);
+}
+} // namespace detail
+
 // logger: [LVL s.ns] message
 inline void vlogf(int lvl, const char *fmt, va_list ap) {
 #if NLL_LOG_THREADSAFE
   const std::lock_guard<std::mutex> g(log_mutex());
 #endif
-  const std::uint64_t t = nll::mono_ns();
-  const char *color = detail::lvl_color(lvl);
-  const char *name = detail::lvl_name(lvl);
-
-  std::fputs(color, stderr);
-  std::fprintf(stderr, "[%s %12" PRIu64 " %09" PRIu64 "] ", name,
-               static_cast<std::uint64_t>(t / a_billi), // s
-               static_cast<std::uint64_t>(t % a_billi)  // ns
-  );
+  detail::write_prefix(stderr, lvl, nll::mono_ns());
   std::vfprintf(stderr, fmt, ap);
   std::fputs("\x1b[0m", stderr);
 }
-inline void logf(int lvl, const char *fmt, ...) {
+inline void sync_logf(int lvl, const char *fmt, ...) {
   va_list ap;
   va_start(ap, fmt);
   vlogf(lvl, fmt, ap);
   va_end(ap);
 }
+
+// one process-wide backend writing to stderr
+inline AsyncLogger &async_logger() {
+  static AsyncLogger logger(stderr, detail::write_line);
+  return logger;
+}
+
+// Runs the async backend for its lifetime; main() holds one around the hot
+// loops, so anything logged after it is gone is synchronous again.
+class AsyncScope {
+public:
+  AsyncScope() {
+#if NLL_LOG_ASYNC
+    async_logger().start();
+#endif
+  }
+  AsyncScope(const AsyncScope &) = delete;
+  AsyncScope &operator=(const AsyncScope &) = delete;
+  ~AsyncScope() {
+#if NLL_LOG_ASYNC
+    async_logger().stop();
+#endif
+  }
+};
+
+// Allocates the calling thread's ring up front; hot threads call it after
+// pinning, so their first NLL_* call never allocates.
+inline void register_thread() noexcept {
+#if NLL_LOG_ASYNC
+  async_logger().register_thread();
+#endif
+}
+
+// messages dropped on full rings so far, for the stats files
+inline std::uint64_t dropped_messages() noexcept {
+#if NLL_LOG_ASYNC
+  return async_logger().dropped();
+#else
+  return 0;
+#endif
+}
+
+template <typename... Args> inline void logf(int lvl, const char *fmt, const Args &...args) {
+#if NLL_LOG_ASYNC
+  auto &backend = async_logger();
+  if (backend.running() && backend.push(lvl, nll::mono_ns(), fmt, args...)) return;
+#endif
+  sync_logf(lvl, fmt, args...);
+}
 } // namespace nll::log
 
 #if NLL_LOG_LEVEL >= 0
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+
+namespace nll {
+
+// Fixed-size log-bucketed histogram for online nanosecond distributions.
+//
+// Sorting every sample, as the sender does for pacing lateness, needs memory
+// proportional to the run. This keeps 16 linear sub-buckets per power of two
+// instead: values below 16 are exact, and any larger value lands in a bucket
+// at most 1/16 (6.25%) wider than its lower edge. Recording is a bit_width and
+// an increment, cheap enough for a per-packet hot path, and the footprint is
+// a constant ~5 KiB covering up to 2^44 ns (about 4.9 hours); larger values
+// are clamped into the last bucket but still reach max().
+class LogHistogram {
+public:
+  static constexpr unsigned sub_bucket_bits = 4;
+  static constexpr std::uint64_t sub_buckets = 1ULL << sub_bucket_bits;
+  static constexpr unsigned max_exponent = 44;
+  static constexpr std::size_t bucket_count = (max_exponent - sub_bucket_bits + 2) * sub_buckets;
+
+  static constexpr std::size_t bucket_index(std::uint64_t value) noexcept {
+    if (value < sub_buckets) return static_cast<std::size_t>(value);
+    const unsigned exponent = static_cast<unsigned>(std::bit_width(value)) - 1;
+    if (exponent > max_exponent) return bucket_count - 1;
+    const unsigned shift = exponent - sub_bucket_bits;
+    return (shift + 1) * sub_buckets + ((value >> shift) & (sub_buckets - 1));
+  }
+
+  // Largest value that maps to bucket index.
+  static constexpr std::uint64_t bucket_upper(std::size_t index) noexcept {
+    if (index < sub_buckets) return index;
+    const auto shift = index / sub_buckets - 1;
+    const auto lower = (sub_buckets + index % sub_buckets) << shift;
+    return lower + (1ULL << shift) - 1;
+  }
+
+  void record(std::uint64_t value) noexcept {
+    ++buckets_[bucket_index(value)];
+    ++count_;
+    sum_ += value;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  // times samples of one value, as one bucket update.
+  void record(std::uint64_t value, std::uint64_t times) noexcept {
+    if (!times) return;
+    buckets_[bucket_index(value)] += times;
+    count_ += times;
+    sum_ += value * times;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  void merge(const LogHistogram &other) noexcept {
+    for (std::size_t index = 0; index < bucket_count; ++index) buckets_[index] += other.buckets_[index];
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+
+  [[nodiscard]] std::uint64_t count() const noexcept { return count_; }
+  [[nodiscard]] std::uint64_t min() const noexcept { return count_ ? min_ : 0; }
+  [[nodiscard]] std::uint64_t max() const noexcept { return max_; }
+  [[nodiscard]] double mean() const noexcept {
+    return count_ ? static_cast<double>(sum_) / static_cast<double>(count_) : 0.0;
+  }
+
+  // Nearest-rank quantile, reported as the upper edge of its bucket and never
+  // above the largest value recorded.
+  [[nodiscard]] std::uint64_t quantile(double q) const noexcept {
+    if (!count_) return 0;
+    const auto rank = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(std::ceil(q * static_cast<double>(count_))));
+    std::uint64_t seen = 0;
+    for (std::size_t index = 0; index < bucket_count; ++index) {
+      seen += buckets_[index];
+      if (seen >= rank) return std::min(bucket_upper(index), max_);
+    }
+    return max_;
+  }
+
+  // {"samples": N, "mean": ..., "p50": ..., ..., "max": ...}, the shape the
+  // sender's pacing_lateness_ns already uses.
+  void write_json(std::FILE *file) const {
+    std::fprintf(file, "{\"samples\": %llu, \"mean\": %.3f, \"min\": %llu, \"p50\": %llu, "
+        "\"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}",
+        static_cast<unsigned long long>(count_), mean(), static_cast<unsigned long long>(min()),
+        static_cast<unsigned long long>(quantile(.50)), static_cast<unsigned long long>(quantile(.90)),
+        static_cast<unsigned long long>(quantile(.99)), static_cast<unsigned long long>(quantile(.999)),
+        static_cast<unsigned long long>(max_));
+  }
+
+private:
+  std::array<std::uint64_t, bucket_count> buckets_{};
+  std::uint64_t count_ = 0;
+  std::uint64_t sum_ = 0;
+  std::uint64_t min_ = std::numeric_limits<std::uint64_t>::max();
+  std::uint64_t max_ = 0;
+};
+
+} // namespace nll
@@ -24,6 +24,78 @@ struct __attribute__((packed)) message_header {
   }
 };
 
+// Version 2 appends the time the sender meant to send the datagram, so a
+// receiver can measure from intent as well as from the actual send. Without it
+// a sender that falls behind its schedule stamps the late send time, and the
+// lateness vanishes from every latency the receiver reports (coordinated
+// omission). Both versions share the 16-byte message_header prefix; a v2
+// datagram carries a message_schedule straight after it.
+inline constexpr uint8_t message_version_v1 = 1;
+inline constexpr uint8_t message_version_v2 = 2;
+
+struct __attribute__((packed)) message_schedule {
+  uint64_t scheduled_unix_ns; // CLOCK_REALTIME; 0 when unscheduled (flood)
+
+  void to_network() { scheduled_unix_ns = htobe64(scheduled_unix_ns); }
+  void to_host() { scheduled_unix_ns = be64toh(scheduled_unix_ns); }
+};
+
+// Bytes before the payload (and before any flow_tag) for a header version.
+constexpr unsigned message_header_bytes(uint8_t version) {
+  return version == message_version_v2 ? sizeof(message_header) + sizeof(message_schedule)
+                                       : sizeof(message_header);
+}
+
+// msg_type bit: a flow_tag follows the header, at message_header_bytes(). Set
+// only by a sender run with --flows and --flow-tag; receivers that ignore
+// msg_type read such datagrams exactly as before.
+inline constexpr uint8_t msg_flag_flow_tag = 0x80;
+
+// The sender's flow index, so a sharded receiver can attribute a datagram to
+// its flow without relying on the source port surviving NAT or a proxy, and a
+// dense per-flow sequence: seq_idx is drawn from a counter shared by all of a
+// sender's workers, so on its own it leaves holes in every flow.
+struct __attribute__((packed)) flow_tag {
+  uint16_t flow_id;
+  uint16_t reserved;
+  uint32_t flow_sequence;
+
+  void to_network() { flow_id = htobe16(flow_id); flow_sequence = htobe32(flow_sequence); }
+  void to_host() { flow_id = be16toh(flow_id); flow_sequence = be32toh(flow_sequence); }
+};
+
+// msg_type values, in the bits below msg_flag_flow_tag. Data is 0, which is
+// all a sender wrote before clock probes existed.
+inline constexpr uint8_t msg_type_mask = 0x7f;
+inline constexpr uint8_t msg_type_data = 0;
+inline constexpr uint8_t msg_type_clock_probe = 1;
+inline constexpr uint8_t msg_type_clock_reply = 2;
+
+// Follows a v1 message_header in both clock messages (see clock_sync.hpp).
+// seq_idx numbers the round and send_unix_ns is the sender's t1 in a probe and
+// the receiver's t3 in a reply. A probe also carries the sender's t4 for the
+// round before it, so the receiver can complete that round as well.
+struct __attribute__((packed)) clock_exchange {
+  uint32_t previous_round;
+  uint32_t reserved;
+  uint64_t origin_unix_ns;          // reply: the probe's t1
+  uint64_t receive_unix_ns;         // reply: t2
+  uint64_t previous_return_unix_ns; // probe: t4 of previous_round, 0 if lost
+
+  void to_network() {
+    previous_round = htobe32(previous_round);
+    origin_unix_ns = htobe64(origin_unix_ns);
+    receive_unix_ns = htobe64(receive_unix_ns);
+    previous_return_unix_ns = htobe64(previous_return_unix_ns);
+  }
+  void to_host() {
+    previous_round = be32toh(previous_round);
+    origin_unix_ns = be64toh(origin_unix_ns);
+    receive_unix_ns = be64toh(receive_unix_ns);
+    previous_return_unix_ns = be64toh(previous_return_unix_ns);
+  }
+};
+
 enum class payload { TINY = 16, SMALL = 256, MEDIUM = 1024 };
 
 } // namespace nll
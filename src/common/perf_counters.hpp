@@ -0,0 +1,205 @@
+#pragma once
+
+#include "common/log.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace nll::perf {
+
+// In-process hardware counters for one hot loop.
+//
+// `perf record` in a separate phase answers "where does the time go" but not
+// "why is this variant's capacity lower in this run", because the profile and
+// the throughput number come from different runs. A StageCounters group is
+// opened by the thread that runs the loop, enabled just before it and disabled
+// just after, so the counts cover exactly the packets the stats report and
+// can be divided by them.
+//
+// Events are opened as one group so they are scheduled onto the PMU together
+// and their ratios (IPC, misses per packet) are consistent. An event the host
+// cannot count (no PMU under a VM, a missing cache event on the A72) is left
+// out and reported unavailable rather than failing the run. With
+// perf_event_paranoid >= 2 the kernel refuses kernel-side counting to
+// unprivileged users; the group then falls back to user-only and says so,
+// since the receive syscalls are then invisible to it.
+enum Event : std::size_t {
+  cycles, instructions, l1d_read_misses, llc_misses, branch_misses, context_switches
+};
+inline constexpr std::size_t event_count = 6;
+inline constexpr std::array<const char *, event_count> event_names{
+    "cycles", "instructions", "l1d_read_misses", "llc_misses", "branch_misses",
+    "context_switches"};
+
+struct Reading {
+  bool available = false;
+  bool kernel_included = false;
+  std::array<bool, event_count> counted{};
+  std::array<std::uint64_t, event_count> values{};
+  std::uint64_t time_enabled_ns = 0;
+  std::uint64_t time_running_ns = 0;
+};
+
+class StageCounters {
+public:
+  StageCounters() = default;
+  // Counts the calling thread only, on whichever CPU it runs.
+  explicit StageCounters(bool enabled) {
+    if (!enabled) return;
+    if (!open_group(false)) open_group(true);
+    if (leader_ < 0) NLL_WARN("No perf events could be opened; counters disabled\n");
+  }
+  ~StageCounters() { close_all(); }
+  StageCounters(const StageCounters &) = delete;
+  StageCounters &operator=(const StageCounters &) = delete;
+
+  [[nodiscard]] bool enabled() const noexcept { return leader_ >= 0; }
+
+  void start() noexcept {
+    if (leader_ < 0) return;
+    ::ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ::ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+
+  // Disables the group and returns its totals, scaled up if the PMU had to
+  // multiplex the group with other users.
+  Reading stop() noexcept {
+    Reading reading;
+    if (leader_ < 0) return reading;
+    ::ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    // PERF_FORMAT_GROUP layout: nr, time_enabled, time_running, values[nr].
+    std::array<std::uint64_t, 3 + event_count> buffer{};
+    if (::read(leader_, buffer.data(), sizeof(buffer)) < static_cast<ssize_t>(3 * sizeof(std::uint64_t)))
+      return reading;
+    reading.available = true;
+    reading.kernel_included = kernel_included_;
+    reading.time_enabled_ns = buffer[1];
+    reading.time_running_ns = buffer[2];
+    const double scale = buffer[2] && buffer[2] < buffer[1]
+        ? static_cast<double>(buffer[1]) / static_cast<double>(buffer[2]) : 1.0;
+    for (std::size_t slot = 0; slot < buffer[0] && slot < event_count; ++slot) {
+      const auto event = order_[slot];
+      reading.counted[event] = true;
+      reading.values[event] = static_cast<std::uint64_t>(static_cast<double>(buffer[3 + slot]) * scale);
+    }
+    return reading;
+  }
+
+private:
+  static perf_event_attr attribute(Event event, bool user_only) noexcept {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (event) {
+    case cycles: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+    case instructions: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+    case l1d_read_misses:
+      attr.type = PERF_TYPE_HW_CACHE;
+      attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+      break;
+    case llc_misses: attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+    case branch_misses: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+    case context_switches:
+      attr.type = PERF_TYPE_SOFTWARE;
+      attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+      break;
+    }
+    attr.disabled = 1;
+    attr.exclude_kernel = user_only ? 1 : 0;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return attr;
+  }
+
+  // The first event that opens leads the group; later ones join it. Returns
+  // false only when kernel counting was refused, so the caller retries user-only.
+  bool open_group(bool user_only) noexcept {
+    for (std::size_t index = 0; index < event_count; ++index) {
+      auto attr = attribute(static_cast<Event>(index), user_only);
+      const int fd = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, leader_, 0));
+      if (fd < 0) {
+        if (!user_only && (errno == EACCES || errno == EPERM)) {
+          close_all();
+          return false;
+        }
+        continue;
+      }
+      if (leader_ < 0) leader_ = fd;
+      fds_[members_] = fd;
+      order_[members_++] = static_cast<Event>(index);
+    }
+    kernel_included_ = !user_only;
+    return true;
+  }
+
+  void close_all() noexcept {
+    for (std::size_t index = 0; index < members_; ++index) ::close(fds_[index]);
+    members_ = 0;
+    leader_ = -1;
+  }
+
+  int leader_ = -1;
+  bool kernel_included_ = false;
+  std::size_t members_ = 0;
+  std::array<int, event_count> fds_{};
+  std::array<Event, event_count> order_{};
+};
+
+inline void accumulate(Reading &total, const Reading &part) noexcept {
+  if (!part.available) return;
+  total.available = true;
+  total.kernel_included = part.kernel_included;
+  total.time_enabled_ns += part.time_enabled_ns;
+  total.time_running_ns += part.time_running_ns;
+  for (std::size_t event = 0; event < event_count; ++event) {
+    total.counted[event] = total.counted[event] || part.counted[event];
+    total.values[event] += part.values[event];
+  }
+}
+
+// One JSON object: raw totals, the IPC, and every counter divided by the
+// number of packets the stage handled. Unavailable events are null.
+inline void write_json(std::FILE *file, const Reading &reading, std::uint64_t packets) {
+  if (!reading.available) {
+    std::fprintf(file, "{\"available\": false}");
+    return;
+  }
+  std::fprintf(file, "{\"available\": true, \"scope\": \"%s\", \"packets\": %llu, "
+               "\"running_fraction\": %.4f, \"totals\": {",
+               reading.kernel_included ? "user+kernel" : "user",
+               static_cast<unsigned long long>(packets),
+               reading.time_enabled_ns
+                   ? static_cast<double>(reading.time_running_ns) / static_cast<double>(reading.time_enabled_ns)
+                   : 0.0);
+  for (std::size_t event = 0; event < event_count; ++event) {
+    if (reading.counted[event])
+      std::fprintf(file, "%s\"%s\": %llu", event ? ", " : "", event_names[event],
+                   static_cast<unsigned long long>(reading.values[event]));
+    else
+      std::fprintf(file, "%s\"%s\": null", event ? ", " : "", event_names[event]);
+  }
+  std::fprintf(file, "}, \"per_packet\": {");
+  for (std::size_t event = 0; event < event_count; ++event) {
+    if (reading.counted[event] && packets)
+      std::fprintf(file, "%s\"%s\": %.3f", event ? ", " : "", event_names[event],
+                   static_cast<double>(reading.values[event]) / static_cast<double>(packets));
+    else
+      std::fprintf(file, "%s\"%s\": null", event ? ", " : "", event_names[event]);
+  }
+  if (reading.counted[cycles] && reading.counted[instructions] && reading.values[cycles])
+    std::fprintf(file, "}, \"ipc\": %.3f}", static_cast<double>(reading.values[instructions]) /
+                                                static_cast<double>(reading.values[cycles]));
+  else
+    std::fprintf(file, "}, \"ipc\": null}");
+}
+
+} // namespace nll::perf
@@ -1,11 +1,69 @@
 #pragma once
 
 #include <array>
+#include <bit>
+#include <cstddef>
 #include <cstdint>
 #include <limits>
 
 namespace nll {
 
+// One hole in the sequence space, recorded when the arrival that jumps past it
+// reveals it. revealed_ns is that arrival's monotonic receive time, so the
+// event lines up with the rest of the receiver's mono timeline.
+struct GapEvent {
+  std::uint32_t first_sequence = 0;
+  std::uint32_t length = 0;
+  std::uint64_t revealed_ns = 0;
+};
+
+// Loss structure in constant memory: a ring of the most recent gap events plus
+// a log2 histogram of every burst length. Total loss alone cannot separate one
+// socket-buffer overflow of 500 packets from 500 isolated NIC drops; the burst
+// shape can. The ring keeps the latest events because an overload run goes bad
+// at the end, and the histogram still counts every burst the ring has retired.
+//
+// A hole later filled by a reordered arrival stays in the timeline: events
+// describe what the receiver saw when it saw it. Reordering is disqualified
+// upstream above 0.01%, so such events are rare and are visible as
+// reordered() in the same stats file.
+class GapTimeline {
+public:
+  static constexpr std::size_t event_capacity = 256;
+  // Bucket b counts bursts of length [2^b, 2^(b+1)); a u32 length needs 32.
+  static constexpr std::size_t histogram_buckets = 32;
+  static_assert(std::has_single_bit(event_capacity),
+                "event_capacity must be a power of 2 for the ring index");
+
+  void record(std::uint32_t first_sequence, std::uint32_t length,
+              std::uint64_t revealed_ns) noexcept {
+    events_[recorded_ & (event_capacity - 1)] = {
+        .first_sequence = first_sequence, .length = length, .revealed_ns = revealed_ns};
+    ++recorded_;
+    ++histogram_[static_cast<std::size_t>(std::bit_width(length)) - 1];
+  }
+
+  [[nodiscard]] std::uint64_t recorded() const noexcept { return recorded_; }
+  [[nodiscard]] std::size_t retained() const noexcept {
+    return recorded_ < event_capacity ? static_cast<std::size_t>(recorded_) : event_capacity;
+  }
+  // Retained events in arrival order; index 0 is the oldest still held.
+  [[nodiscard]] const GapEvent &event(std::size_t index) const noexcept {
+    const auto oldest = recorded_ - retained();
+    return events_[(oldest + index) & (event_capacity - 1)];
+  }
+  [[nodiscard]] const std::array<std::uint64_t, histogram_buckets> &
+  burst_histogram() const noexcept { return histogram_; }
+  static constexpr std::uint64_t bucket_floor(std::size_t bucket) noexcept {
+    return std::uint64_t{1} << bucket;
+  }
+
+private:
+  std::array<GapEvent, event_capacity> events_{};
+  std::array<std::uint64_t, histogram_buckets> histogram_{};
+  std::uint64_t recorded_ = 0;
+};
+
 // Exact online accounting without retaining one record per packet.
 //
 // The bitmap is a direct-mapped ring of block_count blocks, each covering
@@ -25,9 +83,13 @@ namespace nll {
 // 0.01% is disqualified upstream, so 65536 sequence numbers of lookback is far
 // more history than the stream can use. Arrivals older than the retained window
 // are counted in out_of_window() rather than being silently treated as unique.
+//
+// The gap timeline is only written when an arrival jumps past the high
+// watermark, so on a loss-free stream it is never touched and does not compete
+// with the bitmap for L1.
 class SequenceTracker {
 public:
-  bool observe(std::uint32_t sequence) {
+  bool observe(std::uint32_t sequence, std::uint64_t now_ns = 0) {
     const std::uint64_t epoch = std::uint64_t{sequence >> block_shift} + 1;
     const std::size_t slot = (sequence >> block_shift) & (block_count - 1);
     std::uint64_t &resident = epochs_[slot];
@@ -56,7 +118,11 @@ public:
     if (unique_ != 0 && sequence < high_watermark_) ++reordered_;
     if (unique_ == 0) minimum_ = sequence;
     if (sequence < minimum_) minimum_ = sequence;
-    if (sequence > high_watermark_) high_watermark_ = sequence;
+    if (sequence > high_watermark_) {
+      if (unique_ != 0 && sequence - high_watermark_ > 1)
+        timeline_.record(high_watermark_ + 1, sequence - high_watermark_ - 1, now_ns);
+      high_watermark_ = sequence;
+    }
     ++unique_;
     return true;
   }
@@ -65,6 +131,7 @@ public:
   [[nodiscard]] std::uint64_t duplicates() const noexcept { return duplicates_; }
   [[nodiscard]] std::uint64_t reordered() const noexcept { return reordered_; }
   [[nodiscard]] std::uint64_t out_of_window() const noexcept { return out_of_window_; }
+  [[nodiscard]] const GapTimeline &gap_timeline() const noexcept { return timeline_; }
   [[nodiscard]] std::uint64_t gaps() const noexcept {
     if (unique_ == 0) return 0;
     const std::uint64_t span =
@@ -92,6 +159,8 @@ private:
   std::uint64_t out_of_window_ = 0;
   std::uint32_t minimum_ = std::numeric_limits<std::uint32_t>::max();
   std::uint32_t high_watermark_ = 0;
+  // Last, so the cold timeline does not split the hot counters above.
+  GapTimeline timeline_;
 };
 
 } // namespace nll
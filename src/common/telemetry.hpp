@@ -0,0 +1,228 @@
+#pragma once
+
+#include "common/log.hpp"
+#include "common/spsc_queue.hpp"
+#include "common/time.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace nll::telemetry {
+
+// Live counters for a running receiver or sender, published through a
+// POSIX shared-memory page at /dev/shm/nll-<pid>.
+//
+// Statistics are otherwise written once at exit, and the timed interval bans
+// SSH polling, so a multi-minute run used to be opaque until it ended. Reading
+// this page costs the measured process nothing but the occasional cache-line
+// transfer: each hot thread owns one block, updates it with relaxed stores under
+// a seqlock, and never waits for or learns about the reader. The reader retries
+// a block whose sequence was odd or moved while it was copying.
+//
+// Every block is exactly one cache line, so two writers never share a line and
+// the reader only ever pulls a line away from the one thread that owns it.
+
+inline constexpr std::uint64_t page_magic = 0x314d'4c45'544c'4c4eULL; // "NLLTELM1"
+inline constexpr std::uint32_t page_version = 1;
+inline constexpr std::size_t counters_per_block = 7;
+inline constexpr std::size_t max_blocks = 130; // 128 sender workers plus slack
+
+enum class Role : std::uint32_t { receiver = 1, sender = 2 };
+
+// Receiver block 0 belongs to the ingress thread and block 1 to whichever
+// thread runs process_packet. Queue depth is not published: reading the SPSC
+// tail from ingress would pull the worker's line on every batch, and the reader
+// derives the same number as (valid - overflow - processed).
+enum ReceiverCounter : std::size_t {
+  datagrams_received, valid_packets, processed_packets, spsc_overflow,
+  receive_syscalls, socket_errors, receive_sequence_gaps
+};
+
+// One block per sender worker. lateness_max_ns is a gauge, and planned_sends is
+// the worker's share of the schedule (zero in flood mode), so the reader can
+// turn attempted_sends into run progress.
+enum SenderCounter : std::size_t {
+  attempted_sends, successful_sends, failed_sends, syscall_count,
+  error_returns, lateness_max_ns, planned_sends
+};
+
+inline constexpr std::array<const char *, counters_per_block> receiver_counter_names{
+    "datagrams_received", "valid_packets", "processed_packets", "spsc_overflow",
+    "receive_syscalls", "socket_errors", "receive_sequence_gaps"};
+inline constexpr std::array<const char *, counters_per_block> sender_counter_names{
+    "attempted_sends", "successful_sends", "failed_sends", "syscall_count",
+    "error_returns", "lateness_max_ns", "planned_sends"};
+
+using Counters = std::array<std::uint64_t, counters_per_block>;
+
+struct alignas(nll::cache_line_size) Block {
+  std::atomic<std::uint64_t> sequence{0};
+  std::array<std::atomic<std::uint64_t>, counters_per_block> counters{};
+};
+static_assert(sizeof(Block) == nll::cache_line_size, "one writer per cache line");
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "counters are shared across processes and must not use a lock");
+
+struct alignas(nll::cache_line_size) PageHeader {
+  std::uint64_t magic;
+  std::uint32_t version;
+  Role role;
+  std::int32_t pid;
+  std::uint32_t block_count;
+  std::uint64_t start_mono_ns;
+  char variant[32];
+};
+
+struct Page {
+  PageHeader header;
+  std::array<Block, max_blocks> blocks;
+};
+
+inline std::string page_name(int pid) { return "/nll-" + std::to_string(pid); }
+
+// Single-writer handle for one block. A default-constructed publisher is
+// disabled, so call sites stay unconditional when telemetry is off.
+class Publisher {
+public:
+  Publisher() = default;
+  explicit Publisher(Block *block) noexcept : block_(block) {}
+
+  void publish(const Counters &values) noexcept {
+    if (!block_) return;
+    block_->sequence.store(sequence_ + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (std::size_t index = 0; index < counters_per_block; ++index)
+      block_->counters[index].store(values[index], std::memory_order_relaxed);
+    sequence_ += 2;
+    block_->sequence.store(sequence_, std::memory_order_release);
+  }
+
+  [[nodiscard]] bool enabled() const noexcept { return block_ != nullptr; }
+
+private:
+  Block *block_ = nullptr;
+  std::uint64_t sequence_ = 0;
+};
+
+// Owns the page for the lifetime of the process and unlinks it on exit so a
+// finished run leaves nothing behind in /dev/shm.
+class SharedPage {
+public:
+  SharedPage() = default;
+  SharedPage(Role role, std::string_view variant, std::uint32_t block_count) {
+    if (block_count == 0 || block_count > max_blocks) {
+      NLL_ERROR("Telemetry page cannot hold %u blocks\n", block_count);
+      return;
+    }
+    name_ = page_name(static_cast<int>(::getpid()));
+    const int fd = ::shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+      NLL_WARN("Telemetry page %s unavailable: %s\n", name_.c_str(), std::strerror(errno));
+      return;
+    }
+    void *mapping = MAP_FAILED;
+    if (::ftruncate(fd, sizeof(Page)) == 0)
+      mapping = ::mmap(nullptr, sizeof(Page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+      NLL_WARN("Telemetry page %s could not be mapped: %s\n", name_.c_str(), std::strerror(errno));
+      ::shm_unlink(name_.c_str());
+      return;
+    }
+    page_ = new (mapping) Page{};
+    page_->header.version = page_version;
+    page_->header.role = role;
+    page_->header.pid = static_cast<std::int32_t>(::getpid());
+    page_->header.block_count = block_count;
+    page_->header.start_mono_ns = nll::mono_ns();
+    const auto length = std::min(variant.size(), sizeof(page_->header.variant) - 1);
+    std::memcpy(page_->header.variant, variant.data(), length);
+    // Magic last: a reader that sees it also sees a complete header.
+    std::atomic_thread_fence(std::memory_order_release);
+    page_->header.magic = page_magic;
+  }
+
+  ~SharedPage() {
+    if (!page_) return;
+    ::munmap(page_, sizeof(Page));
+    ::shm_unlink(name_.c_str());
+  }
+  SharedPage(const SharedPage &) = delete;
+  SharedPage &operator=(const SharedPage &) = delete;
+
+  [[nodiscard]] bool valid() const noexcept { return page_ != nullptr; }
+  [[nodiscard]] std::string path() const { return page_ ? "/dev/shm" + name_ : ""; }
+  [[nodiscard]] Publisher publisher(std::uint32_t block) noexcept {
+    if (!page_ || block >= page_->header.block_count) return {};
+    return Publisher(&page_->blocks[block]);
+  }
+
+private:
+  Page *page_ = nullptr;
+  std::string name_;
+};
+
+// Read-only view used by the nll_telemetry tool.
+class Reader {
+public:
+  explicit Reader(int pid) {
+    const auto name = page_name(pid);
+    const int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return;
+    // The owner sizes the object before writing the magic; mapping a page that
+    // is still empty would fault on the first read.
+    struct stat status{};
+    if (::fstat(fd, &status) != 0 || static_cast<std::size_t>(status.st_size) < sizeof(Page)) {
+      ::close(fd);
+      return;
+    }
+    void *mapping = ::mmap(nullptr, sizeof(Page), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) return;
+    page_ = static_cast<const Page *>(mapping);
+    if (page_->header.magic != page_magic || page_->header.version != page_version) {
+      ::munmap(const_cast<Page *>(page_), sizeof(Page));
+      page_ = nullptr;
+    }
+  }
+  ~Reader() { if (page_) ::munmap(const_cast<Page *>(page_), sizeof(Page)); }
+  Reader(const Reader &) = delete;
+  Reader &operator=(const Reader &) = delete;
+
+  [[nodiscard]] bool valid() const noexcept { return page_ != nullptr; }
+  [[nodiscard]] const PageHeader &header() const noexcept { return page_->header; }
+
+  // Returns nullopt only if the writer kept the block busy for every attempt.
+  [[nodiscard]] std::optional<Counters> snapshot(std::uint32_t block,
+                                                 int attempts = 1000) const noexcept {
+    const auto &source = page_->blocks[block];
+    for (int attempt = 0; attempt < attempts; ++attempt) {
+      const auto before = source.sequence.load(std::memory_order_acquire);
+      if (before & 1U) continue;
+      Counters values{};
+      for (std::size_t index = 0; index < counters_per_block; ++index)
+        values[index] = source.counters[index].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (source.sequence.load(std::memory_order_relaxed) == before) return values;
+    }
+    return std::nullopt;
+  }
+
+private:
+  const Page *page_ = nullptr;
+};
+
+} // namespace nll::telemetry
@@ -1,8 +1,17 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <ctime>
+#include <optional>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
 
 namespace nll {
 
@@ -28,4 +37,283 @@ inline void sleep_ns(std::uint64_t ns) noexcept {
   nanosleep(&req, nullptr);
 }
 
+// Raw architectural counter. Both reads are ordered the way the vDSO orders
+// them inside clock_gettime (lfence / isb), so a stamp cannot drift into or out
+// of the work it brackets; what is saved is the vDSO call, the seqcount loop
+// over the timekeeper and the timespec split and recombine.
+#if defined(__x86_64__) || defined(__i386__)
+inline constexpr bool has_cycle_counter = true;
+inline std::uint64_t read_cycles() noexcept {
+  _mm_lfence();
+  return __rdtsc();
+}
+// Without an invariant TSC the rate follows frequency scaling and stops in deep
+// C-states, and no calibration survives that.
+inline bool cycle_counter_usable() noexcept {
+  unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (!__get_cpuid(0x80000007U, &eax, &ebx, &ecx, &edx)) return false;
+  return (edx & (1U << 8)) != 0;
+}
+#elif defined(__aarch64__)
+inline constexpr bool has_cycle_counter = true;
+inline std::uint64_t read_cycles() noexcept {
+  std::uint64_t value;
+  asm volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(value) : : "memory");
+  return value;
+}
+// The generic timer is architecturally constant-rate and system-wide. On the
+// Pi 4 it runs at 54 MHz, so a tick is 18.5 ns; clock_gettime reads the same
+// counter and cannot resolve any finer.
+inline bool cycle_counter_usable() noexcept { return true; }
+#else
+inline constexpr bool has_cycle_counter = false;
+inline std::uint64_t read_cycles() noexcept { return mono_ns(); }
+inline bool cycle_counter_usable() noexcept { return false; }
+#endif
+
+// Converts counter ticks to CLOCK_MONOTONIC_RAW and CLOCK_REALTIME nanoseconds.
+//
+// calibrate() measures the counter rate against CLOCK_MONOTONIC_RAW over a short
+// window. The conversion is anchor + (ticks * mult) >> 32 with a 128-bit
+// product, which is a multiply-high and a multiply on both targets. reanchor()
+// takes a fresh clock_gettime pair and re-derives the rate over the whole span
+// since calibration, so the estimate improves the longer a run lasts. It does
+// not jump to the fresh pair: the new anchor is what the old parameters read at
+// that counter value, and mono and real each get a slewed multiplier that
+// closes the gap to clock_gettime by the next reanchor. Stamps stay continuous
+// and monotonic whichever way the error points, and the error stays bounded
+// instead of accumulating. A realtime gap too large to slew is a step of the
+// system clock itself and is taken as one. The largest mono gap is kept as the
+// observed drift.
+//
+// Readers on any thread take a seqlock snapshot of the anchor; only one owner
+// thread may call reanchor(), and it does so about once per second.
+class CycleClock {
+public:
+  static constexpr unsigned scale_shift = 32;
+
+  // Returns false when the platform has no usable constant-rate counter.
+  bool calibrate(std::uint64_t window_ns = 20'000'000ULL) noexcept {
+    if (!has_cycle_counter || !cycle_counter_usable()) return false;
+    const auto first = paired_sample();
+    sleep_ns(window_ns);
+    const auto second = paired_sample();
+    if (second.cycles <= first.cycles || second.mono_ns <= first.mono_ns) return false;
+    origin_ = first;
+    previous_ = second;
+    const auto mult = rate(first, second);
+    publish(second, mult, mult, mult);
+    reanchors_ = 0;
+    max_correction_ns_ = 0;
+    calibrated_ = true;
+    return true;
+  }
+
+  [[nodiscard]] bool calibrated() const noexcept { return calibrated_; }
+
+  [[nodiscard]] std::uint64_t mono_ns() const noexcept { return convert(false); }
+  [[nodiscard]] std::uint64_t real_ns() const noexcept { return convert(true); }
+
+  void reanchor() noexcept {
+    if (!calibrated_) return;
+    const auto fresh = paired_sample();
+    Anchor anchor{fresh.cycles, owner_at(fresh.cycles, false), owner_at(fresh.cycles, true)};
+    const auto mono_gap = static_cast<std::int64_t>(fresh.mono_ns - anchor.mono_ns);
+    const auto real_gap = static_cast<std::int64_t>(fresh.real_ns - anchor.real_ns);
+    max_correction_ns_ = std::max(max_correction_ns_, magnitude(mono_gap));
+    // Assume the next reanchor comes after the same spacing as this one.
+    const auto horizon_ns = std::max(fresh.mono_ns - previous_.mono_ns, min_horizon_ns);
+    const auto limit = horizon_ns / 2;
+    const auto base = rate(origin_, fresh);
+    auto real_mult = slew(base, real_gap, horizon_ns);
+    if (magnitude(real_gap) > limit) {
+      anchor.real_ns = fresh.real_ns;
+      real_mult = base;
+    }
+    publish(anchor, base, slew(base, mono_gap, horizon_ns), real_mult);
+    previous_ = fresh;
+    ++reanchors_;
+  }
+
+  // Owner thread, with a stamp it already took: re-anchors once per interval
+  // without reading the counter again.
+  void maybe_reanchor(std::uint64_t now_mono_ns) noexcept {
+    if (now_mono_ns < next_reanchor_ns_) return;
+    if (next_reanchor_ns_ != 0) reanchor();
+    next_reanchor_ns_ = now_mono_ns + reanchor_interval_ns;
+  }
+
+  // Owner thread: skews the rate by ppm from here on, as if calibration had
+  // measured the counter that much slow (positive ppm runs stamps fast), until
+  // the next reanchor re-derives it. For tests of how reanchoring recovers.
+  void detune(std::int64_t ppm) noexcept {
+    __extension__ using wide = __int128;
+    const auto cycles = read_cycles();
+    const auto mult = static_cast<std::uint64_t>(
+        static_cast<wide>(rate_.load(std::memory_order_relaxed)) * (1'000'000 + ppm) / 1'000'000);
+    publish({cycles, owner_at(cycles, false), owner_at(cycles, true)}, mult, mult, mult);
+  }
+
+  [[nodiscard]] double frequency_hz() const noexcept {
+    const auto mult = rate_.load(std::memory_order_relaxed);
+    return mult ? 1e9 * static_cast<double>(1ULL << scale_shift) / static_cast<double>(mult)
+                : 0.0;
+  }
+  [[nodiscard]] double resolution_ns() const noexcept {
+    const auto hz = frequency_hz();
+    return hz > 0.0 ? 1e9 / hz : 0.0;
+  }
+  [[nodiscard]] std::uint64_t reanchors() const noexcept { return reanchors_; }
+  [[nodiscard]] std::uint64_t max_correction_ns() const noexcept { return max_correction_ns_; }
+
+private:
+  static constexpr std::uint64_t reanchor_interval_ns = a_billi;
+  // Floor on the slew horizon, so back-to-back reanchors cannot swing the rate.
+  static constexpr std::uint64_t min_horizon_ns = 1'000'000ULL;
+
+  struct Anchor {
+    std::uint64_t cycles = 0;
+    std::uint64_t mono_ns = 0;
+    std::uint64_t real_ns = 0;
+  };
+
+  // Keeps the tightest of a few counter brackets around the clock_gettime pair,
+  // so a preemption or interrupt inside one attempt does not skew the anchor.
+  static Anchor paired_sample() noexcept {
+    Anchor best{};
+    std::uint64_t best_span = ~0ULL;
+    for (int attempt = 0; attempt < 8; ++attempt) {
+      const auto before = read_cycles();
+      const auto mono = nll::mono_ns();
+      const auto real = nll::real_ns();
+      const auto after = read_cycles();
+      if (after - before < best_span) {
+        best_span = after - before;
+        best = {before + (after - before) / 2, mono, real};
+      }
+    }
+    return best;
+  }
+
+  static std::uint64_t rate(const Anchor &from, const Anchor &to) noexcept {
+    __extension__ using wide = unsigned __int128;
+    return static_cast<std::uint64_t>(
+        (static_cast<wide>(to.mono_ns - from.mono_ns) << scale_shift) / (to.cycles - from.cycles));
+  }
+
+  static std::uint64_t magnitude(std::int64_t gap) noexcept {
+    return gap < 0 ? 0 - static_cast<std::uint64_t>(gap) : static_cast<std::uint64_t>(gap);
+  }
+
+  // Multiplier that makes up gap over horizon_ns on top of the base rate. The
+  // gap is clamped to half the horizon, so the result stays within half the
+  // base rate either way and a stamp can never step backwards.
+  static std::uint64_t slew(std::uint64_t base, std::int64_t gap, std::uint64_t horizon_ns) noexcept {
+    __extension__ using wide = __int128;
+    const auto limit = static_cast<std::int64_t>(horizon_ns / 2);
+    const auto bounded = std::clamp(gap, -limit, limit);
+    return static_cast<std::uint64_t>(
+        static_cast<wide>(base) + static_cast<wide>(base) * bounded / static_cast<wide>(horizon_ns));
+  }
+
+  void publish(const Anchor &anchor, std::uint64_t rate, std::uint64_t mono_mult,
+               std::uint64_t real_mult) noexcept {
+    const auto sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    anchor_cycles_.store(anchor.cycles, std::memory_order_relaxed);
+    anchor_mono_ns_.store(anchor.mono_ns, std::memory_order_relaxed);
+    anchor_real_ns_.store(anchor.real_ns, std::memory_order_relaxed);
+    rate_.store(rate, std::memory_order_relaxed);
+    mono_mult_.store(mono_mult, std::memory_order_relaxed);
+    real_mult_.store(real_mult, std::memory_order_relaxed);
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  static std::uint64_t scale(std::uint64_t base, std::uint64_t anchor_cycles,
+                             std::uint64_t cycles, std::uint64_t mult) noexcept {
+    __extension__ using wide = unsigned __int128;
+    // Another core's counter may read a few ticks behind the anchor.
+    const auto delta = cycles > anchor_cycles ? cycles - anchor_cycles : 0;
+    return base + static_cast<std::uint64_t>((static_cast<wide>(delta) * mult) >> scale_shift);
+  }
+
+  std::uint64_t convert(bool real) const noexcept {
+    for (;;) {
+      const auto sequence = sequence_.load(std::memory_order_acquire);
+      const auto cycles = read_cycles();
+      const auto anchor_cycles = anchor_cycles_.load(std::memory_order_relaxed);
+      const auto base = (real ? anchor_real_ns_ : anchor_mono_ns_).load(std::memory_order_relaxed);
+      const auto mult = (real ? real_mult_ : mono_mult_).load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (!(sequence & 1U) && sequence_.load(std::memory_order_relaxed) == sequence)
+        return scale(base, anchor_cycles, cycles, mult);
+    }
+  }
+
+  // Owner-side conversion at a given counter value; no seqlock needed because
+  // only the owner writes the anchor.
+  std::uint64_t owner_at(std::uint64_t cycles, bool real) const noexcept {
+    return scale((real ? anchor_real_ns_ : anchor_mono_ns_).load(std::memory_order_relaxed),
+                 anchor_cycles_.load(std::memory_order_relaxed), cycles,
+                 (real ? real_mult_ : mono_mult_).load(std::memory_order_relaxed));
+  }
+
+  std::atomic<std::uint64_t> sequence_{0};
+  std::atomic<std::uint64_t> anchor_cycles_{0};
+  std::atomic<std::uint64_t> anchor_mono_ns_{0};
+  std::atomic<std::uint64_t> anchor_real_ns_{0};
+  std::atomic<std::uint64_t> mono_mult_{0};
+  std::atomic<std::uint64_t> real_mult_{0};
+  std::atomic<std::uint64_t> rate_{0};  // unslewed, for frequency_hz()
+  // Owner-only state below.
+  Anchor origin_{};
+  Anchor previous_{};
+  std::uint64_t next_reanchor_ns_ = 0;
+  std::uint64_t reanchors_ = 0;
+  std::uint64_t max_correction_ns_ = 0;
+  bool calibrated_ = false;
+};
+
+// Clock behind the per-packet and per-batch stamps in the receivers and sender.
+// "system" is clock_gettime, which costs tens of nanoseconds on the Pi and is
+// therefore part of the per-packet budget being measured; "cycles" is the
+// calibrated counter above. Selected once at startup, before any thread starts,
+// so the hot-path branch is perfectly predicted.
+enum class ClockSource : std::uint8_t { system, cycles };
+
+inline ClockSource timestamp_source = ClockSource::system;
+inline CycleClock timestamp_clock;
+
+inline std::optional<ClockSource> parse_clock_source(std::string_view name) noexcept {
+  if (name == "system") return ClockSource::system;
+  if (name == "cycles") return ClockSource::cycles;
+  return std::nullopt;
+}
+
+inline const char *clock_source_name(ClockSource source) noexcept {
+  return source == ClockSource::cycles ? "cycles" : "system";
+}
+
+// Returns false if the cycle counter is unavailable or fails to calibrate; the
+// source then stays on clock_gettime.
+inline bool select_timestamp_source(ClockSource source) noexcept {
+  if (source == ClockSource::cycles && !timestamp_clock.calibrate()) return false;
+  timestamp_source = source;
+  return true;
+}
+
+inline std::uint64_t stamp_mono_ns() noexcept {
+  return timestamp_source == ClockSource::cycles ? timestamp_clock.mono_ns() : mono_ns();
+}
+
+inline std::uint64_t stamp_real_ns() noexcept {
+  return timestamp_source == ClockSource::cycles ? timestamp_clock.real_ns() : real_ns();
+}
+
+// Called by exactly one thread per process with a stamp it already holds.
+inline void maintain_timestamp_clock(std::uint64_t now_mono_ns) noexcept {
+  if (timestamp_source == ClockSource::cycles) timestamp_clock.maybe_reanchor(now_mono_ns);
+}
+
 } // namespace nll
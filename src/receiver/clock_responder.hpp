@@ -0,0 +1,145 @@
+#pragma once
+
+#include "common/clock_sync.hpp"
+#include "common/log.hpp"
+#include "common/packet.hpp"
+#include "common/time.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <vector>
+
+namespace nll::receiver {
+
+// Receiver half of the in-band clock exchange, for --clock-log.
+//
+// A probe is answered from the ingress thread straight away, on the data
+// socket, to the address it came from: t2 is the probe's batch receive time
+// and t3 is stamped just before the sendto. Probes arrive a few times a
+// second, so the syscall is negligible next to the load. The t4 the next probe
+// carries completes the round here as well, and every completed round is kept
+// with the running estimate for the clock log written after the run. Analysis
+// subtracts the estimated offset from each one-way sample.
+class ClockResponder {
+public:
+  struct Round {
+    nll::clock_sync::Sample sample;
+    nll::clock_sync::Estimator::Estimate estimate;
+  };
+  // About a day of rounds at 10 Hz; later rounds still update the estimate.
+  static constexpr std::size_t max_logged_rounds = 1U << 20;
+  // Rounds are kept in fixed chunks, so the ingress thread never moves the
+  // ones already logged: a full chunk costs one allocation, not a copy of
+  // the whole log. About 7 minutes at 10 Hz each.
+  static constexpr std::size_t chunk_rounds = 4096;
+
+  void enable() {
+    enabled_ = true;
+    chunks_.reserve(max_logged_rounds / chunk_rounds);
+    add_chunk();
+  }
+  [[nodiscard]] bool enabled() const noexcept { return enabled_; }
+
+  void handle(int fd, const std::byte *data, std::size_t length, const sockaddr_in *source,
+              const nll::message_header &message, std::uint64_t receive_real_ns,
+              std::uint64_t receive_mono_ns) noexcept {
+    ++probes_;
+    const auto offset = nll::message_header_bytes(message.version);
+    if (!enabled_ || source == nullptr || length < offset + sizeof(nll::clock_exchange)) {
+      ++ignored_;
+      return;
+    }
+    nll::clock_exchange exchange{};
+    std::memcpy(&exchange, data + offset, sizeof(exchange));
+    exchange.to_host();
+    if (pending_.t1 && exchange.previous_round == pending_.round && exchange.previous_return_unix_ns) {
+      auto sample = pending_;
+      sample.t4 = exchange.previous_return_unix_ns;
+      sample.local_mono_ns = receive_mono_ns;
+      if (nll::clock_sync::complete(sample)) {
+        const auto &estimate = estimator_.add(sample);
+        if (logged_ < max_logged_rounds) {
+          if (chunks_.back().size() == chunk_rounds) add_chunk();
+          chunks_.back().push_back({sample, estimate});
+          ++logged_;
+        }
+      }
+    }
+    struct __attribute__((packed)) {
+      nll::message_header header;
+      nll::clock_exchange exchange;
+    } reply{};
+    const auto t3 = nll::stamp_real_ns();
+    reply.header = {.magic = 0x6584, .version = nll::message_version_v1,
+                    .msg_type = nll::msg_type_clock_reply, .seq_idx = message.seq_idx,
+                    .send_unix_ns = t3};
+    reply.exchange = {.previous_round = 0, .reserved = 0, .origin_unix_ns = message.send_unix_ns,
+                      .receive_unix_ns = receive_real_ns, .previous_return_unix_ns = 0};
+    reply.header.to_network();
+    reply.exchange.to_network();
+    if (::sendto(fd, &reply, sizeof(reply), MSG_DONTWAIT, reinterpret_cast<const sockaddr *>(source),
+                 sizeof(*source)) == static_cast<ssize_t>(sizeof(reply))) {
+      ++replies_;
+    } else {
+      ++reply_failures_;
+    }
+    pending_ = {.round = message.seq_idx, .t1 = message.send_unix_ns, .t2 = receive_real_ns, .t3 = t3};
+  }
+
+  [[nodiscard]] std::uint64_t probes() const noexcept { return probes_; }
+  [[nodiscard]] std::uint64_t replies() const noexcept { return replies_; }
+  [[nodiscard]] std::uint64_t reply_failures() const noexcept { return reply_failures_; }
+  [[nodiscard]] std::uint64_t ignored() const noexcept { return ignored_; }
+  [[nodiscard]] const nll::clock_sync::Estimator &estimator() const noexcept { return estimator_; }
+  [[nodiscard]] std::size_t logged_rounds() const noexcept { return logged_; }
+
+  // CSV, one completed round per line, for analysis to interpolate the
+  // estimated offset at each sample's receive time.
+  [[nodiscard]] bool write_log(const std::filesystem::path &path) const {
+    if (path.has_parent_path()) {
+      std::error_code ec;
+      std::filesystem::create_directories(path.parent_path(), ec);
+    }
+    std::FILE *file = std::fopen(path.c_str(), "w");
+    if (!file) {
+      NLL_ERROR("Cannot open clock log %s: %s\n", path.c_str(), std::strerror(errno));
+      return false;
+    }
+    std::fprintf(file, "# clock-v1: offset is receiver minus sender CLOCK_REALTIME\n"
+        "round,completed_mono_ns,t1_sender_unix_ns,t2_receiver_unix_ns,t3_receiver_unix_ns,"
+        "t4_sender_unix_ns,offset_ns,delay_ns,estimated_offset_ns,drift_ppb,rounds_used\n");
+    for (const auto &chunk : chunks_)
+      for (const auto &[sample, estimate] : chunk)
+        std::fprintf(file, "%u,%llu,%llu,%llu,%llu,%llu,%lld,%llu,%lld,%.3f,%u\n", sample.round,
+            static_cast<unsigned long long>(sample.local_mono_ns),
+            static_cast<unsigned long long>(sample.t1), static_cast<unsigned long long>(sample.t2),
+            static_cast<unsigned long long>(sample.t3), static_cast<unsigned long long>(sample.t4),
+            static_cast<long long>(sample.offset_ns), static_cast<unsigned long long>(sample.delay_ns),
+            static_cast<long long>(estimate.offset_ns), estimate.drift_ppb, estimate.used);
+    return std::fclose(file) == 0;
+  }
+
+private:
+  void add_chunk() {
+    chunks_.emplace_back();
+    chunks_.back().reserve(chunk_rounds);
+  }
+
+  bool enabled_ = false;
+  std::uint64_t probes_ = 0;
+  std::uint64_t replies_ = 0;
+  std::uint64_t reply_failures_ = 0;
+  std::uint64_t ignored_ = 0;
+  nll::clock_sync::Sample pending_{};
+  nll::clock_sync::Estimator estimator_;
+  std::vector<std::vector<Round>> chunks_;
+  std::size_t logged_ = 0;
+};
+
+} // namespace nll::receiver
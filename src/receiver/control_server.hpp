@@ -0,0 +1,135 @@
+#pragma once
+
+#include "common/control_protocol.hpp"
+#include "common/spsc_queue.hpp"
+#include "receiver/receiver_common.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace nll::receiver {
+
+// Answers --control snapshot requests; see common/control_protocol.hpp.
+//
+// The ingress and processing threads each mirror their totals into a cache
+// line they own with relaxed stores once per batch, after the batch, so a
+// receiver that has gone idle has already published its final counts. The
+// server thread reads the mirrors only when a request arrives. Individual
+// totals may be a batch apart from each other, which a client differencing
+// windows seconds long cannot see. Disabled, every call is a single branch.
+class ControlServer {
+public:
+  ControlServer(const Config &config, int data_fd) : data_fd_(data_fd) {
+    if (!config.control_port) return;
+    fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_ < 0 || !bind_socket(fd_, config.control_port)) {
+      if (fd_ >= 0) ::close(fd_);
+      fd_ = -1;
+      failed_ = true;
+      return;
+    }
+    // Created before the caller pins its threads, like the timeseries writer;
+    // it sleeps in poll() between requests.
+    server_ = std::thread([this] { serve(); });
+  }
+  ~ControlServer() { stop(); }
+  ControlServer(const ControlServer &) = delete;
+  ControlServer &operator=(const ControlServer &) = delete;
+
+  [[nodiscard]] bool failed() const noexcept { return failed_; }
+
+  void publish_ingress(const Stats &stats, const nll::SequenceTracker &sequences) noexcept {
+    if (fd_ < 0) return;
+    ingress_.datagrams_received.store(stats.datagrams_received, std::memory_order_relaxed);
+    ingress_.valid_packets.store(stats.valid_packets, std::memory_order_relaxed);
+    ingress_.unique_valid_packets.store(sequences.unique(), std::memory_order_relaxed);
+    ingress_.receive_sequence_gaps.store(sequences.gaps(), std::memory_order_relaxed);
+    ingress_.spsc_overflow.store(stats.spsc_overflow, std::memory_order_relaxed);
+  }
+
+  void publish_processing(const ProcessingStats &processing) noexcept {
+    if (fd_ < 0) return;
+    processing_.processed.store(processing.processed_packets, std::memory_order_relaxed);
+    processing_.latency_sum_ns.store(processing.latency_sum_ns, std::memory_order_relaxed);
+  }
+
+  // Stops answering and reports how many requests were served.
+  std::uint64_t stop() noexcept {
+    if (server_.joinable()) {
+      done_.store(true, std::memory_order_release);
+      server_.join();
+    }
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    return requests_;
+  }
+
+private:
+  static constexpr int poll_timeout_ms = 100;
+
+  void serve() {
+    while (!done_.load(std::memory_order_acquire)) {
+      pollfd readable{.fd = fd_, .events = POLLIN, .revents = 0};
+      if (::poll(&readable, 1, poll_timeout_ms) <= 0) continue;
+      nll::control::request message{};
+      sockaddr_in client{};
+      socklen_t client_length = sizeof(client);
+      const auto length = ::recvfrom(fd_, &message, sizeof(message), MSG_DONTWAIT,
+                                     reinterpret_cast<sockaddr *>(&client), &client_length);
+      if (length != sizeof(message)) continue;
+      message.to_host();
+      if (message.magic != nll::control::control_magic ||
+          message.version != nll::control::control_version ||
+          message.op != static_cast<std::uint8_t>(nll::control::Op::snapshot))
+        continue;
+      auto answer = snapshot(message.token);
+      answer.to_network();
+      ::sendto(fd_, &answer, sizeof(answer), 0, reinterpret_cast<const sockaddr *>(&client),
+               client_length);
+      ++requests_;
+    }
+  }
+
+  nll::control::reply snapshot(std::uint32_t token) const noexcept {
+    return {.magic = nll::control::control_magic, .version = nll::control::control_version,
+            .op = static_cast<std::uint8_t>(nll::control::Op::snapshot), .token = token,
+            .mono_ns = nll::mono_ns(),
+            .datagrams_received = ingress_.datagrams_received.load(std::memory_order_relaxed),
+            .valid_packets = ingress_.valid_packets.load(std::memory_order_relaxed),
+            .unique_valid_packets = ingress_.unique_valid_packets.load(std::memory_order_relaxed),
+            .receive_sequence_gaps = ingress_.receive_sequence_gaps.load(std::memory_order_relaxed),
+            .spsc_overflow = ingress_.spsc_overflow.load(std::memory_order_relaxed),
+            .processed_packets = processing_.processed.load(std::memory_order_relaxed),
+            .processing_latency_sum_ns = processing_.latency_sum_ns.load(std::memory_order_relaxed),
+            .pending_socket_bytes = pending_socket_bytes(data_fd_)};
+  }
+
+  struct alignas(nll::cache_line_size) IngressMirror {
+    std::atomic<std::uint64_t> datagrams_received{0};
+    std::atomic<std::uint64_t> valid_packets{0};
+    std::atomic<std::uint64_t> unique_valid_packets{0};
+    std::atomic<std::uint64_t> receive_sequence_gaps{0};
+    std::atomic<std::uint64_t> spsc_overflow{0};
+  };
+  struct alignas(nll::cache_line_size) ProcessingMirror {
+    std::atomic<std::uint64_t> processed{0};
+    std::atomic<std::uint64_t> latency_sum_ns{0};
+  };
+
+  int data_fd_;
+  int fd_ = -1;
+  bool failed_ = false;
+  IngressMirror ingress_;
+  ProcessingMirror processing_;
+  std::atomic<bool> done_{false};
+  std::thread server_;
+  // Server thread only until stop() joins it.
+  std::uint64_t requests_ = 0;
+};
+
+} // namespace nll::receiver
@@ -0,0 +1,696 @@
+#pragma once
+
+#include "common/spsc_queue.hpp"
+#include "receiver/control_server.hpp"
+#include "receiver/packet_batch.hpp"
+#include "receiver/receiver_common.hpp"
+#include "receiver/timeseries.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <getopt.h>
+#include <optional>
+#include <span>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <vector>
+
+namespace nll::receiver {
+
+// One receiver, assembled from an ingress backend and a processing topology.
+//
+// receiver_baseline, receiver_batched and receiver_threaded used to be three
+// copies of option parsing, socket setup and the receive loop, and fixes landed
+// in one copy and not the others. The loop now exists once, in run_engine, and
+// is templated on:
+//
+//   Ingress   how datagrams leave the kernel: RecvfromIngress (one per
+//             syscall) or RecvmmsgIngress (up to --batch per syscall). A new
+//             mechanism is one more class with capacity()/receive()/datagram().
+//   Topology  which thread processes them: InlineTopology (the ingress thread,
+//             straight after accounting) or SpscTopology (a pinned worker fed
+//             through the SPSC queue).
+//
+// The historical binaries are front-ends fixing one point of the matrix; the
+// `receiver` binary takes --ingress and --topology and reaches every point.
+// All of them write the same statistics through the same code.
+inline constexpr std::size_t queue_capacity = 4096;
+
+inline std::atomic<bool> stop_requested{false};
+inline void request_stop(int) noexcept { stop_requested.store(true, std::memory_order_relaxed); }
+
+struct Datagram {
+  const std::byte *data;
+  std::size_t length;
+  bool truncated;
+  const sockaddr_in *source;  // nullptr unless captures_source()
+  std::uint32_t drop_counter;  // SO_RXQ_OVFL; 0 without --kernel-drops
+};
+
+class RecvfromIngress {
+public:
+  // One datagram per syscall here, so publish every 64th: the reader samples
+  // at human rates and gains nothing from a seqlock write per packet.
+  static constexpr std::uint64_t publish_mask = 63;
+
+  static std::size_t arena_bytes(const Config &) noexcept {
+    return nll::memory::bytes_for<std::byte>(receive_slot_bytes);
+  }
+
+  // recvfrom() cannot return control messages, so --kernel-drops moves this
+  // backend to recvmsg(): still one datagram and one copy per syscall.
+  RecvfromIngress(const Config &config, nll::memory::Arena &arena)
+      : slot_(arena.make_array<std::byte>(receive_slot_bytes)),
+        capture_source_(captures_source(config)), use_recvmsg_(config.kernel_drops) {
+    vector_ = {.iov_base = slot_.data(), .iov_len = slot_.size()};
+    message_.msg_iov = &vector_;
+    message_.msg_iovlen = 1;
+    message_.msg_control = &control_;
+    if (capture_source_) message_.msg_name = &source_;
+  }
+  RecvfromIngress(const RecvfromIngress &) = delete;
+  RecvfromIngress &operator=(const RecvfromIngress &) = delete;
+
+  [[nodiscard]] unsigned capacity() const noexcept { return 1; }
+
+  int receive(int fd, unsigned) noexcept {
+    if (use_recvmsg_) {
+      message_.msg_namelen = capture_source_ ? sizeof(source_) : 0;
+      message_.msg_controllen = sizeof(control_);
+      length_ = ::recvmsg(fd, &message_, 0);
+    } else {
+      socklen_t source_length = sizeof(source_);
+      length_ = ::recvfrom(fd, slot_.data(), slot_.size(), 0,
+                           capture_source_ ? reinterpret_cast<sockaddr *>(&source_) : nullptr,
+                           capture_source_ ? &source_length : nullptr);
+    }
+    return length_ < 0 ? -1 : 1;
+  }
+
+  // recvfrom() silently truncates to the slot and reports the copied length,
+  // so a datagram that exactly fills the slot is the only observable signal.
+  [[nodiscard]] Datagram datagram(int) const noexcept {
+    const auto length = static_cast<std::size_t>(length_);
+    return {slot_.data(), length, length == slot_.size(), capture_source_ ? &source_ : nullptr,
+            use_recvmsg_ ? drop_counter(message_) : 0};
+  }
+
+private:
+  std::span<std::byte> slot_;
+  ssize_t length_ = 0;
+  sockaddr_in source_{};
+  bool capture_source_;
+  bool use_recvmsg_;
+  iovec vector_{};
+  msghdr message_{};
+  DropCounterControl control_{};
+};
+
+// One post-syscall receive timestamp is used for the whole batch.
+class RecvmmsgIngress {
+public:
+  static constexpr std::uint64_t publish_mask = 0;
+
+  static std::size_t arena_bytes(const Config &config) noexcept {
+    return nll::memory::bytes_for<mmsghdr>(config.batch_size) +
+           nll::memory::bytes_for<iovec>(config.batch_size) +
+           nll::memory::bytes_for<Slot>(config.batch_size) +
+           (captures_source(config) ? nll::memory::bytes_for<sockaddr_in>(config.batch_size) : 0) +
+           (config.kernel_drops ? nll::memory::bytes_for<DropCounterControl>(config.batch_size) : 0);
+  }
+
+  // Source addresses are only asked for with --per-source or --clock-log:
+  // without msg_name the kernel skips the copy-out entirely.
+  RecvmmsgIngress(const Config &config, nll::memory::Arena &arena)
+      : messages_(arena.make_array<mmsghdr>(config.batch_size)),
+        vectors_(arena.make_array<iovec>(config.batch_size)),
+        slots_(arena.make_array<Slot>(config.batch_size)),
+        sources_(captures_source(config) ? arena.make_array<sockaddr_in>(config.batch_size)
+                                    : std::span<sockaddr_in>{}),
+        controls_(config.kernel_drops ? arena.make_array<DropCounterControl>(config.batch_size)
+                                      : std::span<DropCounterControl>{}) {
+    for (std::size_t i = 0; i < messages_.size(); ++i) {
+      vectors_[i] = {.iov_base = slots_[i].data(), .iov_len = slots_[i].size()};
+      messages_[i].msg_hdr.msg_iov = &vectors_[i]; messages_[i].msg_hdr.msg_iovlen = 1;
+      if (!sources_.empty()) {
+        messages_[i].msg_hdr.msg_name = &sources_[i];
+        messages_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+      }
+      if (!controls_.empty()) messages_[i].msg_hdr.msg_control = &controls_[i];
+    }
+  }
+
+  [[nodiscard]] unsigned capacity() const noexcept { return static_cast<unsigned>(messages_.size()); }
+
+  int receive(int fd, unsigned count) noexcept {
+    // The kernel shrinks msg_controllen to what it wrote, so restore it.
+    if (!controls_.empty())
+      for (unsigned i = 0; i < count; ++i) messages_[i].msg_hdr.msg_controllen = sizeof(DropCounterControl);
+    return ::recvmmsg(fd, messages_.data(), count, MSG_WAITFORONE, nullptr);
+  }
+
+  [[nodiscard]] Datagram datagram(int i) const noexcept {
+    const auto index = static_cast<std::size_t>(i);
+    return {slots_[index].data(), messages_[index].msg_len,
+            (messages_[index].msg_hdr.msg_flags & MSG_TRUNC) != 0,
+            sources_.empty() ? nullptr : &sources_[index],
+            controls_.empty() ? 0 : drop_counter(messages_[index].msg_hdr)};
+  }
+
+private:
+  using Slot = std::array<std::byte, receive_slot_bytes>;
+  std::span<mmsghdr> messages_;
+  std::span<iovec> vectors_;
+  std::span<Slot> slots_;
+  std::span<sockaddr_in> sources_;
+  std::span<DropCounterControl> controls_;
+};
+
+inline std::size_t source_table_bytes(const Config &config) noexcept {
+  return config.max_sources
+      ? nll::memory::bytes_for<nll::FlowTable::Entry>(nll::FlowTable::slots_for(config.max_sources))
+      : 0;
+}
+
+// State shared by the ingress loop and whichever thread processes.
+struct Pipeline {
+  const Config &config;
+  nll::BinaryLogger &logger;
+  ProcessingStats &processing;
+  LiveTelemetry &telemetry;
+  IntervalRecorder &intervals;
+  ControlServer &control;
+  nll::memory::Arena &arena;
+};
+
+class InlineTopology {
+public:
+  explicit InlineTopology(Pipeline pipeline) : pipeline_(pipeline) {}
+
+  static bool validate(const Config &) { return true; }
+  static std::size_t arena_bytes(const Config &) noexcept { return 0; }
+  void start() {}
+  // Calibrated after pinning, on the core that will run it.
+  void wait_ready() {
+    const auto &config = pipeline_.config;
+    work_.emplace(config.work_model, config.work_ns, config.working_set_bytes);
+  }
+
+  template <LoopPolicy Policy>
+  void handle(const ReceivedPacket &packet, Stats &) {
+    process_packet<Policy>(pipeline_.logger, pipeline_.processing, packet, *work_);
+  }
+
+  void publish() noexcept { publish_processing(pipeline_.telemetry.processing, pipeline_.processing); }
+  void observe() noexcept { pipeline_.intervals.publish_processing(pipeline_.processing); }
+  void end_batch() noexcept { pipeline_.control.publish_processing(pipeline_.processing); }
+
+  void finish(Stats &stats) {
+    stats.work = work_->calibration();
+    stats.work_checksum = work_->checksum();
+    publish();
+    observe();
+    end_batch();
+  }
+
+  [[nodiscard]] const nll::thread::AffinityOutcome *worker_affinity() const noexcept { return nullptr; }
+  [[nodiscard]] const nll::thread::SchedulerOutcome *worker_scheduler() const noexcept { return nullptr; }
+
+private:
+  Pipeline pipeline_;
+  std::optional<WorkKernel> work_;
+};
+
+class SpscTopology {
+public:
+  explicit SpscTopology(Pipeline pipeline)
+      : pipeline_(pipeline), queue_(pipeline.arena.make<Queue>()) {}
+  ~SpscTopology() {
+    producer_done_.store(true, std::memory_order_release);
+    if (worker_.joinable()) worker_.join();
+  }
+  SpscTopology(const SpscTopology &) = delete;
+  SpscTopology &operator=(const SpscTopology &) = delete;
+
+  // The worker inherits the receiver's affinity mask, which is applied before
+  // the thread is created.  Pinning the receiver without also placing the
+  // worker silently lands both on one core, where the worker's busy-poll starves
+  // ingress -- and does so fatally once both are promoted to a realtime policy.
+  static bool validate(const Config &config) {
+    if (config.cpu >= 0 && config.worker_cpu < 0) {
+      std::fprintf(stderr, "--cpu requires --worker-cpu; the worker would inherit the receiver core\n");
+      return false;
+    }
+    if (config.worker_cpu >= 0 && config.worker_cpu == config.cpu) {
+      std::fprintf(stderr, "--worker-cpu must differ from --cpu\n");
+      return false;
+    }
+    return true;
+  }
+
+  static std::size_t arena_bytes(const Config &) noexcept { return nll::memory::bytes_for<Queue>(); }
+
+  // POSIX threads inherit their creator's affinity mask and scheduler. The
+  // worker is created while the receiver is still SCHED_OTHER so it can migrate
+  // from the inherited receiver CPU before either thread is promoted to real time.
+  void start() {
+    worker_ = std::thread([this] { run_worker(); });
+  }
+
+  // Holds ingress until the worker has calibrated, so calibration never races
+  // a filling queue.
+  void wait_ready() {
+    while (!worker_ready_.load(std::memory_order_acquire)) nll::sleep_ns(100'000ULL);
+  }
+
+  template <LoopPolicy>
+  void handle(ReceivedPacket &packet, Stats &stats) {
+    if (!queue_.push(std::move(packet))) ++stats.spsc_overflow;
+  }
+
+  void publish() noexcept {}
+  // The worker publishes its own totals.
+  void end_batch() noexcept {}
+  void observe() noexcept {
+    if (pipeline_.intervals.enabled()) pipeline_.intervals.observe_queue_depth(queue_.size());
+  }
+
+  void finish(Stats &stats) {
+    const auto drain_start = nll::mono_ns();
+    stats.queue_depth_at_shutdown = queue_.size();
+    producer_done_.store(true, std::memory_order_release);
+    worker_.join();
+    stats.work = work_;
+    stats.work_checksum = checksum_;
+    if (pipeline_.config.perf_counters) stats.worker_counters = counters_;
+    stats.drain_duration_ns = nll::mono_ns() - drain_start;
+  }
+
+  [[nodiscard]] const nll::thread::AffinityOutcome *worker_affinity() const noexcept { return &affinity_; }
+  [[nodiscard]] const nll::thread::SchedulerOutcome *worker_scheduler() const noexcept { return &scheduler_; }
+
+private:
+  void run_worker() {
+    const auto &config = pipeline_.config;
+    affinity_ = apply_affinity(config.worker_cpu);
+    nll::log::register_thread();
+    scheduler_ = nll::thread::set_scheduler(config.scheduler, config.priority);
+    // Calibrated after pinning, on the core that will run it, and with its
+    // working set first touched here.
+    WorkKernel work(config.work_model, config.work_ns, config.working_set_bytes);
+    work_ = work.calibration();
+    worker_ready_.store(true, std::memory_order_release);
+    nll::perf::StageCounters counters(config.perf_counters);
+    counters.start();
+    auto &logger = pipeline_.logger;
+    auto &processing = pipeline_.processing;
+    const auto worker_loop = [&]<LoopPolicy Policy>() {
+      while (!producer_done_.load(std::memory_order_acquire)) {
+        bool found = false;
+        for (std::uint32_t i = 0; i < config.batch_size; ++i) {
+          auto item = queue_.front();
+          if (!item) break;
+          process_packet<Policy>(logger, processing, **item, work);
+          queue_.pop(); found = true;
+        }
+        // Publishing only after real work keeps an idle worker from rewriting its
+        // telemetry line on every empty poll.
+        if (found) {
+          publish_processing(pipeline_.telemetry.processing, processing);
+          pipeline_.intervals.publish_processing(processing);
+          pipeline_.control.publish_processing(processing);
+        } else {
+          nll::thread::cpu_relax();
+        }
+      }
+      // Producer has stopped. Drain every packet published before shutdown.
+      while (true) {
+        auto item = queue_.front();
+        if (!item) break;
+        process_packet<Policy>(logger, processing, **item, work);
+        queue_.pop();
+      }
+    };
+    dispatch_loop(loop_policy(config), worker_loop);
+    counters_ = counters.stop();
+    checksum_ = work.checksum();
+    publish_processing(pipeline_.telemetry.processing, processing);
+    pipeline_.intervals.publish_processing(processing);
+    pipeline_.control.publish_processing(processing);
+  }
+
+  using Queue = nll::SPSCQueue<ReceivedPacket, queue_capacity>;
+
+  Pipeline pipeline_;
+  // In the arena, so its pages are faulted in before the run.
+  Queue &queue_;
+  std::atomic<bool> producer_done_{false};
+  std::atomic<bool> worker_ready_{false};
+  std::thread worker_;
+  // Written by the worker, read after join.
+  nll::thread::AffinityOutcome affinity_;
+  nll::thread::SchedulerOutcome scheduler_;
+  WorkCalibration work_;
+  std::uint64_t checksum_ = 0;
+  nll::perf::Reading counters_;
+};
+
+template <typename IngressBackend, typename ProcessingTopology>
+int run_engine(const Config &config) {
+  if (!ProcessingTopology::validate(config)) return 2;
+  if (config.output_path.has_parent_path()) {
+    std::error_code ec;
+    std::filesystem::create_directories(config.output_path.parent_path(), ec);
+    if (ec) { std::fprintf(stderr, "Cannot create output directory: %s\n", ec.message().c_str()); return 1; }
+  }
+  if (!select_clock(config)) return 1;
+  // From here on NLL_* only enqueue; the writer thread formats and writes.
+  nll::log::AsyncScope async_log;
+  std::signal(SIGINT, request_stop);
+  ScopedSocket socket(config.socket_buffer_bytes);
+  if (!socket.valid() || !bind_socket(socket.get(), config.port)) return 1;
+  if (config.kernel_drops && !enable_drop_counter(socket.get())) {
+    NLL_ERROR("SO_RXQ_OVFL failed: %s\n", std::strerror(errno)); return 1;
+  }
+  IntervalRecorder intervals(config);
+  if (!config.timeseries_path.empty() && !intervals.enabled()) return 1;
+  std::optional<PacketCapture> capture;
+  if (!config.capture_path.empty()) {
+    capture.emplace(config.capture_path, config.capture_snaplen, config.capture_every, config.port);
+    if (!capture->enabled()) return 1;
+  }
+  ControlServer control(config, socket.get());
+  if (control.failed()) return 1;
+  auto affinity = apply_affinity(config.cpu);
+  nll::log::register_thread();
+  // After pinning, so first-touch places the pages on this CPU's node.
+  nll::memory::Arena arena(IngressBackend::arena_bytes(config) +
+                           ProcessingTopology::arena_bytes(config) + source_table_bytes(config) +
+                           nll::memory::bytes_for<PacketBatch>(),
+                           config.page_policy);
+  nll::BinaryLogger logger(config.output_path);
+  if (!logger.is_open()) return 1;
+  ProcessingStats processing;
+  LiveTelemetry telemetry(config);
+  ProcessingTopology topology({config, logger, processing, telemetry, intervals, control, arena});
+  topology.start();
+  auto scheduler = nll::thread::set_scheduler(config.scheduler, config.priority);
+  topology.wait_ready();
+
+  Stats stats;
+  stats.requested_socket_buffer_bytes = socket.requested_buffer_bytes();
+  stats.observed_socket_buffer_bytes = socket.observed_buffer_bytes();
+  stats.telemetry_page = telemetry.path();
+  if (!config.clock_log_path.empty()) stats.clock.enable();
+  nll::SequenceTracker receive_sequences;
+  IngressBackend ingress(config, arena);
+  auto &batch = arena.make<PacketBatch>();
+  if (config.max_sources)
+    stats.sources = nll::FlowTable(
+        arena.make_array<nll::FlowTable::Entry>(nll::FlowTable::slots_for(config.max_sources)),
+        config.max_sources);
+  stats.arena = arena.report();
+  SocketMemorySampler socket_memory(socket.get(), config.meminfo_interval_us * 1000);
+  nll::perf::StageCounters ingress_counters(config.perf_counters);
+  nll::memory::FaultCounter faults(RUSAGE_SELF);
+  faults.start();
+  ingress_counters.start();
+  const auto receive_loop = [&]<LoopPolicy Policy>() {
+    while (!stop_requested.load(std::memory_order_relaxed) &&
+           (!Policy.bounded || stats.datagrams_received < config.max_packets)) {
+      if ((stats.receive_syscalls & IngressBackend::publish_mask) == 0) {
+        publish_ingress(telemetry.ingress, stats, receive_sequences);
+        topology.publish();
+      }
+      unsigned int count = ingress.capacity();
+      if constexpr (Policy.bounded)
+        count = static_cast<unsigned int>(std::min<std::uint64_t>(count, config.max_packets - stats.datagrams_received));
+      const int received = ingress.receive(socket.get(), count);
+      const std::uint64_t receive_ts = Policy.sampling ? nll::stamp_real_ns() : 0;
+      const std::uint64_t receive_mono_ts = nll::stamp_mono_ns();
+      nll::maintain_timestamp_clock(receive_mono_ts);
+      ++stats.receive_syscalls;
+      topology.observe();
+      intervals.tick(receive_mono_ts, stats, receive_sequences, socket.get());
+      socket_memory.tick(receive_mono_ts, stats.socket_memory);
+      if (capture) capture->tick(receive_mono_ts);
+      if (received < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+        ++stats.socket_errors; break;
+      }
+      // Captured packets carry the batch's receive time, on CLOCK_REALTIME.
+      const auto capture_real_ns = !capture ? std::uint64_t{0} : Policy.sampling
+          ? receive_ts : nll::stamp_real_ns() - (nll::stamp_mono_ns() - receive_mono_ts);
+      batch.clear();
+      stats.datagrams_received += static_cast<std::uint64_t>(received);
+      for (int i = 0; i < received; ++i) {
+        const auto datagram = ingress.datagram(i);
+        if (datagram.truncated) ++stats.truncated_packets;
+        // Before validation: a malformed datagram is what one wants to look at.
+        if (capture)
+          capture->record(datagram.data, datagram.length, datagram.source, capture_real_ns,
+                          receive_mono_ts);
+        batch.add(datagram.data, datagram.length);
+      }
+      batch.decode(stats);
+      for (const auto index : batch.probes()) {
+        const auto datagram = ingress.datagram(index);
+        // t2 is the batch's receive time, moved onto CLOCK_REALTIME.
+        const auto receive_real_ns = Policy.sampling
+            ? receive_ts : nll::stamp_real_ns() - (nll::stamp_mono_ns() - receive_mono_ts);
+        stats.clock.handle(socket.get(), datagram.data, datagram.length, datagram.source,
+                           batch.message(index), receive_real_ns, receive_mono_ts);
+      }
+      if (config.verify_crc || config.kernel_drops || stats.sources.enabled()) {
+        for (const auto index : batch.accepted()) {
+          const auto datagram = ingress.datagram(index);
+          if (config.verify_crc) verify_payload(stats, datagram.data, datagram.length, datagram.truncated);
+          if (config.kernel_drops)
+            stats.kernel_drop_timeline.observe(datagram.drop_counter, batch.sequences()[index],
+                                               receive_mono_ts);
+          if (stats.sources.enabled())
+            account_source(stats, *datagram.source, datagram.data, datagram.length,
+                           batch.message(index), receive_mono_ts);
+        }
+      }
+      account_batch<Policy>(stats, receive_sequences, batch, receive_ts, receive_mono_ts,
+                            config.sample_every);
+      const auto sampled = batch.sampled();
+      std::size_t next_sampled = 0;
+      for (const auto index : batch.accepted()) {
+        const bool is_sampled = next_sampled < sampled.size() && sampled[next_sampled] == index;
+        next_sampled += is_sampled;
+        ReceivedPacket packet{.message = batch.message(index), .receive_real_ns = receive_ts,
+                              .receive_mono_ns = receive_mono_ts, .sampled = is_sampled};
+        topology.template handle<Policy>(packet, stats);
+      }
+      control.publish_ingress(stats, receive_sequences);
+      topology.end_batch();
+    }
+  };
+  dispatch_loop(loop_policy(config), receive_loop);
+  stats.ingress_counters = ingress_counters.stop();
+  stats.page_faults = faults.stop();
+  publish_ingress(telemetry.ingress, stats, receive_sequences);
+  stats.interrupted = stop_requested.load(std::memory_order_relaxed);
+  stats.socket_pending_bytes_at_shutdown = pending_socket_bytes(socket.get());
+  if (socket_memory.enabled()) socket_memory.sample(stats.socket_memory);
+  topology.finish(stats);
+  control.publish_ingress(stats, receive_sequences);
+  stats.control_requests = control.stop();
+  intervals.finish(nll::stamp_mono_ns(), stats, receive_sequences, socket.get());
+  stats.timeseries_samples = intervals.samples();
+  stats.timeseries_dropped = intervals.dropped();
+  finalize_receive_sequences(stats, receive_sequences);
+  merge_processing(stats, processing);
+  logger.flush();
+  const bool capture_ok = !capture || capture->finish();
+  if (capture) stats.capture = capture->stats();
+  const bool clock_ok = config.clock_log_path.empty() || stats.clock.write_log(config.clock_log_path);
+  stats.log_messages_dropped = nll::log::dropped_messages();
+  return write_stats(config, stats, affinity, scheduler, topology.worker_affinity(),
+                     topology.worker_scheduler()) && clock_ok && capture_ok ? 0 : 1;
+}
+
+inline int run(const Config &config) {
+  if (config.topology == Topology::spsc_worker) {
+    return config.ingress == Ingress::recvmmsg ? run_engine<RecvmmsgIngress, SpscTopology>(config)
+                                               : run_engine<RecvfromIngress, SpscTopology>(config);
+  }
+  return config.ingress == Ingress::recvmmsg ? run_engine<RecvmmsgIngress, InlineTopology>(config)
+                                             : run_engine<RecvfromIngress, InlineTopology>(config);
+}
+
+// What a front-end binary fixes and what it exposes on its command line.
+struct FrontEnd {
+  const char *program;
+  const char *summary;
+  Ingress ingress;
+  Topology topology;
+  // Only the `receiver` binary lets --ingress and --topology move it.
+  bool selectable = false;
+};
+
+inline bool exposes_batch(const FrontEnd &front) noexcept {
+  return front.selectable || front.ingress == Ingress::recvmmsg ||
+         front.topology == Topology::spsc_worker;
+}
+
+inline bool exposes_worker(const FrontEnd &front) noexcept {
+  return front.selectable || front.topology == Topology::spsc_worker;
+}
+
+inline void usage(std::FILE *out, const FrontEnd &front) {
+  const bool worker = exposes_worker(front);
+  std::fprintf(out, "Usage: %s [options]\n%s\n\n", front.program, front.summary);
+  std::fprintf(out,
+      "  -o, --output PATH          versioned binary log (default latency.bin)\n"
+      "  -s, --stats PATH           structured JSON statistics\n"
+      "  -p, --port PORT            UDP port (1..65535)\n"
+      "  -c, --cpu CPU              receiver CPU affinity\n");
+  if (worker) std::fprintf(out, "  -w, --worker-cpu CPU       worker CPU affinity\n");
+  if (exposes_batch(front))
+    std::fprintf(out, "  -b, --batch N              %s batch size (1..1024)\n",
+                 front.selectable ? "recvmmsg and worker"
+                 : front.topology == Topology::spsc_worker
+                     ? (front.ingress == Ingress::recvmmsg ? "recvmmsg and worker" : "worker")
+                     : "recvmmsg");
+  std::fprintf(out,
+      "  -n, --max-packets N        stop after N datagrams (0 = unlimited)\n"
+      "  -S, --scheduler POLICY     other, fifo, or rr%s\n"
+      "  -P, --priority N           0 for other; 1..99 for fifo/rr\n"
+      "  -W, --work NS              %s synthetic work per valid packet\n"
+      "  -e, --sample-every N      log every Nth valid packet (0 = counts only)\n"
+      "  -B, --socket-buffer BYTES requested SO_RCVBUF size (0 = system default)\n",
+      worker ? " (both threads)" : "",
+      front.selectable ? "inline or worker"
+      : front.topology == Topology::spsc_worker ? "worker" : "inline");
+  if (front.selectable)
+    std::fprintf(out,
+        "      --ingress BACKEND      recvfrom or recvmmsg (default recvmmsg)\n"
+        "      --topology KIND        inline or spsc (default inline)\n");
+  std::fprintf(out,
+      "      --telemetry            publish live counters at /dev/shm/nll-<pid>\n"
+      "      --timeseries PATH      per-interval NDJSON counter deltas\n"
+      "      --interval-ms N        timeseries interval, 1..60000 (default 100)\n"
+      "      --clock SOURCE         timestamp clock: system or cycles (default system)\n"
+      "      --perf-counters        count cycles, instructions and misses per stage\n"
+      "      --work-model MODEL     spin, hash, chase, or compute (default spin)\n"
+      "      --working-set BYTES    hash/chase working set, 4096..1073741824\n"
+      "      --verify-crc           count payloads whose CRC32C trailer mismatches\n"
+      "      --no-packet-stamps     reuse the batch receive stamp (no latency figures)\n"
+      "      --hugepages POLICY     buffer pages: auto, hugetlb, thp, or normal (default auto)\n"
+      "      --control PORT         answer live counter snapshots on this UDP port\n"
+      "      --per-source N         sequence accounting per source address, up to N sources\n"
+      "      --kernel-drops         attribute socket-buffer drops in-band via SO_RXQ_OVFL\n"
+      "      --meminfo-us N         sample socket receive-queue occupancy (SO_MEMINFO) every N us\n"
+      "      --clock-log PATH       answer sender clock probes; write offset/drift rounds as CSV\n"
+      "      --capture PATH         write received datagrams to PATH as pcapng (background writer)\n"
+      "      --capture-snaplen N    bytes kept per captured packet, IP header included, 64..65535\n"
+      "      --capture-every N      capture every Nth datagram (default 1: all)\n"
+      "  -h, --help                 show this help\n");
+}
+
+// Parses a front-end's command line and runs the engine. Exit codes: 0 on
+// success, 1 on runtime failure, 2 on a usage error.
+inline int receiver_main(int argc, char **argv, const FrontEnd &front) {
+  Config config{.variant = {}, .ingress = front.ingress, .topology = front.topology};
+  bool batch_given = false;
+  enum { telemetry_option = 1000, timeseries_option, interval_option, clock_option, perf_option,
+         work_model_option, working_set_option, verify_crc_option,
+         packet_stamps_option, ingress_option, topology_option, hugepages_option,
+         control_option, per_source_option, kernel_drops_option, meminfo_option,
+         clock_log_option, capture_option, capture_snaplen_option, capture_every_option };
+  std::vector<option> options = {{"output", required_argument, nullptr, 'o'}, {"stats", required_argument, nullptr, 's'},
+    {"port", required_argument, nullptr, 'p'}, {"cpu", required_argument, nullptr, 'c'},
+    {"max-packets", required_argument, nullptr, 'n'}, {"scheduler", required_argument, nullptr, 'S'},
+    {"priority", required_argument, nullptr, 'P'}, {"work", required_argument, nullptr, 'W'},
+    {"sample-every", required_argument, nullptr, 'e'}, {"socket-buffer", required_argument, nullptr, 'B'},
+    {"telemetry", no_argument, nullptr, telemetry_option},
+    {"timeseries", required_argument, nullptr, timeseries_option}, {"interval-ms", required_argument, nullptr, interval_option},
+    {"clock", required_argument, nullptr, clock_option}, {"perf-counters", no_argument, nullptr, perf_option},
+    {"work-model", required_argument, nullptr, work_model_option}, {"working-set", required_argument, nullptr, working_set_option},
+    {"verify-crc", no_argument, nullptr, verify_crc_option}, {"no-packet-stamps", no_argument, nullptr, packet_stamps_option},
+    {"hugepages", required_argument, nullptr, hugepages_option},
+    {"control", required_argument, nullptr, control_option},
+    {"per-source", required_argument, nullptr, per_source_option},
+    {"kernel-drops", no_argument, nullptr, kernel_drops_option},
+    {"meminfo-us", required_argument, nullptr, meminfo_option},
+    {"clock-log", required_argument, nullptr, clock_log_option},
+    {"capture", required_argument, nullptr, capture_option},
+    {"capture-snaplen", required_argument, nullptr, capture_snaplen_option},
+    {"capture-every", required_argument, nullptr, capture_every_option},
+    {"help", no_argument, nullptr, 'h'}};
+  std::string short_options = "o:s:p:c:n:S:P:W:e:B:h";
+  if (exposes_worker(front)) { options.push_back({"worker-cpu", required_argument, nullptr, 'w'}); short_options += "w:"; }
+  if (exposes_batch(front)) { options.push_back({"batch", required_argument, nullptr, 'b'}); short_options += "b:"; }
+  if (front.selectable) {
+    options.push_back({"ingress", required_argument, nullptr, ingress_option});
+    options.push_back({"topology", required_argument, nullptr, topology_option});
+  }
+  options.push_back({nullptr, 0, nullptr, 0});
+  int opt = 0;
+  while ((opt = getopt_long(argc, argv, short_options.c_str(), options.data(), nullptr)) != -1) {
+    std::uint64_t value = 0;
+    switch (opt) {
+    case 'o': config.output_path = optarg; break; case 's': config.stats_path = optarg; break;
+    case 'p': if (!parse_u64(optarg, 1, 65535, value, "port")) return 2; config.port = static_cast<std::uint16_t>(value); break;
+    case 'c': if (!parse_int(optarg, 0, CPU_SETSIZE - 1, config.cpu, "CPU")) return 2; break;
+    case 'w': if (!parse_int(optarg, 0, CPU_SETSIZE - 1, config.worker_cpu, "worker CPU")) return 2; break;
+    case 'b': if (!parse_u64(optarg, 1, max_batch, value, "batch")) return 2; config.batch_size = static_cast<std::uint32_t>(value); batch_given = true; break;
+    case 'n': if (!parse_u64(optarg, 0, UINT64_MAX, config.max_packets, "max packets")) return 2; break;
+    case 'S': config.scheduler = optarg; break;
+    case 'P': if (!parse_int(optarg, 0, 99, config.priority, "priority")) return 2; break;
+    case 'W': if (!parse_u64(optarg, 0, UINT64_MAX, config.work_ns, "work")) return 2; break;
+    case 'e': if (!parse_u64(optarg, 0, UINT64_MAX, config.sample_every, "sample every")) return 2; break;
+    case 'B': { int bytes = 0; if (!parse_int(optarg, 0, INT_MAX, bytes, "socket buffer")) return 2; config.socket_buffer_bytes = bytes; break; }
+    case telemetry_option: config.telemetry = true; break;
+    case timeseries_option: config.timeseries_path = optarg; break;
+    case interval_option: if (!parse_u64(optarg, 1, 60000, config.interval_ms, "interval")) return 2; break;
+    case clock_option: if (!parse_clock(optarg, config.clock)) return 2; break;
+    case perf_option: config.perf_counters = true; break;
+    case verify_crc_option: config.verify_crc = true; break;
+    case packet_stamps_option: config.packet_stamps = false; break;
+    case hugepages_option: if (!parse_page_policy(optarg, config.page_policy)) return 2; break;
+    case control_option: if (!parse_u64(optarg, 1, 65535, value, "control port")) return 2; config.control_port = static_cast<std::uint16_t>(value); break;
+    case kernel_drops_option: config.kernel_drops = true; break;
+    case clock_log_option: config.clock_log_path = optarg; break;
+    case capture_option: config.capture_path = optarg; break;
+    case capture_snaplen_option: if (!parse_u64(optarg, 64, 65535, value, "capture snaplen")) return 2; config.capture_snaplen = static_cast<std::uint32_t>(value); break;
+    case capture_every_option: if (!parse_u64(optarg, 1, UINT64_MAX, config.capture_every, "capture every")) return 2; break;
+    case meminfo_option: if (!parse_u64(optarg, 1, 1'000'000, config.meminfo_interval_us, "meminfo interval")) return 2; break;
+    case per_source_option: if (!parse_u64(optarg, 1, 65536, value, "per-source limit")) return 2; config.max_sources = static_cast<std::uint32_t>(value); break;
+    case work_model_option: if (!parse_work_model(optarg, config.work_model)) return 2; break;
+    case working_set_option: if (!parse_u64(optarg, 4096, 1ULL << 30, config.working_set_bytes, "working set")) return 2; break;
+    case ingress_option: {
+      const std::string_view name(optarg);
+      if (name != "recvfrom" && name != "recvmmsg") { std::fprintf(stderr, "Invalid ingress: %s (expected recvfrom or recvmmsg)\n", optarg); return 2; }
+      config.ingress = name == "recvmmsg" ? Ingress::recvmmsg : Ingress::recvfrom; break;
+    }
+    case topology_option: {
+      const std::string_view name(optarg);
+      if (name != "inline" && name != "spsc") { std::fprintf(stderr, "Invalid topology: %s (expected inline or spsc)\n", optarg); return 2; }
+      config.topology = name == "spsc" ? Topology::spsc_worker : Topology::inline_processing; break;
+    }
+    case 'h': usage(stdout, front); return 0; default: usage(stderr, front); return 2;
+    }
+  }
+  if (optind != argc || !validate_scheduler(config)) return 2;
+  if (config.control_port == config.port) {
+    std::fprintf(stderr, "--control must differ from --port\n");
+    return 2;
+  }
+  // One datagram per syscall and nothing downstream to batch: the baseline's 1.
+  if (!batch_given)
+    config.batch_size = config.ingress == Ingress::recvfrom &&
+                        config.topology == Topology::inline_processing ? 1U : 32U;
+  config.variant = variant_name(config.ingress, config.topology);
+  return run(config);
+}
+
+} // namespace nll::receiver
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+
+namespace nll::receiver {
+
+// In-band kernel drop attribution for --kernel-drops.
+//
+// /proc/net/snmp RcvbufErrors is host-wide and read only around the run. With
+// SO_RXQ_OVFL the kernel instead attaches this socket's cumulative drop count,
+// as it stood when the datagram was queued, to every datagram once it is
+// non-zero. A rise between two consecutive valid datagrams means the socket
+// buffer overflowed between them: the event records both sequences and the
+// receive time of the second, on the same mono clock as the timeseries and the
+// loss-burst timeline, so it can be lined up with a worker stall.
+struct KernelDropEvent {
+  std::uint32_t after_sequence = 0;  // last valid datagram before the drops
+  std::uint32_t before_sequence = 0; // first valid datagram after them
+  std::uint32_t dropped = 0;
+  bool at_start = false;             // dropped before the first datagram read
+  std::uint64_t revealed_ns = 0;
+};
+
+// The newest event_capacity events, as GapTimeline keeps loss bursts, plus
+// exact totals over all of them.
+class KernelDropTimeline {
+public:
+  static constexpr std::size_t event_capacity = 256;
+
+  // One valid datagram with the counter it carried (0 when it carried none).
+  void observe(std::uint32_t counter, std::uint32_t sequence, std::uint64_t now_ns) noexcept {
+    if (counter != counter_) {
+      // Cumulative and 32-bit: unsigned subtraction survives the wrap.
+      const std::uint32_t dropped = counter - counter_;
+      events_[recorded_ % event_capacity] = {.after_sequence = last_sequence_,
+          .before_sequence = sequence, .dropped = dropped, .at_start = !seen_,
+          .revealed_ns = now_ns};
+      ++recorded_;
+      dropped_ += dropped;
+      counter_ = counter;
+    }
+    last_sequence_ = sequence;
+    seen_ = true;
+  }
+
+  [[nodiscard]] std::uint64_t dropped() const noexcept { return dropped_; }
+  [[nodiscard]] std::uint64_t recorded() const noexcept { return recorded_; }
+  [[nodiscard]] std::size_t retained() const noexcept {
+    return recorded_ < event_capacity ? static_cast<std::size_t>(recorded_) : event_capacity;
+  }
+  // Retained events in arrival order; index 0 is the oldest still held.
+  [[nodiscard]] const KernelDropEvent &event(std::size_t index) const noexcept {
+    return events_[(recorded_ - retained() + index) % event_capacity];
+  }
+
+private:
+  std::array<KernelDropEvent, event_capacity> events_{};
+  std::uint64_t recorded_ = 0;
+  std::uint64_t dropped_ = 0;
+  std::uint32_t counter_ = 0;
+  std::uint32_t last_sequence_ = 0;
+  bool seen_ = false;
+};
+
+// Control buffer for one datagram's SO_RXQ_OVFL message.
+struct alignas(cmsghdr) DropCounterControl {
+  std::byte bytes[CMSG_SPACE(sizeof(std::uint32_t))];
+};
+
+inline bool enable_drop_counter(int fd) noexcept {
+  const int one = 1;
+  return ::setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) == 0;
+}
+
+// The counter a received datagram carried, or 0: the kernel omits the message
+// until the socket's first drop.
+inline std::uint32_t drop_counter(const msghdr &message) noexcept {
+  for (auto *control = CMSG_FIRSTHDR(&message); control != nullptr;
+       control = CMSG_NXTHDR(const_cast<msghdr *>(&message), control)) {
+    if (control->cmsg_level != SOL_SOCKET || control->cmsg_type != SO_RXQ_OVFL) continue;
+    std::uint32_t counter = 0;
+    std::memcpy(&counter, CMSG_DATA(control), sizeof(counter));
+    return counter;
+  }
+  return 0;
+}
+
+inline void write_json(std::FILE *file, bool enabled, const KernelDropTimeline &timeline) {
+  std::fprintf(file, "  \"kernel_drops\": {\"enabled\": %s, \"source\": \"SO_RXQ_OVFL\", "
+      "\"dropped\": %llu, \"events\": %llu, \"retained\": [",
+      enabled ? "true" : "false", static_cast<unsigned long long>(timeline.dropped()),
+      static_cast<unsigned long long>(timeline.recorded()));
+  for (std::size_t index = 0; index < timeline.retained(); ++index) {
+    const auto &event = timeline.event(index);
+    std::fprintf(file, "%s\n    {\"after_sequence\": ", index ? "," : "");
+    if (event.at_start) std::fprintf(file, "null");
+    else std::fprintf(file, "%u", event.after_sequence);
+    std::fprintf(file, ", \"before_sequence\": %u, \"dropped\": %u, \"revealed_mono_ns\": %llu}",
+        event.before_sequence, event.dropped, static_cast<unsigned long long>(event.revealed_ns));
+  }
+  std::fprintf(file, "%s]},\n", timeline.retained() ? "\n  " : "");
+}
+
+} // namespace nll::receiver
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace nll::receiver {
+
+// Features a receive loop is compiled for.
+//
+// The loops used to test config.sample_every, config.work_ns and
+// config.max_packets on every packet, and process_packet tested
+// packet.sampled several times more. The branches were predictable but not
+// free: each one kept a load, a compare and, for sampling, a division per
+// packet in the loop body, which is precisely the overhead a count-only
+// capacity run is meant to exclude. Each loop is now a template on this set
+// and the receiver picks the matching instantiation once, after parsing.
+//
+// A true member means "may be on" and keeps the runtime check, so the all-true
+// policy is the general loop; a false member compiles the feature out.
+//
+//   sampling      real-time stamps, the every-Nth test and the binary log
+//   work          the WorkKernel call and the finish stamp around it
+//   bounded       the --max-packets limit on the loop and on each batch
+//   timestamping  a fresh processing stamp per packet; without it the batch
+//                 receive stamp stands in and latency is not measured
+struct LoopPolicy {
+  bool sampling = true;
+  bool work = true;
+  bool bounded = true;
+  bool timestamping = true;
+};
+
+inline constexpr LoopPolicy general_loop{};
+
+constexpr LoopPolicy loop_policy_from_index(std::size_t index) noexcept {
+  return {.sampling = (index & 1U) != 0, .work = (index & 2U) != 0,
+          .bounded = (index & 4U) != 0, .timestamping = (index & 8U) != 0};
+}
+
+constexpr std::size_t loop_policy_index(const LoopPolicy &policy) noexcept {
+  return (policy.sampling ? 1U : 0U) | (policy.work ? 2U : 0U) |
+         (policy.bounded ? 4U : 0U) | (policy.timestamping ? 8U : 0U);
+}
+
+inline constexpr std::size_t loop_policy_count = 16;
+
+// Calls loop.template operator()<Policy>() for the instantiation matching the
+// runtime policy. All sixteen are compiled; only the selected one runs.
+template <typename Loop, std::size_t... Index>
+void dispatch_loop(const LoopPolicy &policy, Loop &&loop, std::index_sequence<Index...>) {
+  const auto index = loop_policy_index(policy);
+  static_cast<void>(((index == Index
+      ? (loop.template operator()<loop_policy_from_index(Index)>(), true) : false) || ...));
+}
+
+template <typename Loop>
+void dispatch_loop(const LoopPolicy &policy, Loop &&loop) {
+  dispatch_loop(policy, std::forward<Loop>(loop), std::make_index_sequence<loop_policy_count>{});
+}
+
+} // namespace nll::receiver
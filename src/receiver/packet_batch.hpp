@@ -0,0 +1,264 @@
+#pragma once
+
+#include "common/packet.hpp"
+#include "common/sequence_tracker.hpp"
+#include "receiver/loop_policy.hpp"
+#include "receiver/receiver_common.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
+#include <span>
+
+#if defined(__x86_64__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <tmmintrin.h>
+#elif defined(__aarch64__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <arm_neon.h>
+#endif
+
+namespace nll::receiver {
+
+inline constexpr std::uint32_t max_batch = 1024;
+
+// One receive batch as columns: how ingress validates and accounts datagrams.
+//
+// Validating and accounting one datagram at a time copied and swapped each
+// header, bumped whichever Stats counters applied and tested the sample
+// interval, so a recvmmsg batch of 64 repeated all of that 64 times around one
+// receive syscall. The ingress loop instead gathers the batch, copying each
+// header verbatim into a 16-byte row, and byte-swaps every row with one
+// 128-bit shuffle (SSSE3 or ARMv8 Advanced SIMD). A single branch-free pass
+// then classifies the rows, fills the sequence, send-stamp and schedule
+// columns, counts rejects in locals and compacts the accepted datagrams into
+// an index list, so Stats is written once per batch. Sampling is a second
+// index list: the hand-off compares indices instead of dividing per packet.
+namespace batch_detail {
+
+using HeaderRow = std::array<std::byte, sizeof(nll::message_header)>;
+static_assert(sizeof(HeaderRow) == 16, "one header per 128-bit lane");
+
+// message_header::to_host as one byte shuffle: magic, seq_idx and
+// send_unix_ns reversed in place, version and msg_type left alone.
+alignas(16) inline constexpr std::uint8_t header_shuffle[16] = {
+    1, 0, 2, 3, 7, 6, 5, 4, 15, 14, 13, 12, 11, 10, 9, 8};
+
+inline void portable(HeaderRow *rows, std::size_t count) noexcept {
+  for (std::size_t index = 0; index < count; ++index) {
+    nll::message_header header;
+    std::memcpy(&header, rows[index].data(), sizeof(header));
+    header.to_host();
+    std::memcpy(rows[index].data(), &header, sizeof(header));
+  }
+}
+
+#if defined(__x86_64__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+__attribute__((target("ssse3")))
+inline void vector(HeaderRow *rows, std::size_t count) noexcept {
+  const auto mask = _mm_load_si128(reinterpret_cast<const __m128i *>(header_shuffle));
+  for (std::size_t index = 0; index < count; ++index) {
+    auto *row = reinterpret_cast<__m128i *>(rows[index].data());
+    _mm_storeu_si128(row, _mm_shuffle_epi8(_mm_loadu_si128(row), mask));
+  }
+}
+inline bool vector_available() noexcept { return __builtin_cpu_supports("ssse3"); }
+#elif defined(__aarch64__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+inline void vector(HeaderRow *rows, std::size_t count) noexcept {
+  const auto mask = vld1q_u8(header_shuffle);
+  for (std::size_t index = 0; index < count; ++index) {
+    auto *row = reinterpret_cast<std::uint8_t *>(rows[index].data());
+    vst1q_u8(row, vqtbl1q_u8(vld1q_u8(row), mask));
+  }
+}
+// Advanced SIMD is part of ARMv8-A, so the Pi 4 always has it.
+inline bool vector_available() noexcept { return true; }
+#else
+inline void vector(HeaderRow *rows, std::size_t count) noexcept { portable(rows, count); }
+inline bool vector_available() noexcept { return false; }
+#endif
+
+using Function = void (*)(HeaderRow *, std::size_t) noexcept;
+
+inline Function selected() noexcept {
+  static const Function function = vector_available() ? &vector : &portable;
+  return function;
+}
+
+} // namespace batch_detail
+
+class PacketBatch {
+public:
+  static constexpr std::size_t capacity = max_batch;
+  static constexpr std::size_t v2_bytes = nll::message_header_bytes(nll::message_version_v2);
+
+  void clear() noexcept {
+    count_ = 0;
+    accepted_count_ = 0;
+    probe_count_ = 0;
+    sampled_count_ = 0;
+  }
+
+  // Ingress thread, once per received datagram, in receive order.
+  void add(const std::byte *data, std::size_t length) noexcept {
+    const auto index = count_++;
+    lengths_[index] = static_cast<std::uint32_t>(length);
+    if (length >= v2_bytes) {
+      std::memcpy(rows_[index].data(), data, sizeof(batch_detail::HeaderRow));
+      std::memcpy(&schedules_[index], data + sizeof(batch_detail::HeaderRow), sizeof(std::uint64_t));
+      return;
+    }
+    // Short rows are zero-padded; classification rejects them on length.
+    std::byte padded[v2_bytes]{};
+    std::memcpy(padded, data, length);
+    std::memcpy(rows_[index].data(), padded, sizeof(batch_detail::HeaderRow));
+    std::memcpy(&schedules_[index], padded + sizeof(batch_detail::HeaderRow), sizeof(std::uint64_t));
+  }
+
+  // Swaps every header to host order and classifies the batch. A datagram
+  // shorter than its header version needs is short; otherwise it needs the
+  // magic and version 1 or 2. Versions 1 and 2 share the first 16 bytes, and
+  // the schedule column is 0 for v1 and for a v2 sender without a schedule.
+  // Valid clock probes go to probes(); every other valid datagram goes to
+  // accepted().
+  void decode(Stats &stats) noexcept {
+    batch_detail::selected()(rows_.data(), count_);
+    std::uint64_t short_packets = 0, invalid_magic = 0, unsupported = 0, v2_packets = 0;
+    for (std::size_t index = 0; index < count_; ++index) {
+      nll::message_header header;
+      std::memcpy(&header, rows_[index].data(), sizeof(header));
+      const auto length = lengths_[index];
+      const bool complete = length >= sizeof(nll::message_header);
+      const bool magic = header.magic == 0x6584;
+      const bool v1 = header.version == nll::message_version_v1;
+      const bool v2 = header.version == nll::message_version_v2;
+      const bool v2_short = length < v2_bytes;
+      const bool known = complete & magic;
+      const bool valid = known & (v1 | (v2 & !v2_short));
+      short_packets += (!complete) | (known & v2 & v2_short);
+      invalid_magic += complete & !magic;
+      unsupported += known & !v1 & !v2;
+      v2_packets += valid & v2;
+      sequences_[index] = header.seq_idx;
+      send_ns_[index] = header.send_unix_ns;
+      schedules_[index] = valid & v2 ? be64toh(schedules_[index]) : 0;
+      const bool probe = (header.msg_type & nll::msg_type_mask) == nll::msg_type_clock_probe;
+      const auto position = static_cast<std::uint16_t>(index);
+      accepted_[accepted_count_] = position;
+      accepted_count_ += valid & !probe;
+      probes_[probe_count_] = position;
+      probe_count_ += valid & probe;
+    }
+    stats.short_packets += short_packets;
+    stats.invalid_magic += invalid_magic;
+    stats.unsupported_version += unsupported;
+    stats.header_v2_packets += v2_packets;
+  }
+
+  // Accepted datagrams whose seq_idx is a multiple of every, in batch order.
+  void select_sampled(std::uint64_t every) noexcept {
+    sampled_count_ = 0;
+    for (std::size_t position = 0; position < accepted_count_; ++position) {
+      const auto index = accepted_[position];
+      sampled_[sampled_count_] = index;
+      sampled_count_ += sequences_[index] % every == 0;
+    }
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept { return count_; }
+  [[nodiscard]] std::span<const std::uint16_t> accepted() const noexcept {
+    return {accepted_.data(), accepted_count_};
+  }
+  [[nodiscard]] std::span<const std::uint16_t> probes() const noexcept {
+    return {probes_.data(), probe_count_};
+  }
+  [[nodiscard]] std::span<const std::uint16_t> sampled() const noexcept {
+    return {sampled_.data(), sampled_count_};
+  }
+  [[nodiscard]] std::span<const std::uint32_t> sequences() const noexcept {
+    return {sequences_.data(), count_};
+  }
+  [[nodiscard]] std::span<const std::uint64_t> send_ns() const noexcept {
+    return {send_ns_.data(), count_};
+  }
+  [[nodiscard]] std::span<const std::uint64_t> scheduled_ns() const noexcept {
+    return {schedules_.data(), count_};
+  }
+  // Host order after decode().
+  [[nodiscard]] nll::message_header message(std::size_t index) const noexcept {
+    nll::message_header header;
+    std::memcpy(&header, rows_[index].data(), sizeof(header));
+    return header;
+  }
+
+private:
+  alignas(16) std::array<batch_detail::HeaderRow, capacity> rows_;
+  std::array<std::uint32_t, capacity> lengths_;
+  std::array<std::uint32_t, capacity> sequences_;
+  std::array<std::uint64_t, capacity> send_ns_;
+  std::array<std::uint64_t, capacity> schedules_;  // network order until decode()
+  std::array<std::uint16_t, capacity> accepted_;
+  std::array<std::uint16_t, capacity> probes_;
+  std::array<std::uint16_t, capacity> sampled_;
+  std::size_t count_ = 0;
+  std::size_t accepted_count_ = 0;
+  std::size_t probe_count_ = 0;
+  std::size_t sampled_count_ = 0;
+};
+
+// Receive accounting for every accepted datagram of a decoded batch, which
+// shares one receive stamp. Intent is measured whenever the sender scheduled
+// the datagram, including when it skipped the send stamp: lateness is exactly
+// what service hides. The schedule is the RTP timestamp's analogue for
+// jitter, and transit mixes the two hosts' clocks, which cancel in the
+// difference.
+template <LoopPolicy Policy = general_loop>
+inline void account_batch(Stats &stats, nll::SequenceTracker &sequences, PacketBatch &batch,
+                          std::uint64_t receive_real_ns, std::uint64_t receive_mono_ns,
+                          std::uint64_t sample_every) {
+  const auto accepted = batch.accepted();
+  if (accepted.empty()) return;
+  const auto sequence = batch.sequences();
+  const auto sent = batch.send_ns();
+  const auto scheduled = batch.scheduled_ns();
+  stats.valid_packets += accepted.size();
+  if constexpr (Policy.sampling) {
+    for (const auto index : accepted) {
+      record_one_way(stats, stats.service_latency_ns, receive_real_ns, sent[index]);
+      record_one_way(stats, stats.intent_latency_ns, receive_real_ns, scheduled[index]);
+    }
+  }
+  // The first datagram carries the spacing since the last batch; the rest
+  // arrived with it.
+  if (stats.first_receive_mono_ns == 0) stats.first_receive_mono_ns = receive_mono_ns;
+  else if (receive_mono_ns >= stats.last_receive_mono_ns)
+    stats.interarrival_ns.record(receive_mono_ns - stats.last_receive_mono_ns);
+  stats.interarrival_ns.record(0, accepted.size() - 1);
+  stats.last_receive_mono_ns = receive_mono_ns;
+  auto jitter_q4_ns = stats.jitter_q4_ns;
+  auto jitter_samples = stats.jitter_samples;
+  auto previous_transit_ns = stats.previous_transit_ns;
+  for (const auto index : accepted) {
+    const auto stamp = scheduled[index] ? scheduled[index] : sent[index];
+    if (!stamp) continue;
+    const auto transit = static_cast<std::int64_t>(receive_mono_ns - stamp);
+    if (jitter_samples++ != 0) {
+      const auto delta = transit - previous_transit_ns;
+      const auto magnitude = static_cast<std::uint64_t>(delta < 0 ? -delta : delta);
+      jitter_q4_ns = jitter_q4_ns + magnitude - ((jitter_q4_ns + 8) >> 4);
+    }
+    previous_transit_ns = transit;
+  }
+  stats.jitter_q4_ns = jitter_q4_ns;
+  stats.jitter_samples = jitter_samples;
+  stats.previous_transit_ns = previous_transit_ns;
+  for (const auto index : accepted) sequences.observe(sequence[index], receive_mono_ns);
+  if constexpr (Policy.sampling) {
+    if (sample_every != 0) {
+      batch.select_sampled(sample_every);
+      stats.sampled_packets += batch.sampled().size();
+    }
+  }
+}
+
+} // namespace nll::receiver
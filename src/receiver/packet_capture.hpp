@@ -0,0 +1,237 @@
+#pragma once
+
+#include "common/log.hpp"
+#include "common/spsc_queue.hpp"
+#include "common/time.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <netinet/in.h>
+#include <thread>
+#include <vector>
+
+namespace nll::receiver {
+
+// Received datagrams as pcapng, for --capture.
+//
+// Running tcpdump next to the receiver adds a second copy of every packet and
+// a process competing for the receiver's core. Here the ingress thread writes
+// each captured datagram straight into a pre-allocated block as an Enhanced
+// Packet Block, with a nanosecond CLOCK_REALTIME stamp and IPv4 and UDP headers
+// rebuilt from the source address, so standard tools decode it. A full block,
+// or one that has been open for flush_interval_ns, goes to a background writer
+// through an SPSC ring and comes back through a second ring once it is on
+// disk. When no block is free the datagram is counted as dropped rather than
+// stalling ingress. The binary log and the NLL_* diagnostics are untouched.
+struct CaptureStats {
+  std::uint64_t captured = 0;
+  std::uint64_t dropped = 0;  // no free block
+  std::uint64_t blocks_written = 0;
+  std::uint64_t bytes_written = 0;
+  std::uint64_t write_errors = 0;
+};
+
+class PacketCapture {
+public:
+  static constexpr std::size_t block_bytes = 256 * 1024;
+  static constexpr std::uint32_t block_count = 64;  // 16 MiB in flight at most
+  static constexpr std::uint64_t flush_interval_ns = 100'000'000;
+  static constexpr std::uint32_t default_snaplen = 65535;
+  static constexpr std::size_t rebuilt_header_bytes = 20 + 8;  // IPv4 and UDP
+
+  PacketCapture(const std::filesystem::path &path, std::uint32_t snaplen, std::uint64_t every,
+                std::uint16_t port)
+      : snaplen_(snaplen), every_(every), countdown_(every), port_(htons(port)) {
+    if (path.has_parent_path()) {
+      std::error_code ec;
+      std::filesystem::create_directories(path.parent_path(), ec);
+    }
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) {
+      NLL_ERROR("Cannot open capture %s: %s\n", path.c_str(), std::strerror(errno));
+      return;
+    }
+    // Zero-filled here, so every page is faulted in before the first packet.
+    storage_.resize(static_cast<std::size_t>(block_count) * block_bytes);
+    for (std::uint32_t block = 0; block < block_count; ++block) (void)free_.push(std::uint32_t{block});
+    write_file_header();
+    // Created before the caller pins its threads, so the writer never inherits
+    // the ingress core.
+    writer_ = std::thread([this] { write_loop(); });
+  }
+  PacketCapture(const PacketCapture &) = delete;
+  PacketCapture &operator=(const PacketCapture &) = delete;
+  ~PacketCapture() { finish(); }
+
+  [[nodiscard]] bool enabled() const noexcept { return file_ != nullptr; }
+
+  // Ingress thread, once per received datagram; every --capture-every'th one
+  // is kept, cut to the snap length.
+  void record(const std::byte *data, std::size_t length, const sockaddr_in *source,
+              std::uint64_t real_ns, std::uint64_t mono_ns) noexcept {
+    if (--countdown_) return;
+    countdown_ = every_;
+    const auto wire_length = rebuilt_header_bytes + length;
+    const auto captured = std::min<std::size_t>(wire_length, snaplen_);
+    const auto block_length = 32 + ((captured + 3) & ~std::size_t{3});
+    if (fill_ + block_length > block_bytes) hand_over();
+    if (current_ == no_block && !acquire(mono_ns)) { ++stats_.dropped; return; }
+    auto *out = block(current_) + fill_;
+    const std::uint32_t header[] = {6, static_cast<std::uint32_t>(block_length), 0,
+        static_cast<std::uint32_t>(real_ns >> 32), static_cast<std::uint32_t>(real_ns),
+        static_cast<std::uint32_t>(captured), static_cast<std::uint32_t>(std::min<std::size_t>(wire_length, UINT32_MAX))};
+    std::memcpy(out, header, sizeof(header));
+    std::byte headers[rebuilt_header_bytes];
+    rebuild_headers(headers, length, source);
+    const auto header_copy = std::min(captured, rebuilt_header_bytes);
+    std::memcpy(out + 28, headers, header_copy);
+    if (captured > header_copy) std::memcpy(out + 28 + header_copy, data, captured - header_copy);
+    std::memset(out + 28 + captured, 0, block_length - 32 - captured);
+    const auto trailer = static_cast<std::uint32_t>(block_length);
+    std::memcpy(out + block_length - 4, &trailer, sizeof(trailer));
+    fill_ += block_length;
+    ++stats_.captured;
+  }
+
+  // Ingress thread, once per receive call: a quiet receiver's last packets
+  // still reach the file within flush_interval_ns.
+  void tick(std::uint64_t mono_ns) noexcept {
+    if (fill_ && mono_ns - opened_ns_ >= flush_interval_ns) hand_over();
+  }
+
+  // Ingress thread after its loop: hands over the open block and waits for the
+  // writer to put everything on disk. False if any write failed.
+  bool finish() noexcept {
+    if (!file_) return stats_.write_errors == 0;
+    if (fill_) hand_over();
+    done_.store(true, std::memory_order_release);
+    if (writer_.joinable()) writer_.join();
+    stats_.blocks_written = blocks_written_.load(std::memory_order_relaxed);
+    stats_.bytes_written += bytes_written_.load(std::memory_order_relaxed);
+    stats_.write_errors += write_errors_.load(std::memory_order_relaxed);
+    if (std::fclose(file_) != 0) ++stats_.write_errors;
+    file_ = nullptr;
+    return stats_.write_errors == 0;
+  }
+
+  // Final after finish().
+  [[nodiscard]] const CaptureStats &stats() const noexcept { return stats_; }
+
+private:
+  static constexpr std::uint32_t no_block = UINT32_MAX;
+
+  std::byte *block(std::uint32_t index) noexcept {
+    return storage_.data() + static_cast<std::size_t>(index) * block_bytes;
+  }
+
+  bool acquire(std::uint64_t mono_ns) noexcept {
+    const auto next = free_.front();
+    if (!next) return false;
+    current_ = **next;
+    free_.pop();
+    fill_ = 0;
+    opened_ns_ = mono_ns;
+    return true;
+  }
+
+  void hand_over() noexcept {
+    if (current_ == no_block) return;
+    lengths_[current_] = static_cast<std::uint32_t>(fill_);
+    // Never full: the two rings together hold every block but the open one.
+    (void)full_.push(std::uint32_t{current_});
+    current_ = no_block;
+    fill_ = 0;
+  }
+
+  void rebuild_headers(std::byte *out, std::size_t payload_length, const sockaddr_in *source) const noexcept {
+    const auto total = static_cast<std::uint16_t>(std::min<std::size_t>(rebuilt_header_bytes + payload_length, 65535));
+    std::uint16_t ip[10] = {htons(0x4500), htons(total), 0, htons(0x4000), htons(0x4011), 0, 0, 0, 0, 0};
+    const std::uint32_t address = source ? source->sin_addr.s_addr : 0;
+    std::memcpy(&ip[6], &address, sizeof(address));
+    std::uint32_t sum = 0;
+    for (const auto word : ip) sum += word;
+    while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+    ip[5] = static_cast<std::uint16_t>(~sum);
+    const std::uint16_t udp[4] = {source ? source->sin_port : std::uint16_t{0}, port_,
+        htons(static_cast<std::uint16_t>(std::min<std::size_t>(8 + payload_length, 65535))), 0};
+    std::memcpy(out, ip, sizeof(ip));
+    std::memcpy(out + sizeof(ip), udp, sizeof(udp));
+  }
+
+  // Section Header and Interface Description: IPv4 link type, the configured
+  // snap length, and if_tsresol = 9, so Enhanced Packet Block timestamps are
+  // nanoseconds.
+  void write_file_header() {
+    const struct __attribute__((packed)) {
+      std::uint32_t type = 0x0a0d0d0a, length = 28, byte_order = 0x1a2b3c4d;
+      std::uint16_t major = 1, minor = 0;
+      std::uint64_t section_length = UINT64_MAX;  // unknown
+      std::uint32_t trailer = 28;
+    } section;
+    struct __attribute__((packed)) {
+      std::uint32_t type = 1, length = 32;
+      std::uint16_t link_type = 228, reserved = 0;  // LINKTYPE_IPV4
+      std::uint32_t snaplen = 0;
+      std::uint16_t option = 9, option_length = 1;  // if_tsresol
+      std::uint8_t resolution = 9, padding[3] = {};
+      std::uint32_t end_of_options = 0, trailer = 32;
+    } interface;
+    interface.snaplen = snaplen_;
+    if (std::fwrite(&section, sizeof(section), 1, file_) != 1 ||
+        std::fwrite(&interface, sizeof(interface), 1, file_) != 1)
+      ++stats_.write_errors;
+    else
+      stats_.bytes_written = sizeof(section) + sizeof(interface);
+  }
+
+  void write_loop() {
+    for (;;) {
+      const bool done = done_.load(std::memory_order_acquire);
+      bool wrote = false;
+      while (auto next = full_.front()) {
+        const auto index = **next;
+        full_.pop();
+        if (std::fwrite(block(index), 1, lengths_[index], file_) == lengths_[index]) {
+          blocks_written_.fetch_add(1, std::memory_order_relaxed);
+          bytes_written_.fetch_add(lengths_[index], std::memory_order_relaxed);
+        } else {
+          write_errors_.fetch_add(1, std::memory_order_relaxed);
+        }
+        (void)free_.push(std::uint32_t{index});
+        wrote = true;
+      }
+      if (done) { std::fflush(file_); return; }
+      if (!wrote) nll::sleep_ns(2'000'000ULL);
+    }
+  }
+
+  std::uint32_t snaplen_;
+  std::uint64_t every_;
+  std::uint64_t countdown_;
+  std::uint16_t port_ = 0;  // network order
+  std::FILE *file_ = nullptr;
+  std::vector<std::byte> storage_;
+  // Written by ingress before the index is pushed, read by the writer after.
+  std::uint32_t lengths_[block_count] = {};
+  nll::SPSCQueue<std::uint32_t, block_count * 2> full_;  // ingress to writer
+  nll::SPSCQueue<std::uint32_t, block_count * 2> free_;  // writer to ingress
+  // Ingress-owned state.
+  std::uint32_t current_ = no_block;  // opened by acquire(), which stamps it
+  std::size_t fill_ = 0;
+  std::uint64_t opened_ns_ = 0;
+  CaptureStats stats_;
+  // Writer-owned counters, read after join.
+  std::atomic<std::uint64_t> blocks_written_{0};
+  std::atomic<std::uint64_t> bytes_written_{0};
+  std::atomic<std::uint64_t> write_errors_{0};
+  std::atomic<bool> done_{false};
+  std::thread writer_;
+};
+
+} // namespace nll::receiver
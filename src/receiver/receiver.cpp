@@ -0,0 +1,15 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "receiver/engine.hpp"
+
+// Every ingress x topology combination; the receiver_* binaries are fixed
+// points of this one and write identical statistics for the same choice.
+int main(int argc, char **argv) {
+  return nll::receiver::receiver_main(argc, argv, {
+      .program = "receiver",
+      .summary = "Receiver with a selectable ingress backend and processing topology.",
+      .ingress = nll::receiver::Ingress::recvmmsg,
+      .topology = nll::receiver::Topology::inline_processing,
+      .selectable = true});
+}
@@ -1,12 +1,26 @@
 #pragma once
 
+#include "common/arena.hpp"
+#include "common/crc32c.hpp"
 #include "common/csv_writer.hpp"
+#include "common/flow_table.hpp"
 #include "common/log.hpp"
+#include "common/log_histogram.hpp"
 #include "common/packet.hpp"
+#include "common/perf_counters.hpp"
 #include "common/sequence_tracker.hpp"
+#include "common/telemetry.hpp"
 #include "common/thread_utils.hpp"
 #include "common/time.hpp"
+#include "receiver/clock_responder.hpp"
+#include "receiver/kernel_drops.hpp"
+#include "receiver/loop_policy.hpp"
+#include "receiver/packet_capture.hpp"
+#include "receiver/socket_memory.hpp"
+#include "receiver/work_model.hpp"
 
+#include <algorithm>
+#include <arpa/inet.h>
 #include <cerrno>
 #include <charconv>
 #include <cstdint>
@@ -15,8 +29,10 @@
 #include <filesystem>
 #include <limits>
 #include <netinet/in.h>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <vector>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
@@ -32,8 +48,31 @@ namespace nll::receiver {
 // truncated_packets rather than silently accepted.
 constexpr std::size_t receive_slot_bytes = 2048;
 
+// How datagrams leave the kernel and which thread processes them; see
+// receiver/engine.hpp. The three historical variants are points in this matrix.
+enum class Ingress : std::uint8_t { recvfrom, recvmmsg };
+enum class Topology : std::uint8_t { inline_processing, spsc_worker };
+
+inline const char *ingress_name(Ingress ingress) noexcept {
+  return ingress == Ingress::recvmmsg ? "recvmmsg" : "recvfrom";
+}
+
+inline const char *topology_name(Topology topology) noexcept {
+  return topology == Topology::spsc_worker ? "spsc" : "inline";
+}
+
+// Stats and telemetry keep the names analysis already keys on.
+inline std::string variant_name(Ingress ingress, Topology topology) {
+  if (topology == Topology::inline_processing)
+    return ingress == Ingress::recvfrom ? "baseline" : "batched";
+  if (ingress == Ingress::recvmmsg) return "threaded";
+  return std::string(ingress_name(ingress)) + "-" + topology_name(topology);
+}
+
 struct Config {
   std::string variant;
+  Ingress ingress = Ingress::recvfrom;
+  Topology topology = Topology::inline_processing;
   std::uint16_t port = 49200;
   std::filesystem::path output_path = "latency.bin";
   std::filesystem::path stats_path = "receiver_stats.json";
@@ -42,14 +81,40 @@ struct Config {
   int worker_cpu = -1;
   std::uint32_t batch_size = 1;
   std::uint64_t work_ns = 0;
+  WorkModel work_model = WorkModel::spin;
+  std::uint64_t working_set_bytes = WorkKernel::default_working_set_bytes;
   std::uint64_t sample_every = 1;
   int socket_buffer_bytes = 0;
   std::string scheduler = "other";
   int priority = 0;
+  bool telemetry = false;
+  std::filesystem::path timeseries_path{};
+  std::uint64_t interval_ms = 100;
+  nll::ClockSource clock = nll::ClockSource::system;
+  bool perf_counters = false;
+  bool verify_crc = false;
+  bool packet_stamps = true;
+  nll::memory::PagePolicy page_policy = nll::memory::PagePolicy::automatic;
+  std::uint16_t control_port = 0;  // 0: no control socket
+  std::uint32_t max_sources = 0;  // 0: no per-source accounting
+  bool kernel_drops = false;  // SO_RXQ_OVFL attribution
+  std::uint64_t meminfo_interval_us = 0;  // 0: no SO_MEMINFO sampling
+  std::filesystem::path clock_log_path{};  // empty: clock probes are not answered
+  std::filesystem::path capture_path{};  // empty: no pcapng capture
+  std::uint32_t capture_snaplen = PacketCapture::default_snaplen;
+  std::uint64_t capture_every = 1;
 };
 
+// Source addresses are needed to account per source, to answer clock probes
+// and to rebuild captured packets' IP headers.
+inline bool captures_source(const Config &config) noexcept {
+  return config.max_sources != 0 || !config.clock_log_path.empty() || !config.capture_path.empty();
+}
+
 struct ProcessingStats {
   std::uint64_t processed_packets = 0;
+  // Sum of receive-to-finish residence on the mono clock, for interval means.
+  std::uint64_t latency_sum_ns = 0;
   std::uint64_t first_processing_mono_ns = 0;
   std::uint64_t last_processing_mono_ns = 0;
   nll::SequenceTracker sequences;
@@ -73,8 +138,11 @@ struct Stats {
   std::uint64_t truncated_packets = 0;
   std::uint64_t invalid_magic = 0;
   std::uint64_t unsupported_version = 0;
+  std::uint64_t header_v2_packets = 0;
   std::uint64_t spsc_overflow = 0;
   std::uint64_t socket_errors = 0;
+  std::uint64_t crc_checked_packets = 0;
+  std::uint64_t crc_corrupt_packets = 0;
   std::uint64_t receive_syscalls = 0;
   std::uint64_t sampled_packets = 0;
   std::uint64_t first_receive_mono_ns = 0;
@@ -87,6 +155,46 @@ struct Stats {
   int requested_socket_buffer_bytes = 0;
   int observed_socket_buffer_bytes = 0;
   bool interrupted = false;
+  std::string telemetry_page;
+  std::uint64_t log_messages_dropped = 0;
+  std::uint64_t timeseries_samples = 0;
+  std::uint64_t timeseries_dropped = 0;
+  std::uint64_t control_requests = 0;
+  nll::GapTimeline receive_gap_timeline;
+  nll::GapTimeline processed_gap_timeline;
+  // One-way CLOCK_REALTIME latency of stamped packets, from the actual send
+  // (service) and, for v2 headers, from the scheduled send (intent). Recorded
+  // only by loops that stamp receive times, i.e. when --sample-every is set.
+  nll::LogHistogram service_latency_ns;
+  nll::LogHistogram intent_latency_ns;
+  // Receive stamp earlier than the send stamp: the hosts' clocks disagree.
+  std::uint64_t negative_latency_samples = 0;
+  // Arrival spacing of every valid datagram on the ingress mono stamp, which
+  // is taken once per receive syscall: a recvmmsg batch shows up as zeros, so
+  // the zero bucket measures how much the kernel delivers in bursts.
+  nll::LogHistogram interarrival_ns;
+  // RFC 3550 interarrival jitter, scaled by 16 as in its reference code, over
+  // datagrams carrying a schedule or a send stamp; arrivals in receive order.
+  std::uint64_t jitter_q4_ns = 0;
+  std::uint64_t jitter_samples = 0;
+  std::int64_t previous_transit_ns = 0;
+  KernelDropTimeline kernel_drop_timeline;
+  SocketMemoryStats socket_memory;
+  CaptureStats capture;
+  // Clock probes never reach the sequence accounting, answered or not.
+  ClockResponder clock;
+  // Per-source sequence state, written by the ingress thread; its slots live
+  // in the engine's arena. Disabled unless --per-source is given.
+  nll::FlowTable sources;
+  WorkCalibration work;
+  std::uint64_t work_checksum = 0;
+  nll::memory::ArenaReport arena;
+  // Every thread of the process, over the receive loop.
+  nll::memory::PageFaults page_faults;
+  // Ingress covers receive and, in the inline variants, processing too; the
+  // threaded receiver's worker loop has its own group.
+  nll::perf::Reading ingress_counters;
+  std::optional<nll::perf::Reading> worker_counters;
 };
 
 struct ReceivedPacket {
@@ -127,6 +235,52 @@ inline bool parse_int(std::string_view text, int min, int max, int &value,
   return true;
 }
 
+inline bool parse_page_policy(std::string_view text, nll::memory::PagePolicy &policy) {
+  const auto parsed = nll::memory::parse_page_policy(text);
+  if (!parsed) {
+    std::fprintf(stderr, "Invalid hugepages policy: %.*s (expected auto, hugetlb, thp or normal)\n",
+                 static_cast<int>(text.size()), text.data());
+    return false;
+  }
+  policy = *parsed;
+  return true;
+}
+
+inline bool parse_clock(std::string_view text, nll::ClockSource &clock) {
+  const auto parsed = nll::parse_clock_source(text);
+  if (!parsed) {
+    std::fprintf(stderr, "Invalid clock: %.*s (expected system or cycles)\n",
+                 static_cast<int>(text.size()), text.data());
+    return false;
+  }
+  clock = *parsed;
+  return true;
+}
+
+// Calibrates before any thread starts; the selection is read unsynchronized on
+// the hot path afterwards.
+inline bool select_clock(const Config &config) {
+  if (nll::select_timestamp_source(config.clock)) return true;
+  NLL_ERROR("Cycle counter clock unavailable or failed to calibrate\n");
+  return false;
+}
+
+inline LoopPolicy loop_policy(const Config &config) noexcept {
+  return {.sampling = config.sample_every != 0, .work = config.work_ns != 0,
+          .bounded = config.max_packets != 0, .timestamping = config.packet_stamps};
+}
+
+inline bool parse_work_model(std::string_view text, WorkModel &model) {
+  const auto parsed = work_model_from_name(text);
+  if (!parsed) {
+    std::fprintf(stderr, "Invalid work model: %.*s (expected spin, hash, chase, or compute)\n",
+                 static_cast<int>(text.size()), text.data());
+    return false;
+  }
+  model = *parsed;
+  return true;
+}
+
 inline bool validate_scheduler(const Config &config) {
   if (config.scheduler != "other" && config.scheduler != "fifo" && config.scheduler != "rr") {
     std::fprintf(stderr, "Invalid scheduler: %s (expected other, fifo, or rr)\n", config.scheduler.c_str());
@@ -191,6 +345,66 @@ inline void merge_processing(Stats &stats, const ProcessingStats &processing) {
   stats.processed_out_of_window = processing.sequences.out_of_window();
   stats.first_processing_mono_ns = processing.first_processing_mono_ns;
   stats.last_processing_mono_ns = processing.last_processing_mono_ns;
+  stats.processed_gap_timeline = processing.sequences.gap_timeline();
+}
+
+// Sources in address and port order, so two runs of one topology diff cleanly.
+inline void write_sources(std::FILE *file, const Config &config, const nll::FlowTable &table) {
+  std::fprintf(file, "  \"per_source\": {\"enabled\": %s, \"max_sources\": %u, \"sources\": %u, "
+      "\"untracked_packets\": %llu, \"flows\": [",
+      table.enabled() ? "true" : "false", config.max_sources, table.flows(),
+      static_cast<unsigned long long>(table.untracked_packets()));
+  std::vector<const nll::FlowTable::Entry *> entries;
+  for (const auto &entry : table.slots())
+    if (entry.key) entries.push_back(&entry);
+  std::sort(entries.begin(), entries.end(), [](const auto *left, const auto *right) {
+    return left->key < right->key;
+  });
+  bool first = true;
+  for (const auto *entry : entries) {
+    const in_addr address{.s_addr = nll::FlowTable::address_of(entry->key)};
+    char text[INET_ADDRSTRLEN] = "";
+    ::inet_ntop(AF_INET, &address, text, sizeof(text));
+    std::fprintf(file, "%s\n    {\"address\": \"%s\", \"port\": %u, \"flow_id\": ",
+                 first ? "" : ",", text, ntohs(nll::FlowTable::port_of(entry->key)));
+    if (entry->tagged) std::fprintf(file, "%u", entry->flow_id);
+    else std::fprintf(file, "null");
+    std::fprintf(file, ", \"packets\": %llu, \"lost\": %llu, \"reordered\": %llu, "
+        "\"gap_events\": %llu, \"first_sequence\": %u, \"highest_sequence\": %u, "
+        "\"first_receive_mono_ns\": %llu, \"last_receive_mono_ns\": %llu}",
+        static_cast<unsigned long long>(entry->packets),
+        static_cast<unsigned long long>(entry->lost()),
+        static_cast<unsigned long long>(entry->reordered),
+        static_cast<unsigned long long>(entry->gap_events),
+        entry->minimum_sequence, entry->highest_sequence,
+        static_cast<unsigned long long>(entry->first_receive_mono_ns),
+        static_cast<unsigned long long>(entry->last_receive_mono_ns));
+    first = false;
+  }
+  std::fprintf(file, "%s]},\n", first ? "" : "\n  ");
+}
+
+inline void write_gap_timeline(std::FILE *file, const char *name,
+                               const nll::GapTimeline &timeline) {
+  std::fprintf(file, "  \"%s\": {\"events_recorded\": %llu, \"burst_length_histogram\": {",
+      name, static_cast<unsigned long long>(timeline.recorded()));
+  bool first = true;
+  const auto &histogram = timeline.burst_histogram();
+  for (std::size_t bucket = 0; bucket < histogram.size(); ++bucket) {
+    if (!histogram[bucket]) continue;
+    std::fprintf(file, "%s\"%llu\": %llu", first ? "" : ", ",
+        static_cast<unsigned long long>(nll::GapTimeline::bucket_floor(bucket)),
+        static_cast<unsigned long long>(histogram[bucket]));
+    first = false;
+  }
+  std::fprintf(file, "}, \"events\": [");
+  for (std::size_t index = 0; index < timeline.retained(); ++index) {
+    const auto &event = timeline.event(index);
+    std::fprintf(file, "%s{\"first_sequence\": %u, \"length\": %u, \"revealed_mono_ns\": %llu}",
+        index ? ", " : "", event.first_sequence, event.length,
+        static_cast<unsigned long long>(event.revealed_ns));
+  }
+  std::fprintf(file, "]},\n");
 }
 
 inline bool write_stats(const Config &config, const Stats &stats,
@@ -207,6 +421,8 @@ inline bool write_stats(const Config &config, const Stats &stats,
   if (!file) { NLL_ERROR("Cannot open stats file %s: %s\n", config.stats_path.c_str(), std::strerror(errno)); return false; }
 #define NLL_U64(name) std::fprintf(file, "  \"" #name "\": %llu,\n", static_cast<unsigned long long>(stats.name))
   std::fprintf(file, "{\n  \"schema_version\": 2,\n  \"variant\": \"%s\",\n", config.variant.c_str());
+  std::fprintf(file, "  \"ingress\": \"%s\",\n  \"topology\": \"%s\",\n",
+               ingress_name(config.ingress), topology_name(config.topology));
   std::fprintf(file, "  \"port\": %u,\n  \"batch_size\": %u,\n", config.port, config.batch_size);
   std::fprintf(file, "  \"work_ns\": %llu,\n  \"sample_every\": %llu,\n",
       static_cast<unsigned long long>(config.work_ns), static_cast<unsigned long long>(config.sample_every));
@@ -217,8 +433,10 @@ inline bool write_stats(const Config &config, const Stats &stats,
   NLL_U64(processed_sequence_gaps); NLL_U64(processed_duplicates); NLL_U64(processed_reordered);
   NLL_U64(processed_out_of_window);
   NLL_U64(short_packets); NLL_U64(truncated_packets);
-  NLL_U64(invalid_magic); NLL_U64(unsupported_version); NLL_U64(spsc_overflow);
+  NLL_U64(invalid_magic); NLL_U64(unsupported_version); NLL_U64(header_v2_packets);
+  NLL_U64(spsc_overflow);
   NLL_U64(socket_errors); NLL_U64(receive_syscalls); NLL_U64(sampled_packets);
+  NLL_U64(crc_checked_packets); NLL_U64(crc_corrupt_packets);
   NLL_U64(first_receive_mono_ns); NLL_U64(last_receive_mono_ns);
   NLL_U64(first_processing_mono_ns); NLL_U64(last_processing_mono_ns);
   NLL_U64(drain_duration_ns); NLL_U64(queue_depth_at_shutdown); NLL_U64(socket_pending_bytes_at_shutdown);
@@ -226,6 +444,87 @@ inline bool write_stats(const Config &config, const Stats &stats,
   std::fprintf(file, "  \"requested_socket_buffer_bytes\": %d,\n", stats.requested_socket_buffer_bytes);
   std::fprintf(file, "  \"observed_socket_buffer_bytes\": %d,\n", stats.observed_socket_buffer_bytes);
   std::fprintf(file, "  \"interrupted\": %s,\n", stats.interrupted ? "true" : "false");
+  std::fprintf(file, "  \"telemetry_page\": \"%s\",\n", json_escape(stats.telemetry_page).c_str());
+  std::fprintf(file, "  \"log_messages_dropped\": %llu,\n",
+               static_cast<unsigned long long>(stats.log_messages_dropped));
+  std::fprintf(file, "  \"timeseries\": {\"enabled\": %s, \"path\": \"%s\", \"format\": \"ndjson-v1\", "
+      "\"interval_ms\": %llu, \"samples\": %llu, \"dropped\": %llu},\n",
+      config.timeseries_path.empty() ? "false" : "true",
+      json_escape(config.timeseries_path.string()).c_str(),
+      static_cast<unsigned long long>(config.interval_ms),
+      static_cast<unsigned long long>(stats.timeseries_samples),
+      static_cast<unsigned long long>(stats.timeseries_dropped));
+  std::fprintf(file, "  \"one_way_latency_ns\": {\"clock\": \"CLOCK_REALTIME\", \"service\": ");
+  stats.service_latency_ns.write_json(file);
+  std::fprintf(file, ", \"intent\": ");
+  stats.intent_latency_ns.write_json(file);
+  std::fprintf(file, ", \"negative_samples\": %llu},\n",
+               static_cast<unsigned long long>(stats.negative_latency_samples));
+  write_sources(file, config, stats.sources);
+  write_json(file, config.kernel_drops, stats.kernel_drop_timeline);
+  write_json(file, config.meminfo_interval_us, stats.socket_memory);
+  std::fprintf(file, "  \"interarrival_ns\": ");
+  stats.interarrival_ns.write_json(file);
+  std::fprintf(file, ",\n  \"rfc3550_jitter\": {\"jitter_ns\": %llu, \"samples\": %llu},\n",
+      static_cast<unsigned long long>(stats.jitter_q4_ns >> 4),
+      static_cast<unsigned long long>(stats.jitter_samples));
+  const auto &clock = stats.clock.estimator();
+  std::fprintf(file, "  \"clock_sync\": {\"enabled\": %s, \"path\": \"%s\", \"format\": \"clock-v1\", "
+      "\"probes\": %llu, \"replies\": %llu, \"reply_failures\": %llu, \"ignored\": %llu, "
+      "\"rounds\": %llu, \"min_delay_ns\": %llu, \"offset_ns\": %lld, \"drift_ppb\": %.3f},\n",
+      stats.clock.enabled() ? "true" : "false", json_escape(config.clock_log_path.string()).c_str(),
+      static_cast<unsigned long long>(stats.clock.probes()),
+      static_cast<unsigned long long>(stats.clock.replies()),
+      static_cast<unsigned long long>(stats.clock.reply_failures()),
+      static_cast<unsigned long long>(stats.clock.ignored()),
+      static_cast<unsigned long long>(clock.samples()),
+      static_cast<unsigned long long>(clock.minimum_delay_ns()),
+      static_cast<long long>(clock.estimate().offset_ns), clock.estimate().drift_ppb);
+  std::fprintf(file, "  \"capture\": {\"enabled\": %s, \"path\": \"%s\", \"format\": \"pcapng\", "
+      "\"snaplen\": %u, \"every\": %llu, \"captured\": %llu, \"dropped\": %llu, "
+      "\"blocks_written\": %llu, \"bytes_written\": %llu, \"write_errors\": %llu},\n",
+      config.capture_path.empty() ? "false" : "true", json_escape(config.capture_path.string()).c_str(),
+      config.capture_snaplen, static_cast<unsigned long long>(config.capture_every),
+      static_cast<unsigned long long>(stats.capture.captured),
+      static_cast<unsigned long long>(stats.capture.dropped),
+      static_cast<unsigned long long>(stats.capture.blocks_written),
+      static_cast<unsigned long long>(stats.capture.bytes_written),
+      static_cast<unsigned long long>(stats.capture.write_errors));
+  std::fprintf(file, "  \"control\": {\"enabled\": %s, \"port\": %u, \"requests\": %llu},\n",
+      config.control_port ? "true" : "false", config.control_port,
+      static_cast<unsigned long long>(stats.control_requests));
+  std::fprintf(file, "  \"timestamp_clock\": {\"source\": \"%s\", \"frequency_hz\": %.1f, "
+      "\"resolution_ns\": %.3f, \"reanchors\": %llu, \"max_correction_ns\": %llu},\n",
+      nll::clock_source_name(nll::timestamp_source), nll::timestamp_clock.frequency_hz(),
+      nll::timestamp_clock.resolution_ns(),
+      static_cast<unsigned long long>(nll::timestamp_clock.reanchors()),
+      static_cast<unsigned long long>(nll::timestamp_clock.max_correction_ns()));
+  std::fprintf(file, "  \"work_model\": {\"model\": \"%s\", \"target_ns\": %llu, "
+      "\"working_set_bytes\": %llu, \"units_per_packet\": %llu, \"ns_per_unit\": %.4f, "
+      "\"checksum\": %llu},\n",
+      work_model_name(config.work_model), static_cast<unsigned long long>(config.work_ns),
+      static_cast<unsigned long long>(stats.work.working_set_bytes),
+      static_cast<unsigned long long>(stats.work.units_per_packet), stats.work.ns_per_unit,
+      static_cast<unsigned long long>(stats.work_checksum));
+  const auto policy = loop_policy(config);
+  std::fprintf(file, "  \"loop_policy\": {\"sampling\": %s, \"work\": %s, \"bounded\": %s, "
+      "\"timestamping\": %s},\n",
+      policy.sampling ? "true" : "false", policy.work ? "true" : "false",
+      policy.bounded ? "true" : "false", policy.timestamping ? "true" : "false");
+  std::fprintf(file, "  \"payload_crc\": {\"enabled\": %s, \"algorithm\": \"crc32c\", "
+      "\"implementation\": \"%s\"},\n",
+      config.verify_crc ? "true" : "false", nll::crc32c_implementation());
+  nll::memory::write_json(file, stats.arena, stats.page_faults);
+  std::fprintf(file, "  \"perf_counters\": {\"enabled\": %s, \"ingress\": ",
+               config.perf_counters ? "true" : "false");
+  nll::perf::write_json(file, stats.ingress_counters, stats.datagrams_received);
+  if (stats.worker_counters) {
+    std::fprintf(file, ", \"worker\": ");
+    nll::perf::write_json(file, *stats.worker_counters, stats.processed_packets);
+  }
+  std::fprintf(file, "},\n");
+  write_gap_timeline(file, "receive_loss_bursts", stats.receive_gap_timeline);
+  write_gap_timeline(file, "processed_loss_bursts", stats.processed_gap_timeline);
   write_outcome(file, "receiver_affinity", rx_affinity);
   if (worker_affinity) write_outcome(file, "worker_affinity", *worker_affinity);
   write_outcome(file, "receiver_scheduler", rx_scheduler, worker_scheduler != nullptr);
@@ -279,24 +578,24 @@ inline std::uint64_t pending_socket_bytes(int fd) noexcept {
       ? static_cast<std::uint64_t>(pending) : 0;
 }
 
-inline void synthetic_work(std::uint64_t duration_ns) noexcept {
-  if (duration_ns == 0) return;
-  const auto start = nll::mono_ns();
-  while (nll::mono_ns() - start < duration_ns) nll::thread::cpu_relax();
-}
-
+template <LoopPolicy Policy = general_loop>
 inline void process_packet(nll::BinaryLogger &logger, ProcessingStats &stats,
-                           const ReceivedPacket &packet, std::uint64_t work_ns) {
-  const auto processing_mono_start = nll::mono_ns();
-  const auto processing_real_start = packet.sampled ? nll::real_ns() : 0;
-  synthetic_work(work_ns);
-  const auto processing_real_finish = packet.sampled ? nll::real_ns() : 0;
-  const auto processing_mono_finish = work_ns != 0 ? nll::mono_ns() : processing_mono_start;
+                           const ReceivedPacket &packet, WorkKernel &work) {
+  const bool sampled = Policy.sampling && packet.sampled;
+  const auto processing_mono_start =
+      Policy.timestamping ? nll::stamp_mono_ns() : packet.receive_mono_ns;
+  const auto processing_real_start = sampled ? nll::stamp_real_ns() : 0;
+  if constexpr (Policy.work) work.run(packet.message);
+  const auto processing_real_finish = sampled ? nll::stamp_real_ns() : 0;
+  const auto processing_mono_finish = Policy.timestamping && Policy.work && !work.idle()
+      ? nll::stamp_mono_ns() : processing_mono_start;
   if (stats.processed_packets == 0) stats.first_processing_mono_ns = processing_mono_start;
   stats.last_processing_mono_ns = processing_mono_finish;
+  if constexpr (Policy.timestamping)
+    stats.latency_sum_ns += processing_mono_finish - packet.receive_mono_ns;
   ++stats.processed_packets;
-  stats.sequences.observe(packet.message.seq_idx);
-  if (packet.sampled) {
+  stats.sequences.observe(packet.message.seq_idx, processing_mono_start);
+  if (sampled) {
     logger.log({.seq_idx = packet.message.seq_idx, .tx_ts = packet.message.send_unix_ns,
                 .rx_ts = packet.receive_real_ns,
                 .processing_start_ts = processing_real_start,
@@ -304,19 +603,42 @@ inline void process_packet(nll::BinaryLogger &logger, ProcessingStats &stats,
   }
 }
 
-inline ReceivedPacket account_receive(Stats &stats, nll::SequenceTracker &sequences,
-                                      const nll::message_header &message,
-                                      std::uint64_t receive_real_ns,
-                                      std::uint64_t receive_mono_ns,
-                                      std::uint64_t sample_every) {
-  ++stats.valid_packets;
-  if (stats.first_receive_mono_ns == 0) stats.first_receive_mono_ns = receive_mono_ns;
-  stats.last_receive_mono_ns = receive_mono_ns;
-  sequences.observe(message.seq_idx);
-  const bool sampled = sample_every != 0 && message.seq_idx % sample_every == 0;
-  if (sampled) ++stats.sampled_packets;
-  return {.message = message, .receive_real_ns = receive_real_ns,
-          .receive_mono_ns = receive_mono_ns, .sampled = sampled};
+// Counts, never drops: a corrupt datagram was still received and its header
+// still parsed, so it stays in the latency and loss accounting. A truncated
+// datagram lost its trailer to the slot and cannot be checked.
+inline void verify_payload(Stats &stats, const std::byte *payload, std::size_t length,
+                           bool truncated) noexcept {
+  if (truncated) return;
+  ++stats.crc_checked_packets;
+  if (!nll::payload_intact(payload, length)) ++stats.crc_corrupt_packets;
+}
+
+inline void record_one_way(Stats &stats, nll::LogHistogram &histogram, std::uint64_t receive_real_ns,
+                           std::uint64_t sent_real_ns) noexcept {
+  if (!sent_real_ns) return;
+  if (receive_real_ns < sent_real_ns) { ++stats.negative_latency_samples; return; }
+  histogram.record(receive_real_ns - sent_real_ns);
+}
+
+// Per-source accounting for a decoded datagram. A tagged datagram is counted
+// on its flow_sequence, which the sender keeps dense per flow; an untagged one
+// on seq_idx, which is dense only when each source is its own sender.
+inline void account_source(Stats &stats, const sockaddr_in &source, const std::byte *data,
+                           std::size_t length, const nll::message_header &message,
+                           std::uint64_t receive_mono_ns) noexcept {
+  const auto key = nll::FlowTable::source_key(source.sin_addr.s_addr, source.sin_port);
+  const auto offset = nll::message_header_bytes(message.version);
+  if ((message.msg_type & nll::msg_flag_flow_tag) && length >= offset + sizeof(nll::flow_tag)) {
+    nll::flow_tag tag{};
+    std::memcpy(&tag, data + offset, sizeof(tag));
+    tag.to_host();
+    if (auto *entry = stats.sources.observe(key, tag.flow_sequence, receive_mono_ns)) {
+      entry->flow_id = tag.flow_id;
+      entry->tagged = true;
+    }
+    return;
+  }
+  stats.sources.observe(key, message.seq_idx, receive_mono_ns);
 }
 
 inline void finalize_receive_sequences(Stats &stats, const nll::SequenceTracker &sequences) {
@@ -325,6 +647,38 @@ inline void finalize_receive_sequences(Stats &stats, const nll::SequenceTracker
   stats.receive_duplicates = sequences.duplicates();
   stats.receive_reordered = sequences.reordered();
   stats.receive_out_of_window = sequences.out_of_window();
+  stats.receive_gap_timeline = sequences.gap_timeline();
+}
+
+// Live counters for the nll_telemetry reader; inert unless --telemetry is given.
+// Block 0 is written by the ingress thread and block 1 by the processing thread,
+// which is the same thread in the synchronous variants.
+struct LiveTelemetry {
+  explicit LiveTelemetry(const Config &config) {
+    if (!config.telemetry) return;
+    page.emplace(nll::telemetry::Role::receiver, config.variant, 2);
+    ingress = page->publisher(0);
+    processing = page->publisher(1);
+  }
+  [[nodiscard]] std::string path() const { return page ? page->path() : ""; }
+
+  std::optional<nll::telemetry::SharedPage> page;
+  nll::telemetry::Publisher ingress;
+  nll::telemetry::Publisher processing;
+};
+
+inline void publish_ingress(nll::telemetry::Publisher &publisher, const Stats &stats,
+                            const nll::SequenceTracker &sequences) noexcept {
+  if (!publisher.enabled()) return;
+  publisher.publish({stats.datagrams_received, stats.valid_packets, 0,
+                     stats.spsc_overflow, stats.receive_syscalls,
+                     stats.socket_errors, sequences.gaps()});
+}
+
+inline void publish_processing(nll::telemetry::Publisher &publisher,
+                               const ProcessingStats &processing) noexcept {
+  if (!publisher.enabled()) return;
+  publisher.publish({0, 0, processing.processed_packets, 0, 0, 0, 0});
 }
 
 inline nll::thread::AffinityOutcome apply_affinity(int cpu) {
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "common/log_histogram.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <linux/sock_diag.h>
+#include <sys/socket.h>
+
+namespace nll::receiver {
+
+// Socket receive-queue occupancy over the run, for --meminfo-us.
+//
+// socket_pending_bytes_at_shutdown is one FIONREAD after the loop; it says
+// nothing about how close the queue came to SO_RCVBUF while the sender was
+// running. SO_MEMINFO returns the socket's charged receive memory (skb truesize,
+// the quantity the kernel compares against the doubled SO_RCVBUF), its limit
+// and its drop count in one getsockopt. The ingress thread takes one sample
+// when a receive call returns after the interval has elapsed, so the cost is a
+// compare per batch and a syscall per interval, and the final sample is taken
+// after the loop, where a backlog left unread still shows.
+struct SocketMemoryStats {
+  nll::LogHistogram occupancy_bytes;
+  std::uint32_t receive_buffer_bytes = 0;  // SK_MEMINFO_RCVBUF at the last sample
+  std::uint32_t drops = 0;                 // SK_MEMINFO_DROPS at the last sample
+  std::uint64_t failures = 0;
+};
+
+class SocketMemorySampler {
+public:
+  SocketMemorySampler(int fd, std::uint64_t interval_ns) noexcept
+      : fd_(fd), interval_ns_(interval_ns) {}
+
+  [[nodiscard]] bool enabled() const noexcept { return interval_ns_ != 0; }
+
+  void tick(std::uint64_t now, SocketMemoryStats &stats) noexcept {
+    if (interval_ns_ == 0 || now < next_sample_ns_) return;
+    sample(stats);
+    next_sample_ns_ = now + interval_ns_;
+  }
+
+  void sample(SocketMemoryStats &stats) const noexcept {
+    std::uint32_t info[SK_MEMINFO_VARS] = {};
+    socklen_t length = sizeof(info);
+    if (::getsockopt(fd_, SOL_SOCKET, SO_MEMINFO, info, &length) != 0 ||
+        length < (SK_MEMINFO_DROPS + 1) * sizeof(std::uint32_t)) {
+      ++stats.failures;
+      return;
+    }
+    stats.occupancy_bytes.record(info[SK_MEMINFO_RMEM_ALLOC]);
+    stats.receive_buffer_bytes = info[SK_MEMINFO_RCVBUF];
+    stats.drops = info[SK_MEMINFO_DROPS];
+  }
+
+private:
+  int fd_;
+  std::uint64_t interval_ns_;
+  std::uint64_t next_sample_ns_ = 0;
+};
+
+inline void write_json(std::FILE *file, std::uint64_t interval_us, const SocketMemoryStats &stats) {
+  const auto peak = stats.occupancy_bytes.max();
+  std::fprintf(file, "  \"socket_memory\": {\"enabled\": %s, \"interval_us\": %llu, "
+      "\"receive_buffer_bytes\": %u, \"peak_bytes\": %llu, \"peak_fraction\": %.4f, \"drops\": %u, "
+      "\"failures\": %llu, \"occupancy_bytes\": ",
+      interval_us ? "true" : "false", static_cast<unsigned long long>(interval_us),
+      stats.receive_buffer_bytes, static_cast<unsigned long long>(peak),
+      stats.receive_buffer_bytes ? static_cast<double>(peak) / stats.receive_buffer_bytes : 0.0,
+      stats.drops, static_cast<unsigned long long>(stats.failures));
+  stats.occupancy_bytes.write_json(file);
+  std::fprintf(file, "},\n");
+}
+
+} // namespace nll::receiver
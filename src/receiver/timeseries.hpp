@@ -0,0 +1,228 @@
+#pragma once
+
+#include "common/spsc_queue.hpp"
+#include "receiver/receiver_common.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+namespace nll::receiver {
+
+// Run totals hide warm-up, transient stalls and recovery. With --timeseries the
+// ingress thread closes an interval every --interval-ms and hands a fixed-size
+// sample of counter deltas to a background writer through an SPSC ring; the
+// hot path never formats or writes. The ring is sized for 25 s of 100 ms
+// samples, far more than the writer's 20 ms polling ever leaves queued, and a
+// sample that finds it full is counted rather than blocking ingress.
+inline constexpr std::size_t queue_depth_buckets = 14; // 0, then log2 up to 4096+
+
+struct IntervalSample {
+  std::uint64_t end_mono_ns = 0;
+  std::uint64_t interval_ns = 0;
+  std::uint64_t datagrams_received = 0;
+  std::uint64_t valid_packets = 0;
+  std::uint64_t processed_packets = 0;
+  std::uint64_t spsc_overflow = 0;
+  std::uint64_t receive_sequence_gaps = 0;
+  std::uint64_t kernel_drops = 0;  // SO_RXQ_OVFL; 0 without --kernel-drops
+  std::uint64_t receive_syscalls = 0;
+  std::uint64_t pending_socket_bytes = 0;
+  std::uint64_t latency_sum_ns = 0;
+  // Bucket 0 counts empty-queue samples; bucket b > 0 counts depths in
+  // [2^(b-1), 2^b). One sample per ingress batch.
+  std::array<std::uint64_t, queue_depth_buckets> queue_depth_histogram{};
+};
+
+class IntervalRecorder {
+public:
+  static constexpr std::size_t ring_capacity = 256;
+
+  explicit IntervalRecorder(const Config &config)
+      : interval_ns_(config.interval_ms * 1'000'000ULL) {
+    if (config.timeseries_path.empty()) return;
+    if (config.timeseries_path.has_parent_path()) {
+      std::error_code ec;
+      std::filesystem::create_directories(config.timeseries_path.parent_path(), ec);
+    }
+    file_ = std::fopen(config.timeseries_path.c_str(), "w");
+    if (!file_) {
+      NLL_ERROR("Cannot open timeseries %s: %s\n", config.timeseries_path.c_str(),
+                std::strerror(errno));
+      return;
+    }
+    // Created before the caller pins its threads, so the writer never inherits
+    // the ingress core; it wakes every 20 ms and otherwise sleeps.
+    writer_ = std::thread([this] { write_loop(); });
+  }
+
+  IntervalRecorder(const IntervalRecorder &) = delete;
+  IntervalRecorder &operator=(const IntervalRecorder &) = delete;
+  ~IntervalRecorder() { stop_writer(); }
+
+  [[nodiscard]] bool enabled() const noexcept { return file_ != nullptr; }
+
+  // Processing thread, once per batch. A relaxed store to a line this thread
+  // owns; ingress reads it once per interval.
+  void publish_processing(const ProcessingStats &processing) noexcept {
+    if (!file_) return;
+    processing_.processed.store(processing.processed_packets, std::memory_order_relaxed);
+    processing_.latency_sum_ns.store(processing.latency_sum_ns, std::memory_order_relaxed);
+  }
+
+  // Ingress thread, once per batch. Only the threaded receiver has a queue; the
+  // caller skips the SPSC size() read, and the worker's line it pulls, when the
+  // recorder is disabled.
+  void observe_queue_depth(std::uint64_t depth) noexcept {
+    if (!file_) return;
+    const auto bucket = std::min<std::size_t>(std::bit_width(depth), queue_depth_buckets - 1);
+    ++current_.queue_depth_histogram[bucket];
+  }
+
+  void tick(std::uint64_t now, const Stats &stats, const nll::SequenceTracker &sequences,
+            int fd) noexcept {
+    if (!file_) return;
+    if (next_tick_ns_ == 0) {
+      start_interval(now, stats, sequences);
+      return;
+    }
+    if (now < next_tick_ns_) return;
+    close_interval(now, stats, sequences, fd);
+  }
+
+  // Ingress thread after its loop, once the processing side has drained: emits
+  // the final partial interval and waits for the writer to flush everything.
+  void finish(std::uint64_t now, const Stats &stats, const nll::SequenceTracker &sequences,
+              int fd) noexcept {
+    if (!file_) return;
+    if (next_tick_ns_ != 0 && now > last_tick_ns_) close_interval(now, stats, sequences, fd);
+    stop_writer();
+  }
+
+  [[nodiscard]] std::uint64_t samples() const noexcept { return samples_; }
+  [[nodiscard]] std::uint64_t dropped() const noexcept { return dropped_; }
+
+private:
+  struct Totals {
+    std::uint64_t datagrams_received = 0, valid_packets = 0, processed_packets = 0,
+                  spsc_overflow = 0, receive_sequence_gaps = 0, kernel_drops = 0,
+                  receive_syscalls = 0, latency_sum_ns = 0;
+  };
+
+  Totals totals(const Stats &stats, const nll::SequenceTracker &sequences) const noexcept {
+    return {stats.datagrams_received, stats.valid_packets,
+            processing_.processed.load(std::memory_order_relaxed), stats.spsc_overflow,
+            sequences.gaps(), stats.kernel_drop_timeline.dropped(), stats.receive_syscalls,
+            processing_.latency_sum_ns.load(std::memory_order_relaxed)};
+  }
+
+  void start_interval(std::uint64_t now, const Stats &stats,
+                      const nll::SequenceTracker &sequences) noexcept {
+    last_ = totals(stats, sequences);
+    last_tick_ns_ = now;
+    next_tick_ns_ = now + interval_ns_;
+  }
+
+  void close_interval(std::uint64_t now, const Stats &stats,
+                      const nll::SequenceTracker &sequences, int fd) noexcept {
+    const auto current = totals(stats, sequences);
+    current_.end_mono_ns = now;
+    current_.interval_ns = now - last_tick_ns_;
+    current_.datagrams_received = current.datagrams_received - last_.datagrams_received;
+    current_.valid_packets = current.valid_packets - last_.valid_packets;
+    current_.processed_packets = current.processed_packets - last_.processed_packets;
+    current_.spsc_overflow = current.spsc_overflow - last_.spsc_overflow;
+    // Gaps can shrink when a reordered arrival fills a hole; clamp the delta.
+    current_.receive_sequence_gaps = current.receive_sequence_gaps > last_.receive_sequence_gaps
+        ? current.receive_sequence_gaps - last_.receive_sequence_gaps : 0;
+    current_.kernel_drops = current.kernel_drops - last_.kernel_drops;
+    current_.receive_syscalls = current.receive_syscalls - last_.receive_syscalls;
+    current_.latency_sum_ns = current.latency_sum_ns - last_.latency_sum_ns;
+    current_.pending_socket_bytes = pending_socket_bytes(fd);
+    if (ring_.push(std::move(current_))) ++samples_;
+    else ++dropped_;
+    current_ = {};
+    last_ = current;
+    last_tick_ns_ = now;
+    // Skip intervals the loop slept through rather than emitting a burst of
+    // empty catch-up samples; interval_ns records the real span.
+    next_tick_ns_ += interval_ns_ * ((now - next_tick_ns_) / interval_ns_ + 1);
+  }
+
+  void stop_writer() noexcept {
+    if (!writer_.joinable()) return;
+    done_.store(true, std::memory_order_release);
+    writer_.join();
+    std::fclose(file_);
+    file_ = nullptr;
+  }
+
+  void write_loop() {
+    for (;;) {
+      const bool done = done_.load(std::memory_order_acquire);
+      while (auto sample = ring_.front()) {
+        write_sample(**sample);
+        ring_.pop();
+      }
+      std::fflush(file_);
+      if (done) return;
+      nll::sleep_ns(20'000'000ULL);
+    }
+  }
+
+  void write_sample(const IntervalSample &sample) {
+    std::fprintf(file_,
+        "{\"end_mono_ns\": %llu, \"interval_ns\": %llu, \"datagrams_received\": %llu, "
+        "\"valid_packets\": %llu, \"processed_packets\": %llu, \"spsc_overflow\": %llu, "
+        "\"receive_sequence_gaps\": %llu, \"kernel_drops\": %llu, \"receive_syscalls\": %llu, "
+        "\"pending_socket_bytes\": %llu, \"mean_processing_latency_ns\": %.1f, "
+        "\"queue_depth_histogram\": {",
+        static_cast<unsigned long long>(sample.end_mono_ns),
+        static_cast<unsigned long long>(sample.interval_ns),
+        static_cast<unsigned long long>(sample.datagrams_received),
+        static_cast<unsigned long long>(sample.valid_packets),
+        static_cast<unsigned long long>(sample.processed_packets),
+        static_cast<unsigned long long>(sample.spsc_overflow),
+        static_cast<unsigned long long>(sample.receive_sequence_gaps),
+        static_cast<unsigned long long>(sample.kernel_drops),
+        static_cast<unsigned long long>(sample.receive_syscalls),
+        static_cast<unsigned long long>(sample.pending_socket_bytes),
+        sample.processed_packets
+            ? static_cast<double>(sample.latency_sum_ns) / static_cast<double>(sample.processed_packets)
+            : 0.0);
+    bool first = true;
+    for (std::size_t bucket = 0; bucket < sample.queue_depth_histogram.size(); ++bucket) {
+      if (!sample.queue_depth_histogram[bucket]) continue;
+      std::fprintf(file_, "%s\"%llu\": %llu", first ? "" : ", ",
+          bucket ? 1ULL << (bucket - 1) : 0ULL,
+          static_cast<unsigned long long>(sample.queue_depth_histogram[bucket]));
+      first = false;
+    }
+    std::fprintf(file_, "}}\n");
+  }
+
+  struct alignas(nll::cache_line_size) ProcessingMirror {
+    std::atomic<std::uint64_t> processed{0};
+    std::atomic<std::uint64_t> latency_sum_ns{0};
+  };
+
+  std::uint64_t interval_ns_;
+  std::FILE *file_ = nullptr;
+  ProcessingMirror processing_;
+  // Ingress-owned state.
+  alignas(nll::cache_line_size) IntervalSample current_{};
+  Totals last_{};
+  std::uint64_t last_tick_ns_ = 0;
+  std::uint64_t next_tick_ns_ = 0;
+  std::uint64_t samples_ = 0;
+  std::uint64_t dropped_ = 0;
+  nll::SPSCQueue<IntervalSample, ring_capacity> ring_;
+  std::atomic<bool> done_{false};
+  std::thread writer_;
+};
+
+} // namespace nll::receiver
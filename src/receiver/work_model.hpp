@@ -0,0 +1,206 @@
+#pragma once
+
+#include "common/packet.hpp"
+#include "common/thread_utils.hpp"
+#include "common/time.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <vector>
+
+namespace nll::receiver {
+
+// Per-packet synthetic processing.
+//
+// "spin" is the original model: it burns wall time on cpu_relax and touches no
+// memory, so the worker core's caches stay entirely free for the receive path
+// and the SPSC handoff. Real handlers have a cache footprint, and pipelining
+// looks better than it will in production when the work has none. The other
+// models do real work with a configurable working set, keyed by the datagram
+// so the payload is actually read:
+//
+//   hash     multiplicative hash and read-modify-write into a per-worker table
+//   chase    dependent loads through a random single-cycle permutation, one
+//            cache line per node, so every step is a cache or TLB miss once
+//            the working set outgrows the caches
+//   compute  a dependent integer multiply/xorshift chain; no memory at all
+//
+// Each kernel is calibrated on the thread that will run it, after pinning, by
+// timing a block of units and choosing units per packet to hit --work NS. The
+// count is then fixed, so when the receive path evicts the working set the
+// work genuinely takes longer instead of adapting to hide it.
+enum class WorkModel : std::uint8_t { spin, hash, chase, compute };
+
+inline std::optional<WorkModel> work_model_from_name(std::string_view name) noexcept {
+  if (name == "spin") return WorkModel::spin;
+  if (name == "hash") return WorkModel::hash;
+  if (name == "chase") return WorkModel::chase;
+  if (name == "compute") return WorkModel::compute;
+  return std::nullopt;
+}
+
+inline const char *work_model_name(WorkModel model) noexcept {
+  switch (model) {
+  case WorkModel::hash: return "hash";
+  case WorkModel::chase: return "chase";
+  case WorkModel::compute: return "compute";
+  case WorkModel::spin: break;
+  }
+  return "spin";
+}
+
+inline void synthetic_work(std::uint64_t duration_ns) noexcept {
+  if (duration_ns == 0) return;
+  const auto start = nll::stamp_mono_ns();
+  while (nll::stamp_mono_ns() - start < duration_ns) nll::thread::cpu_relax();
+}
+
+struct WorkCalibration {
+  WorkModel model = WorkModel::spin;
+  std::uint64_t target_ns = 0;
+  std::uint64_t working_set_bytes = 0;
+  std::uint64_t units_per_packet = 0;
+  double ns_per_unit = 0.0;
+};
+
+class WorkKernel {
+public:
+  static constexpr std::uint64_t default_working_set_bytes = 256 * 1024;
+
+  WorkKernel(WorkModel model, std::uint64_t target_ns, std::uint64_t working_set_bytes)
+      : model_(model), target_ns_(target_ns) {
+    if (target_ns_ == 0 || model_ == WorkModel::spin) return;
+    working_set_bytes_ = std::bit_ceil(std::max<std::uint64_t>(working_set_bytes, line_bytes));
+    if (model_ == WorkModel::hash) {
+      table_.assign(working_set_bytes_ / sizeof(std::uint64_t), 0);
+    } else if (model_ == WorkModel::chase) {
+      build_permutation(working_set_bytes_ / line_bytes);
+    }
+    calibrate();
+  }
+
+  // Processing thread, once per valid packet.
+  void run(const nll::message_header &message) noexcept {
+    if (target_ns_ == 0) return;
+    if (model_ == WorkModel::spin) {
+      synthetic_work(target_ns_);
+      return;
+    }
+    std::uint64_t key = 0;
+    static_assert(sizeof(message) >= 2 * sizeof(key));
+    std::memcpy(&key, &message, sizeof(key));
+    std::uint64_t tail = 0;
+    std::memcpy(&tail, reinterpret_cast<const std::byte *>(&message) + sizeof(key), sizeof(tail));
+    // Finalize so every header bit reaches the low bits a table index uses;
+    // the sequence number alone sits in the high half of the first word.
+    key ^= tail * 0x9E37'79B9'7F4A'7C15ULL;
+    key = (key ^ (key >> 33)) * 0xFF51'AFD7'ED55'8CCDULL;
+    key ^= key >> 33;
+    sink_ ^= execute(key, units_);
+  }
+
+  [[nodiscard]] bool idle() const noexcept { return target_ns_ == 0; }
+  [[nodiscard]] WorkCalibration calibration() const noexcept {
+    return {model_, target_ns_, working_set_bytes_, units_, ns_per_unit_};
+  }
+  // Folded into the stats so the compiler cannot discard the work.
+  [[nodiscard]] std::uint64_t checksum() const noexcept { return sink_; }
+
+private:
+  static constexpr std::uint64_t line_bytes = 64;
+
+  struct alignas(line_bytes) Node {
+    std::uint32_t next;
+  };
+
+  void build_permutation(std::uint64_t nodes) {
+    nodes_.resize(std::max<std::uint64_t>(nodes, 2));
+    std::vector<std::uint32_t> order(nodes_.size());
+    for (std::uint32_t index = 0; index < order.size(); ++index) order[index] = index;
+    // Sattolo's algorithm: one cycle through every node, so a chase never
+    // settles into a short loop that fits in L1.
+    std::mt19937_64 random(0x6e6c6cULL);
+    for (std::size_t index = order.size() - 1; index > 0; --index) {
+      std::uniform_int_distribution<std::size_t> pick(0, index - 1);
+      std::swap(order[index], order[pick(random)]);
+    }
+    for (std::size_t index = 0; index < order.size(); ++index)
+      nodes_[order[index]].next = order[(index + 1) % order.size()];
+  }
+
+  std::uint64_t execute(std::uint64_t key, std::uint64_t units) noexcept {
+    switch (model_) {
+    case WorkModel::hash: {
+      // splitmix64 over a running key; the loaded value feeds the next key,
+      // so lookups are dependent like a real flow-table probe sequence.
+      const auto mask = table_.size() - 1;
+      std::uint64_t state = key;
+      std::uint64_t hash = 0;
+      for (std::uint64_t unit = 0; unit < units; ++unit) {
+        state += 0x9E37'79B9'7F4A'7C15ULL;
+        hash = (state ^ (state >> 30)) * 0xBF58'476D'1CE4'E5B9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94D0'49BB'1331'11EBULL;
+        hash ^= hash >> 31;
+        auto &slot = table_[hash & mask];
+        slot += hash;
+        state ^= slot & 0xFFFF;
+      }
+      return hash;
+    }
+    case WorkModel::chase: {
+      auto position = static_cast<std::uint32_t>(key % nodes_.size());
+      for (std::uint64_t unit = 0; unit < units; ++unit) position = nodes_[position].next;
+      return position;
+    }
+    case WorkModel::compute: {
+      std::uint64_t value = key | 1U;
+      for (std::uint64_t unit = 0; unit < units; ++unit) {
+        value *= 0xD6E8'FEB8'6659'FD93ULL;
+        value ^= value >> 32;
+        value += unit;
+      }
+      return value;
+    }
+    case WorkModel::spin: break;
+    }
+    return 0;
+  }
+
+  // Doubles the block until it runs for at least 5 ms, after one warm-up pass
+  // over the working set, then takes the fastest of three timings.
+  void calibrate() noexcept {
+    execute(0x5eed, std::max<std::uint64_t>(working_set_bytes_ / line_bytes, 1024));
+    std::uint64_t block = 1024;
+    for (;;) {
+      const auto started = nll::mono_ns();
+      sink_ ^= execute(block, block);
+      if (nll::mono_ns() - started >= 5'000'000ULL || block >= (1ULL << 32)) break;
+      block *= 2;
+    }
+    std::uint64_t best = ~0ULL;
+    for (int repetition = 0; repetition < 3; ++repetition) {
+      const auto started = nll::mono_ns();
+      sink_ ^= execute(block + static_cast<std::uint64_t>(repetition), block);
+      best = std::min(best, nll::mono_ns() - started);
+    }
+    ns_per_unit_ = static_cast<double>(best) / static_cast<double>(block);
+    units_ = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(
+        static_cast<double>(target_ns_) / ns_per_unit_ + 0.5));
+  }
+
+  WorkModel model_;
+  std::uint64_t target_ns_;
+  std::uint64_t working_set_bytes_ = 0;
+  std::uint64_t units_ = 0;
+  double ns_per_unit_ = 0.0;
+  std::uint64_t sink_ = 0;
+  std::vector<std::uint64_t> table_;
+  std::vector<Node> nodes_;
+};
+
+} // namespace nll::receiver
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "common/control_protocol.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+namespace nll::sender {
+
+// Zero-loss capacity search over --rate, one sender and one receiver process.
+//
+// Each trial sends at one rate for --duration and judges it from the receiver's
+// --control snapshots taken before and after (see common/control_protocol.hpp);
+// sequence numbers keep counting across trials, so the receiver sees a single
+// stream and the unique-sequence delta is exactly what arrived. The first
+// trial runs at the maximum (--rate) and ends the search if it passes; the
+// second runs at --search-min and ends it if that fails. Otherwise the search
+// bisects between the highest passing and lowest failing rate until they are
+// within --search-precision of each other.
+class CapacitySearch {
+public:
+  CapacitySearch(std::uint64_t min_pps, std::uint64_t max_pps, double precision) noexcept
+      : min_(min_pps), max_(max_pps), precision_(precision) {}
+
+  // The next rate to try, or nullopt once the search has converged.
+  [[nodiscard]] std::optional<std::uint64_t> next() const noexcept {
+    if (trials_ == 0) return max_;
+    if (passed_ == max_) return std::nullopt;
+    if (passed_ == 0) return min_tried_ ? std::nullopt : std::optional<std::uint64_t>(min_);
+    const auto resolution = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(static_cast<double>(passed_) * precision_));
+    if (failed_ - passed_ <= resolution) return std::nullopt;
+    return passed_ + (failed_ - passed_) / 2;
+  }
+
+  void record(std::uint64_t rate_pps, bool passed) noexcept {
+    ++trials_;
+    if (rate_pps == min_) min_tried_ = true;
+    if (passed) passed_ = std::max(passed_, rate_pps);
+    else failed_ = std::min(failed_, rate_pps);
+  }
+
+  // Highest passing rate; 0 if even --search-min lost packets.
+  [[nodiscard]] std::uint64_t capacity() const noexcept { return passed_; }
+  [[nodiscard]] std::uint32_t trials() const noexcept { return trials_; }
+
+private:
+  std::uint64_t min_;
+  std::uint64_t max_;
+  double precision_;
+  std::uint64_t passed_ = 0;
+  std::uint64_t failed_ = std::numeric_limits<std::uint64_t>::max();
+  std::uint32_t trials_ = 0;
+  bool min_tried_ = false;
+};
+
+struct TrialResult {
+  std::uint64_t rate_pps = 0;
+  std::uint64_t planned_sends = 0;
+  std::uint64_t attempted_sends = 0;
+  std::uint64_t successful_sends = 0;
+  std::uint64_t failed_sends = 0;
+  std::uint64_t received = 0;  // new unique sequences at the receiver
+  std::uint64_t lost = 0;
+  std::uint64_t receive_sequence_gaps = 0;
+  std::uint64_t spsc_overflow = 0;
+  std::uint64_t pending_socket_bytes = 0;  // at the closing snapshot
+  double mean_processing_latency_ns = 0.0;
+  bool sender_limited = false;
+  bool passed = false;
+};
+
+// A trial fails on loss above loss_tolerance of what was sent, on any sender
+// error, or when the sender fell more than 0.1% short of the schedule: then the
+// rate was never offered and says nothing about the receiver. Loss includes
+// the threaded receiver's SPSC overflow: those datagrams were counted unique at
+// ingress and then dropped before processing.
+inline TrialResult judge_trial(std::uint64_t rate_pps, std::uint64_t planned_sends,
+                               std::uint64_t attempted_sends, std::uint64_t successful_sends,
+                               std::uint64_t failed_sends, const nll::control::reply &before,
+                               const nll::control::reply &after, double loss_tolerance) noexcept {
+  const auto delta = [](std::uint64_t later, std::uint64_t earlier) {
+    return later > earlier ? later - earlier : 0;
+  };
+  TrialResult result{.rate_pps = rate_pps, .planned_sends = planned_sends,
+                     .attempted_sends = attempted_sends, .successful_sends = successful_sends,
+                     .failed_sends = failed_sends,
+                     .received = delta(after.unique_valid_packets, before.unique_valid_packets)};
+  result.spsc_overflow = delta(after.spsc_overflow, before.spsc_overflow);
+  result.lost = delta(successful_sends, result.received) + result.spsc_overflow;
+  result.receive_sequence_gaps = delta(after.receive_sequence_gaps, before.receive_sequence_gaps);
+  result.pending_socket_bytes = after.pending_socket_bytes;
+  const auto processed = delta(after.processed_packets, before.processed_packets);
+  if (processed)
+    result.mean_processing_latency_ns =
+        static_cast<double>(delta(after.processing_latency_sum_ns, before.processing_latency_sum_ns)) /
+        static_cast<double>(processed);
+  result.sender_limited = attempted_sends * 1000 < planned_sends * 999;
+  result.passed = successful_sends > 0 && failed_sends == 0 && !result.sender_limited &&
+      static_cast<double>(result.lost) <= loss_tolerance * static_cast<double>(successful_sends);
+  return result;
+}
+
+} // namespace nll::sender
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "common/clock_sync.hpp"
+#include "common/log.hpp"
+#include "common/packet.hpp"
+#include "common/time.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+namespace nll::sender {
+
+// Sender half of the in-band clock exchange, for --clock-sync HZ.
+//
+// One thread with its own socket sends a probe to the receiver's data port
+// every 1/HZ seconds for the length of the run and waits up to that long for
+// the reply, stamping t4 as soon as it is read. It never touches a worker's
+// socket or schedule. A reply to an older round, or one that never comes,
+// simply leaves that round incomplete; the next probe then carries no t4.
+class ClockProber {
+public:
+  struct Report {
+    std::uint64_t probes = 0;
+    std::uint64_t replies = 0;
+    std::uint64_t stale_replies = 0;  // for an earlier round, or malformed
+    nll::clock_sync::Estimator estimator;
+  };
+
+  ClockProber(const sockaddr_in &destination, std::uint32_t rate_hz) noexcept
+      : destination_(destination), interval_ns_(1'000'000'000ULL / rate_hz) {}
+  ClockProber(const ClockProber &) = delete;
+  ClockProber &operator=(const ClockProber &) = delete;
+  ~ClockProber() { stop(); if (fd_ >= 0) ::close(fd_); }
+
+  bool start() {
+    fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd_ < 0 || ::connect(fd_, reinterpret_cast<const sockaddr *>(&destination_),
+                             sizeof(destination_)) != 0) {
+      NLL_ERROR("Clock probe socket failed: %s\n", std::strerror(errno));
+      return false;
+    }
+    thread_ = std::thread([this] { run(); });
+    return true;
+  }
+
+  // Joins the thread; the report is final afterwards.
+  void stop() {
+    done_.store(true, std::memory_order_relaxed);
+    if (thread_.joinable()) thread_.join();
+  }
+
+  [[nodiscard]] const Report &report() const noexcept { return report_; }
+
+private:
+  struct __attribute__((packed)) Message {
+    nll::message_header header;
+    nll::clock_exchange exchange;
+  };
+
+  void run() {
+    std::uint32_t round = 0;
+    std::uint32_t previous_round = 0;
+    std::uint64_t previous_return_ns = 0;  // t4 of previous_round, 0 if it failed
+    auto next_probe_ns = nll::mono_ns();
+    while (!done_.load(std::memory_order_relaxed)) {
+      ++round;
+      const auto t1 = nll::stamp_real_ns();
+      Message probe{};
+      probe.header = {.magic = 0x6584, .version = nll::message_version_v1,
+                      .msg_type = nll::msg_type_clock_probe, .seq_idx = round, .send_unix_ns = t1};
+      probe.exchange = {.previous_round = previous_round, .reserved = 0, .origin_unix_ns = 0,
+                        .receive_unix_ns = 0, .previous_return_unix_ns = previous_return_ns};
+      probe.header.to_network();
+      probe.exchange.to_network();
+      if (::send(fd_, &probe, sizeof(probe), 0) == static_cast<ssize_t>(sizeof(probe))) ++report_.probes;
+      previous_round = round;
+      previous_return_ns = 0;
+      next_probe_ns += interval_ns_;
+      // Read replies until the next probe is due.
+      for (auto now = nll::mono_ns(); now < next_probe_ns && !done_.load(std::memory_order_relaxed);
+           now = nll::mono_ns()) {
+        pollfd descriptor{.fd = fd_, .events = POLLIN, .revents = 0};
+        const auto wait_ms = static_cast<int>((next_probe_ns - now + 999'999) / 1'000'000);
+        if (::poll(&descriptor, 1, wait_ms) <= 0) continue;
+        Message reply{};
+        const auto length = ::recv(fd_, &reply, sizeof(reply), MSG_DONTWAIT);
+        const auto t4 = nll::stamp_real_ns();
+        if (length != static_cast<ssize_t>(sizeof(reply))) { ++report_.stale_replies; continue; }
+        reply.header.to_host();
+        reply.exchange.to_host();
+        if (reply.header.magic != 0x6584 ||
+            (reply.header.msg_type & nll::msg_type_mask) != nll::msg_type_clock_reply ||
+            reply.header.seq_idx != round || reply.exchange.origin_unix_ns != t1) {
+          ++report_.stale_replies;
+          continue;
+        }
+        ++report_.replies;
+        nll::clock_sync::Sample sample{.round = round, .local_mono_ns = nll::mono_ns(), .t1 = t1,
+            .t2 = reply.exchange.receive_unix_ns, .t3 = reply.header.send_unix_ns, .t4 = t4};
+        if (nll::clock_sync::complete(sample)) {
+          report_.estimator.add(sample);
+          previous_return_ns = t4;
+        }
+      }
+      // A stalled thread probes again at once rather than in a burst.
+      const auto now = nll::mono_ns();
+      if (next_probe_ns < now) next_probe_ns = now;
+    }
+  }
+
+  sockaddr_in destination_;
+  std::uint64_t interval_ns_;
+  int fd_ = -1;
+  std::atomic<bool> done_{false};
+  std::thread thread_;
+  Report report_;
+};
+
+} // namespace nll::sender
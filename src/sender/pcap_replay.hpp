@@ -0,0 +1,371 @@
+#pragma once
+
+#include "sender/sender_common.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <optional>
+#include <span>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace nll::sender {
+
+// One UDP datagram found in a capture: when it was captured and how many
+// payload bytes it carried (from the UDP length, so a short snaplen does not
+// shrink it).
+struct ReplayPacket {
+  std::uint64_t capture_ns = 0;
+  std::uint32_t payload_bytes = 0;
+};
+
+struct CaptureSummary {
+  const char *format = "";     // "pcap" or "pcapng"
+  std::uint32_t link_type = 0;  // of the first interface
+  std::uint64_t records = 0;
+  std::uint64_t skipped_records = 0;  // not IPv4/IPv6 UDP, no timestamp, or unknown link type
+};
+
+namespace detail {
+
+inline constexpr std::uint32_t link_null = 0;
+inline constexpr std::uint32_t link_ethernet = 1;
+inline constexpr std::uint32_t link_raw_bsd = 12;
+inline constexpr std::uint32_t link_raw = 101;
+inline constexpr std::uint32_t link_loop = 108;
+inline constexpr std::uint32_t link_linux_sll = 113;
+inline constexpr std::uint32_t link_ipv4 = 228;
+inline constexpr std::uint32_t link_ipv6 = 229;
+inline constexpr std::uint32_t link_linux_sll2 = 276;
+
+inline std::uint16_t load16(const std::byte *data, bool swap) noexcept {
+  std::uint16_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return swap ? __builtin_bswap16(value) : value;
+}
+
+inline std::uint32_t load32(const std::byte *data, bool swap) noexcept {
+  std::uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return swap ? __builtin_bswap32(value) : value;
+}
+
+inline std::uint16_t load_network16(const std::byte *data) noexcept {
+  std::uint16_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return ntohs(value);
+}
+
+// UDP payload bytes of one captured frame; nullopt for anything that is not
+// the first fragment of an IPv4 or IPv6 UDP datagram.
+inline std::optional<std::uint32_t> udp_payload_bytes(std::uint32_t link_type, const std::byte *frame,
+                                                      std::size_t length) noexcept {
+  std::size_t offset = 0;
+  std::uint16_t protocol = 0;  // 0: go by the IP version nibble
+  switch (link_type) {
+  case link_null: case link_loop: offset = 4; break;  // address family, in the capturer's order
+  case link_raw_bsd: case link_raw: case link_ipv4: case link_ipv6: break;
+  case link_ethernet:
+    if (length < 14) return std::nullopt;
+    offset = 14;
+    protocol = load_network16(frame + 12);
+    while (protocol == 0x8100 || protocol == 0x88a8) {  // 802.1Q and 802.1ad tags
+      if (length < offset + 4) return std::nullopt;
+      protocol = load_network16(frame + offset + 2);
+      offset += 4;
+    }
+    break;
+  case link_linux_sll:
+    if (length < 16) return std::nullopt;
+    offset = 16;
+    protocol = load_network16(frame + 14);
+    break;
+  case link_linux_sll2:
+    if (length < 20) return std::nullopt;
+    offset = 20;
+    protocol = load_network16(frame);
+    break;
+  default: return std::nullopt;
+  }
+  if (length <= offset) return std::nullopt;
+  const auto version = std::to_integer<unsigned>(frame[offset]) >> 4;
+  if ((protocol == 0x0800 && version != 4) || (protocol == 0x86dd && version != 6) ||
+      (protocol && protocol != 0x0800 && protocol != 0x86dd))
+    return std::nullopt;
+  std::size_t udp = 0;
+  if (version == 4) {
+    const auto header = (std::to_integer<std::size_t>(frame[offset]) & 0xf) * 4;
+    if (header < 20 || length < offset + header) return std::nullopt;
+    if (std::to_integer<unsigned>(frame[offset + 9]) != IPPROTO_UDP ||
+        (load_network16(frame + offset + 6) & 0x1fff) != 0)
+      return std::nullopt;
+    udp = offset + header;
+  } else if (version == 6) {
+    // Extension headers are rare on UDP and not followed.
+    if (length < offset + 40 || std::to_integer<unsigned>(frame[offset + 6]) != IPPROTO_UDP)
+      return std::nullopt;
+    udp = offset + 40;
+  } else {
+    return std::nullopt;
+  }
+  if (length < udp + 8) return std::nullopt;
+  const auto udp_length = load_network16(frame + udp + 4);
+  if (udp_length < 8) return std::nullopt;
+  return udp_length - 8U;
+}
+
+inline bool read_pcap(std::span<const std::byte> file, std::vector<ReplayPacket> &packets,
+                      CaptureSummary &summary) {
+  if (file.size() < 24) return false;
+  const auto magic = load32(file.data(), false);
+  const bool swap = magic == 0xd4c3b2a1 || magic == 0x4d3cb2a1;
+  const bool nanoseconds = magic == 0xa1b23c4d || magic == 0x4d3cb2a1;
+  summary.format = "pcap";
+  // The top bits of the link type may carry FCS information.
+  summary.link_type = load32(file.data() + 20, swap) & 0x0fff'ffff;
+  std::size_t position = 24;
+  while (position + 16 <= file.size()) {
+    const auto *record = file.data() + position;
+    const auto captured = load32(record + 8, swap);
+    if (captured > file.size() - position - 16) return false;
+    ++summary.records;
+    const auto capture_ns = load32(record, swap) * 1'000'000'000ULL +
+        load32(record + 4, swap) * (nanoseconds ? 1ULL : 1'000ULL);
+    if (const auto bytes = udp_payload_bytes(summary.link_type, record + 16, captured))
+      packets.push_back({capture_ns, *bytes});
+    else
+      ++summary.skipped_records;
+    position += 16 + captured;
+  }
+  return position == file.size();
+}
+
+// if_tsresol: 10^-exponent seconds per tick, or 2^-exponent with the top bit set.
+inline std::uint64_t pcapng_ns(std::uint64_t ticks, std::uint8_t resolution) noexcept {
+  const unsigned exponent = resolution & 0x7f;
+  if (resolution & 0x80)
+    return static_cast<std::uint64_t>((static_cast<uint128>(ticks) * 1'000'000'000ULL) >> exponent);
+  std::uint64_t scale = 1;
+  if (exponent <= 9) {
+    for (unsigned step = exponent; step < 9; ++step) scale *= 10;
+    return ticks * scale;
+  }
+  if (exponent > 27) return 0;  // the divisor would overflow
+  for (unsigned step = 9; step < exponent; ++step) scale *= 10;
+  return ticks / scale;
+}
+
+inline bool read_pcapng(std::span<const std::byte> file, std::vector<ReplayPacket> &packets,
+                        CaptureSummary &summary) {
+  constexpr std::uint32_t section_header = 0x0a0d0d0a, interface_description = 1,
+      packet_block = 2, simple_packet = 3, enhanced_packet = 6;
+  struct Interface {
+    std::uint32_t link_type;
+    std::uint8_t resolution;
+  };
+  std::vector<Interface> interfaces;
+  bool swap = false;
+  bool have_link_type = false;
+  summary.format = "pcapng";
+  std::size_t position = 0;
+  while (position + 12 <= file.size()) {
+    const auto *block = file.data() + position;
+    const auto type = load32(block, swap);
+    if (type == section_header) {
+      const auto order = load32(block + 8, false);
+      if (order != 0x1a2b3c4d && order != 0x4d3c2b1a) return false;
+      swap = order == 0x4d3c2b1a;
+      interfaces.clear();
+    }
+    const auto total = load32(block + 4, swap);
+    if (total < 12 || total % 4 || total > file.size() - position) return false;
+    const auto *body_end = block + total - 4;
+    if (type == interface_description && total >= 20) {
+      Interface interface{.link_type = load16(block + 8, swap), .resolution = 6};
+      for (const auto *option = block + 16; option + 4 <= body_end;) {
+        const auto code = load16(option, swap), size = load16(option + 2, swap);
+        if (code == 0 || option + 4 + size > body_end) break;
+        if (code == 9 && size >= 1) interface.resolution = std::to_integer<std::uint8_t>(option[4]);
+        option += 4 + ((size + 3U) & ~3U);
+      }
+      interfaces.push_back(interface);
+      if (!have_link_type) { summary.link_type = interface.link_type; have_link_type = true; }
+    } else if ((type == enhanced_packet || type == packet_block) && total >= 32) {
+      ++summary.records;
+      // The obsolete Packet Block has a 16-bit interface id followed by a drop count.
+      const auto id = type == packet_block ? load16(block + 8, swap) : load32(block + 8, swap);
+      const auto captured = load32(block + 20, swap);
+      const auto ticks = (static_cast<std::uint64_t>(load32(block + 12, swap)) << 32) |
+                         load32(block + 16, swap);
+      std::optional<std::uint32_t> bytes;
+      if (id < interfaces.size() && captured <= total - 32)
+        bytes = udp_payload_bytes(interfaces[id].link_type, block + 28, captured);
+      if (bytes) packets.push_back({pcapng_ns(ticks, interfaces[id].resolution), *bytes});
+      else ++summary.skipped_records;
+    } else if (type == simple_packet) {
+      ++summary.records;
+      ++summary.skipped_records;  // carries no timestamp
+    }
+    position += total;
+  }
+  return position == file.size();
+}
+
+} // namespace detail
+
+// Reads every UDP datagram of a pcap or pcapng capture, in file order. The
+// file is memory-mapped for the one pass and unmapped before returning.
+// Reports the problem on stderr and returns false on an unreadable file.
+inline bool read_capture(const std::string &path, std::vector<ReplayPacket> &packets,
+                         CaptureSummary &summary) {
+  packets.clear();
+  summary = {};
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat status {};
+  if (fd < 0 || ::fstat(fd, &status) != 0) {
+    std::fprintf(stderr, "Cannot open capture %s: %s\n", path.c_str(), std::strerror(errno));
+    if (fd >= 0) ::close(fd);
+    return false;
+  }
+  const auto size = static_cast<std::size_t>(status.st_size);
+  void *mapping = size >= 4 ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  const int map_error = errno;
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    std::fprintf(stderr, "Cannot map capture %s: %s\n", path.c_str(),
+                 size < 4 ? "file too short" : std::strerror(map_error));
+    return false;
+  }
+  ::madvise(mapping, size, MADV_SEQUENTIAL);
+  const std::span file(static_cast<const std::byte *>(mapping), size);
+  const auto magic = detail::load32(file.data(), false);
+  bool ok = false;
+  if (magic == 0x0a0d0d0a) {
+    ok = detail::read_pcapng(file, packets, summary);
+  } else if (magic == 0xa1b2c3d4 || magic == 0xd4c3b2a1 || magic == 0xa1b23c4d || magic == 0x4d3cb2a1) {
+    ok = detail::read_pcap(file, packets, summary);
+  } else {
+    ::munmap(mapping, size);
+    std::fprintf(stderr, "%s: not a pcap or pcapng file\n", path.c_str());
+    return false;
+  }
+  ::munmap(mapping, size);
+  if (!ok) std::fprintf(stderr, "%s: truncated or malformed %s file\n", path.c_str(), summary.format);
+  return ok;
+}
+
+// A capture compiled into deadlines and payload sizes for the send loop.
+//
+// Packet i keeps the i-th datagram's gap from the first one, divided by the
+// speed-up, and its UDP payload size, raised to minimum_payload so the header
+// still fits and capped at the largest IPv4 UDP payload. Captures merged from
+// several interfaces can step back in time; such a packet is sent with its
+// predecessor. With loop the trace repeats every loop_period_ns(): its span
+// plus one mean gap, so the seam looks like any other gap. Either way the run
+// ends at --duration.
+class ReplaySchedule {
+public:
+  static constexpr std::uint32_t max_payload_bytes = 65507;
+
+  ReplaySchedule() = default;
+  ReplaySchedule(std::span<const ReplayPacket> packets, double speed, bool loop,
+                 std::uint64_t duration_ns, std::uint32_t minimum_payload) {
+    if (packets.empty() || speed <= 0.0 || duration_ns == 0) return;
+    offsets_ns_.reserve(packets.size());
+    sizes_.reserve(packets.size());
+    const auto first = packets.front().capture_ns;
+    std::uint64_t previous = 0;
+    for (const auto &packet : packets) {
+      auto gap = packet.capture_ns > first ? packet.capture_ns - first : 0;
+      if (gap < previous) { ++reordered_; gap = previous; }
+      previous = gap;
+      offsets_ns_.push_back(static_cast<std::uint64_t>(std::llround(static_cast<double>(gap) / speed)));
+      auto size = packet.payload_bytes;
+      if (size < minimum_payload) { ++padded_; size = minimum_payload; }
+      if (size > max_payload_bytes) { ++clipped_; size = max_payload_bytes; }
+      sizes_.push_back(static_cast<std::uint16_t>(size));
+      largest_payload_ = std::max(largest_payload_, size);
+    }
+    const auto span = offsets_ns_.back();
+    const auto trace_packets = offsets_ns_.size();
+    if (loop) period_ns_ = span + (trace_packets > 1 ? span / (trace_packets - 1) : 0);
+    // Without a period there is no second pass; one pass is still scheduled.
+    const auto in_pass = [&](std::uint64_t limit_ns) {
+      return static_cast<std::uint64_t>(
+          std::lower_bound(offsets_ns_.begin(), offsets_ns_.end(), limit_ns) - offsets_ns_.begin());
+    };
+    packet_count_ = period_ns_ ? duration_ns / period_ns_ * trace_packets + in_pass(duration_ns % period_ns_)
+                               : in_pass(duration_ns);
+    const auto active_ns = period_ns_ ? period_ns_ : span;
+    if (active_ns) mean_rate_pps_ = static_cast<std::uint64_t>(
+        static_cast<uint128>(trace_packets) * 1'000'000'000ULL / active_ns);
+    // Busiest millisecond of one pass: the burst the receiver has to absorb.
+    std::size_t window_start = 0;
+    for (std::size_t index = 0; index < trace_packets; ++index) {
+      while (offsets_ns_[index] - offsets_ns_[window_start] >= 1'000'000) ++window_start;
+      peak_rate_pps_ = std::max<std::uint64_t>(peak_rate_pps_, (index - window_start + 1) * 1000ULL);
+    }
+  }
+
+  [[nodiscard]] bool empty() const noexcept { return packet_count_ == 0; }
+  [[nodiscard]] std::uint64_t packet_count() const noexcept { return packet_count_; }
+  [[nodiscard]] std::size_t trace_packets() const noexcept { return offsets_ns_.size(); }
+  [[nodiscard]] std::uint64_t loop_period_ns() const noexcept { return period_ns_; }
+  [[nodiscard]] std::uint64_t mean_rate_pps() const noexcept { return mean_rate_pps_; }
+  [[nodiscard]] std::uint64_t peak_rate_pps() const noexcept { return peak_rate_pps_; }
+  [[nodiscard]] std::uint32_t largest_payload() const noexcept { return largest_payload_; }
+  [[nodiscard]] std::uint64_t padded() const noexcept { return padded_; }
+  [[nodiscard]] std::uint64_t clipped() const noexcept { return clipped_; }
+  [[nodiscard]] std::uint64_t reordered() const noexcept { return reordered_; }
+
+  // Deadline of packet index, as an offset from the run start. The division
+  // is only paid once the trace has started to repeat.
+  [[nodiscard]] std::uint64_t offset_ns(std::uint64_t index) const noexcept {
+    if (index < offsets_ns_.size()) return offsets_ns_[index];
+    return index / offsets_ns_.size() * period_ns_ + offsets_ns_[index % offsets_ns_.size()];
+  }
+
+  [[nodiscard]] std::uint32_t payload_bytes(std::uint64_t index) const noexcept {
+    return sizes_[index < sizes_.size() ? index : index % sizes_.size()];
+  }
+
+  // adaptive_batch_count() on this schedule: packets first, first + stride, ...
+  // whose deadlines fall within batch_window_ns of the first.
+  [[nodiscard]] std::uint32_t batch_count(std::uint64_t first_packet_index, std::uint64_t packet_stride,
+                                          std::uint32_t batch_max,
+                                          std::uint64_t batch_window_ns) const noexcept {
+    if (first_packet_index >= packet_count_ || packet_stride == 0 || batch_max == 0) return 0;
+    const auto first_offset = offset_ns(first_packet_index);
+    std::uint32_t count = 1;
+    while (count < batch_max) {
+      const auto index = first_packet_index + static_cast<std::uint64_t>(count) * packet_stride;
+      if (index >= packet_count_ || offset_ns(index) - first_offset > batch_window_ns) break;
+      ++count;
+    }
+    return count;
+  }
+
+private:
+  std::vector<std::uint64_t> offsets_ns_;
+  std::vector<std::uint16_t> sizes_;
+  std::uint64_t packet_count_ = 0;
+  std::uint64_t period_ns_ = 0;
+  std::uint64_t mean_rate_pps_ = 0;
+  std::uint64_t peak_rate_pps_ = 0;
+  std::uint32_t largest_payload_ = 0;
+  std::uint64_t padded_ = 0;
+  std::uint64_t clipped_ = 0;
+  std::uint64_t reordered_ = 0;
+};
+
+} // namespace nll::sender
@@ -0,0 +1,219 @@
+#pragma once
+
+#include "sender/sender_common.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <numbers>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace nll::sender {
+
+// One breakpoint of a --rate-profile: the rate is linear between breakpoints,
+// held before the first and after the last, and two breakpoints at one time
+// make a step.
+struct RatePoint {
+  double seconds = 0.0;
+  double rate_pps = 0.0;
+};
+
+namespace detail {
+
+inline bool parse_number(std::string_view text, double &value) noexcept {
+  const auto *last = text.data() + text.size();
+  const auto [end, error] = std::from_chars(text.data(), last, value);
+  return error == std::errc{} && end == last && std::isfinite(value) && value >= 0.0;
+}
+
+// Splits "a:b:c" into exactly count fields.
+inline bool split_fields(std::string_view text, std::size_t count, std::vector<double> &fields) {
+  fields.clear();
+  while (true) {
+    const auto colon = text.find(':');
+    double value = 0.0;
+    if (!parse_number(text.substr(0, colon), value)) return false;
+    fields.push_back(value);
+    if (colon == std::string_view::npos) break;
+    text.remove_prefix(colon + 1);
+  }
+  return fields.size() == count;
+}
+
+inline bool read_profile_file(const std::string &path, std::vector<RatePoint> &points) {
+  std::ifstream input(path);
+  if (!input) { std::fprintf(stderr, "Cannot open rate profile: %s\n", path.c_str()); return false; }
+  std::string line;
+  for (std::size_t number = 1; std::getline(input, line); ++number) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty() || line.front() == '#') continue;
+    const auto comma = line.find(',');
+    RatePoint point;
+    if (comma == std::string::npos ||
+        !parse_number(std::string_view(line).substr(0, comma), point.seconds) ||
+        !parse_number(std::string_view(line).substr(comma + 1), point.rate_pps)) {
+      // A header row is allowed before the first breakpoint.
+      if (points.empty() && number == 1) continue;
+      std::fprintf(stderr, "%s:%zu: expected seconds,rate_pps\n", path.c_str(), number);
+      return false;
+    }
+    if (!points.empty() && point.seconds < points.back().seconds) {
+      std::fprintf(stderr, "%s:%zu: breakpoints must not go back in time\n", path.c_str(), number);
+      return false;
+    }
+    points.push_back(point);
+  }
+  if (points.empty()) { std::fprintf(stderr, "%s: no breakpoints\n", path.c_str()); return false; }
+  return true;
+}
+
+} // namespace detail
+
+// --rate-profile SPEC, one of
+//   ramp:FROM:TO                  linear from FROM to TO pps over --duration
+//   step:FROM:TO:AT               FROM pps, then TO pps from AT seconds on
+//   sine:MEAN:AMPLITUDE:PERIOD    MEAN + AMPLITUDE * sin(2 pi t / PERIOD)
+//   file:PATH                     CSV of seconds,rate_pps breakpoints
+// Reports the problem on stderr and returns false on a malformed spec.
+inline bool parse_rate_profile(std::string_view spec, double duration_seconds,
+                               std::vector<RatePoint> &points) {
+  points.clear();
+  const auto colon = spec.find(':');
+  const auto shape = spec.substr(0, colon);
+  const auto arguments = colon == std::string_view::npos ? std::string_view{} : spec.substr(colon + 1);
+  std::vector<double> fields;
+  if (shape == "file" && !arguments.empty())
+    return detail::read_profile_file(std::string(arguments), points);
+  if (shape == "ramp" && detail::split_fields(arguments, 2, fields)) {
+    points = {{0.0, fields[0]}, {duration_seconds, fields[1]}};
+    return true;
+  }
+  if (shape == "step" && detail::split_fields(arguments, 3, fields)) {
+    points = {{0.0, fields[0]}, {fields[2], fields[0]}, {fields[2], fields[1]}};
+    return true;
+  }
+  if (shape == "sine" && detail::split_fields(arguments, 3, fields) && fields[2] > 0.0) {
+    if (fields[1] > fields[0]) {
+      std::fprintf(stderr, "Rate profile sine amplitude exceeds its mean\n");
+      return false;
+    }
+    // 64 linear pieces per period keep the integral within 0.1% of the sine.
+    const double step = fields[2] / 64;
+    for (double seconds = 0.0; seconds < duration_seconds + step; seconds += step)
+      points.push_back({seconds, fields[0] + fields[1] * std::sin(2 * std::numbers::pi * seconds / fields[2])});
+    return true;
+  }
+  std::fprintf(stderr, "Invalid rate profile: %.*s\n", static_cast<int>(spec.size()), spec.data());
+  return false;
+}
+
+// A rate profile compiled into constant-rate segments for the send loop.
+//
+// The profile is integrated exactly over each segment of resolution_ns, and
+// the segment sends the whole number of packets the integral rounds to at the
+// matching constant rate. Packet deadlines are then the segment start plus the
+// index times a 32.32 fixed-point interval: a multiply and a shift, where the
+// constant-rate deadline_ns() pays a 128-bit division per call. Each worker
+// walks the segments with its own cursor; its indices only move forward, so
+// a lookup is almost always the segment it used last.
+class RateSchedule {
+public:
+  static constexpr std::uint64_t default_resolution_ns = 1'000'000;
+
+  struct Segment {
+    std::uint64_t start_ns = 0;  // from the run start
+    std::uint64_t first_packet = 0;
+    std::uint64_t interval_q32 = 0;  // ns per packet, times 2^32
+    std::uint64_t rate_pps = 0;
+  };
+
+  RateSchedule() = default;
+  RateSchedule(std::span<const RatePoint> points, std::uint64_t duration_ns,
+               std::uint64_t resolution_ns = default_resolution_ns) {
+    if (points.empty() || duration_ns == 0) return;
+    // Segments stay bounded for long runs: at most 2^20 of them.
+    resolution_ns = std::max(resolution_ns, (duration_ns >> 20) + 1);
+    std::vector<RatePoint> knots(points.begin(), points.end());
+    if (knots.front().seconds > 0.0) knots.insert(knots.begin(), {0.0, knots.front().rate_pps});
+    std::size_t piece = 0;
+    double before_piece = 0.0;  // packets scheduled before knots[piece]
+    // Packets scheduled in [0, t); t only moves forward.
+    const auto cumulative = [&](double t) {
+      while (piece + 1 < knots.size() && knots[piece + 1].seconds <= t) {
+        const auto &left = knots[piece], &right = knots[piece + 1];
+        before_piece += (right.seconds - left.seconds) * (left.rate_pps + right.rate_pps) / 2;
+        ++piece;
+      }
+      const auto &left = knots[piece];
+      if (piece + 1 == knots.size()) return before_piece + (t - left.seconds) * left.rate_pps;
+      const auto &right = knots[piece + 1];
+      const double rate = left.rate_pps + (right.rate_pps - left.rate_pps) *
+          (t - left.seconds) / (right.seconds - left.seconds);
+      return before_piece + (t - left.seconds) * (left.rate_pps + rate) / 2;
+    };
+    std::uint64_t scheduled = 0;
+    for (std::uint64_t start = 0; start < duration_ns; start += resolution_ns) {
+      const auto end = std::min(duration_ns, start + resolution_ns);
+      const auto next = static_cast<std::uint64_t>(std::llround(cumulative(static_cast<double>(end) / 1e9)));
+      if (next <= scheduled) continue;
+      const auto count = next - scheduled;
+      segments_.push_back({.start_ns = start, .first_packet = scheduled,
+          .interval_q32 = static_cast<std::uint64_t>((static_cast<uint128>(end - start) << 32) / count),
+          .rate_pps = static_cast<std::uint64_t>(static_cast<uint128>(count) * 1'000'000'000ULL /
+                                                 (end - start))});
+      peak_rate_pps_ = std::max(peak_rate_pps_, segments_.back().rate_pps);
+      scheduled = next;
+    }
+    packet_count_ = scheduled;
+  }
+
+  [[nodiscard]] bool empty() const noexcept { return segments_.empty(); }
+  [[nodiscard]] std::uint64_t packet_count() const noexcept { return packet_count_; }
+  [[nodiscard]] std::uint64_t peak_rate_pps() const noexcept { return peak_rate_pps_; }
+  [[nodiscard]] std::span<const Segment> segments() const noexcept { return segments_; }
+
+  // Deadline of packet index, as an offset from the run start; moves cursor
+  // to the segment holding it.
+  std::uint64_t offset_ns(std::uint64_t index, std::size_t &cursor) const noexcept {
+    while (cursor + 1 < segments_.size() && index >= segments_[cursor + 1].first_packet) ++cursor;
+    while (cursor > 0 && index < segments_[cursor].first_packet) --cursor;
+    const auto &segment = segments_[cursor];
+    return segment.start_ns + static_cast<std::uint64_t>(
+        (static_cast<uint128>(index - segment.first_packet) * segment.interval_q32) >> 32);
+  }
+
+  [[nodiscard]] std::uint64_t rate_pps(std::size_t cursor) const noexcept {
+    return segments_[cursor].rate_pps;
+  }
+
+  // adaptive_batch_count() on this schedule: packets first, first + stride, ...
+  // whose deadlines fall within batch_window_ns of the first.
+  std::uint32_t batch_count(std::uint64_t first_packet_index, std::uint64_t packet_stride,
+                            std::uint32_t batch_max, std::uint64_t batch_window_ns,
+                            std::size_t &cursor) const noexcept {
+    if (first_packet_index >= packet_count_ || packet_stride == 0 || batch_max == 0) return 0;
+    const auto first_offset = offset_ns(first_packet_index, cursor);
+    auto probe = cursor;
+    std::uint32_t count = 1;
+    while (count < batch_max) {
+      const auto index = first_packet_index + static_cast<std::uint64_t>(count) * packet_stride;
+      if (index >= packet_count_ || offset_ns(index, probe) - first_offset > batch_window_ns) break;
+      ++count;
+    }
+    return count;
+  }
+
+private:
+  std::vector<Segment> segments_;
+  std::uint64_t packet_count_ = 0;
+  std::uint64_t peak_rate_pps_ = 0;
+};
+
+} // namespace nll::sender
@@ -1,7 +1,18 @@
+#include "common/arena.hpp"
+#include "common/control_protocol.hpp"
+#include "common/crc32c.hpp"
+#include "common/log.hpp"
 #include "common/packet.hpp"
+#include "common/perf_counters.hpp"
+#include "common/telemetry.hpp"
 #include "common/thread_utils.hpp"
 #include "common/time.hpp"
+#include "sender/capacity_search.hpp"
+#include "sender/clock_probe.hpp"
+#include "sender/pcap_replay.hpp"
+#include "sender/rate_profile.hpp"
 #include "sender/sender_common.hpp"
+#include "sender/tx_timestamps.hpp"
 
 #include <arpa/inet.h>
 #include <atomic>
@@ -17,6 +28,7 @@
 #include <getopt.h>
 #include <limits>
 #include <numeric>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <sys/socket.h>
@@ -50,6 +62,30 @@ struct Config {
   std::vector<int> cpus;
   std::filesystem::path stats_path = "sender_stats.json";
   std::filesystem::path pacing_trace_path;
+  bool telemetry = false;
+  nll::ClockSource clock = nll::ClockSource::system;
+  bool perf_counters = false;
+  bool payload_pattern = false;
+  std::uint64_t pattern_seed = 0;
+  std::filesystem::path tx_timestamps_path;
+  nll::memory::PagePolicy page_policy = nll::memory::PagePolicy::automatic;
+  std::uint32_t flows = 0;  // 0: one socket per worker on an ephemeral port
+  std::uint16_t source_port_base = 40000;
+  bool flow_tag = false;
+  std::uint8_t header_version = nll::message_version_v1;
+  bool capacity_search = false;
+  std::uint16_t control_port = 0;
+  std::uint64_t search_min_pps = 1000;
+  double search_loss = 0.0;
+  double search_precision = 0.01;
+  std::string rate_profile;  // --rate-profile as given; empty: constant --rate
+  nll::sender::RateSchedule rate_schedule;  // compiled from it in main
+  std::string replay_path;  // --replay capture; empty: synthetic schedule
+  double replay_speed = 1.0;
+  bool replay_loop = false;
+  nll::sender::CaptureSummary replay_capture;
+  nll::sender::ReplaySchedule replay_schedule;  // compiled from it in main
+  std::uint32_t clock_sync_hz = 0;  // 0: no clock probes
 };
 
 struct TraceRecord {
@@ -58,6 +94,19 @@ struct TraceRecord {
   std::uint64_t first_sequence;
   std::uint32_t packet_count;
   std::uint32_t thread_index;
+  std::uint64_t scheduled_rate_pps;
+};
+
+// One socket: a --flows flow, or the worker's only socket without --flows.
+struct FlowStats {
+  std::uint32_t flow = 0;
+  std::uint16_t source_port = 0;  // 0: ephemeral
+  std::uint32_t tx_socket = 0;    // index in the TX timestamp collector
+  std::uint64_t successful_sends = 0;
+  std::uint64_t failed_sends = 0;
+  std::uint32_t next_flow_sequence = 0;  // written into the flow_tag
+  // Indexed by the socket's SO_TIMESTAMPING OPT_ID key.
+  std::vector<nll::sender::TxSubmission> tx_submissions;
 };
 
 struct WorkerStats {
@@ -78,11 +127,21 @@ struct WorkerStats {
   std::vector<std::uint64_t> batch_histogram;
   std::vector<std::uint64_t> lateness_ns;
   std::vector<TraceRecord> trace;
+  std::vector<FlowStats> flows;
+  nll::perf::Reading counters;
+  nll::memory::ArenaReport arena;
+  // This worker's thread, over the send loop.
+  nll::memory::PageFaults page_faults;
 };
 
 struct Stats : WorkerStats {
   std::uint64_t elapsed_ns = 0;
   int requested_socket_buffer_bytes = 0;
+  std::string telemetry_page;
+  std::uint64_t log_messages_dropped = 0;
+  nll::sender::TxLogSummary tx_log;
+  std::uint64_t tx_other_errors = 0;
+  nll::sender::ClockProber::Report clock_sync;
 };
 
 template <typename T>
@@ -116,6 +175,22 @@ bool parse_duration(std::string_view text, double &value) {
   return true;
 }
 
+// A fraction in [min, max], for the capacity search's loss and precision.
+bool parse_ratio(std::string_view text, double min, double max, double &value,
+                 const char *name) {
+  std::string copy(text);
+  char *end = nullptr;
+  errno = 0;
+  const double parsed = std::strtod(copy.c_str(), &end);
+  if (errno != 0 || copy.empty() || end != copy.c_str() + copy.size() ||
+      !std::isfinite(parsed) || parsed < min || parsed > max) {
+    std::fprintf(stderr, "Invalid %s: %s\n", name, copy.c_str());
+    return false;
+  }
+  value = parsed;
+  return true;
+}
+
 bool parse_cpu(std::string_view text, int &cpu) {
   const auto result = std::from_chars(text.data(), text.data() + text.size(), cpu);
   return !text.empty() && result.ec == std::errc{} &&
@@ -182,13 +257,15 @@ bool write_trace(const Config &config, const std::vector<WorkerStats> &workers)
     std::fprintf(stderr, "Cannot open pacing trace: %s\n", std::strerror(errno));
     return false;
   }
-  std::fprintf(file, "actual_mono_ns,scheduled_mono_ns,first_sequence,packet_count,thread_index\n");
+  std::fprintf(file, "actual_mono_ns,scheduled_mono_ns,first_sequence,packet_count,thread_index,"
+               "scheduled_rate_pps\n");
   for (const auto &record : records)
-    std::fprintf(file, "%llu,%llu,%llu,%u,%u\n",
+    std::fprintf(file, "%llu,%llu,%llu,%u,%u,%llu\n",
         static_cast<unsigned long long>(record.actual_mono_ns),
         static_cast<unsigned long long>(record.scheduled_mono_ns),
         static_cast<unsigned long long>(record.first_sequence),
-        record.packet_count, record.thread_index);
+        record.packet_count, record.thread_index,
+        static_cast<unsigned long long>(record.scheduled_rate_pps));
   return std::fclose(file) == 0;
 }
 
@@ -246,7 +323,7 @@ bool write_stats(const Config &config, Stats stats,
       "  \"requested_socket_buffer_bytes\": %d,\n"
       "  \"observed_socket_buffer_bytes\": %d,\n"
       "  \"pacing_lateness_ns\": {\"samples\": %llu, \"mean\": %.3f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"max\": %llu},\n"
-      "  \"pacing_trace\": {\"enabled\": %s, \"path\": \"%s\", \"format\": \"csv-v1\", \"records\": %zu},\n",
+      "  \"pacing_trace\": {\"enabled\": %s, \"path\": \"%s\", \"format\": \"csv-v2\", \"records\": %zu},\n",
       escape(config.destination).c_str(), config.port,
       static_cast<unsigned long long>(config.rate_pps), config.duration_seconds,
       config.mode.c_str(), static_cast<unsigned long long>(config.burst_size),
@@ -271,6 +348,87 @@ bool write_stats(const Config &config, Stats stats,
       static_cast<unsigned long long>(stats.lateness_max_ns),
       config.pacing_trace_path.empty() ? "false" : "true",
       escape(config.pacing_trace_path.string()).c_str(), stats.trace.size());
+  std::fprintf(file, "  \"telemetry_page\": \"%s\",\n", escape(stats.telemetry_page).c_str());
+  std::fprintf(file, "  \"log_messages_dropped\": %llu,\n",
+               static_cast<unsigned long long>(stats.log_messages_dropped));
+  std::fprintf(file, "  \"timestamp_clock\": {\"source\": \"%s\", \"frequency_hz\": %.1f, "
+      "\"resolution_ns\": %.3f, \"reanchors\": %llu, \"max_correction_ns\": %llu},\n",
+      nll::clock_source_name(nll::timestamp_source), nll::timestamp_clock.frequency_hz(),
+      nll::timestamp_clock.resolution_ns(),
+      static_cast<unsigned long long>(nll::timestamp_clock.reanchors()),
+      static_cast<unsigned long long>(nll::timestamp_clock.max_correction_ns()));
+  std::fprintf(file, "  \"perf_counters\": {\"enabled\": %s, \"send_loop\": ",
+               config.perf_counters ? "true" : "false");
+  nll::perf::write_json(file, stats.counters, stats.attempted_sends);
+  std::fprintf(file, "},\n");
+  nll::memory::write_json(file, stats.arena, stats.page_faults);
+  std::fprintf(file, "  \"payload_pattern\": {\"enabled\": %s, \"seed\": %llu, "
+      "\"crc\": \"crc32c\", \"implementation\": \"%s\"},\n",
+      config.payload_pattern ? "true" : "false",
+      static_cast<unsigned long long>(config.pattern_seed), nll::crc32c_implementation());
+  std::fprintf(file, "  \"tx_timestamps\": {\"enabled\": %s, \"path\": \"%s\", "
+      "\"format\": \"csv-v1\", \"records\": %llu, \"sched_stamps\": %llu, "
+      "\"software_stamps\": %llu, \"unmatched_stamps\": %llu, \"other_errors\": %llu},\n",
+      config.tx_timestamps_path.empty() ? "false" : "true",
+      escape(config.tx_timestamps_path.string()).c_str(),
+      static_cast<unsigned long long>(stats.tx_log.records),
+      static_cast<unsigned long long>(stats.tx_log.sched_stamps),
+      static_cast<unsigned long long>(stats.tx_log.software_stamps),
+      static_cast<unsigned long long>(stats.tx_log.unmatched_stamps),
+      static_cast<unsigned long long>(stats.tx_other_errors));
+  std::fprintf(file, "  \"header_version\": %u,\n", config.header_version);
+  std::fprintf(file, "  \"rate_profile\": {\"enabled\": %s, \"spec\": \"%s\", \"segments\": %zu, "
+      "\"planned_packets\": %llu, \"peak_rate_pps\": %llu},\n",
+      config.rate_profile.empty() ? "false" : "true", escape(config.rate_profile).c_str(),
+      config.rate_schedule.segments().size(),
+      static_cast<unsigned long long>(config.rate_schedule.packet_count()),
+      static_cast<unsigned long long>(config.rate_schedule.peak_rate_pps()));
+  const auto &replay = config.replay_schedule;
+  std::fprintf(file, "  \"replay\": {\"enabled\": %s, \"path\": \"%s\", \"format\": \"%s\", "
+      "\"link_type\": %u, \"records\": %llu, \"skipped_records\": %llu, \"trace_packets\": %zu, "
+      "\"speed\": %.6g, \"loop\": %s, \"loop_period_ns\": %llu, \"planned_packets\": %llu, "
+      "\"mean_rate_pps\": %llu, \"peak_rate_pps\": %llu, \"padded_packets\": %llu, "
+      "\"clipped_packets\": %llu, \"reordered_packets\": %llu},\n",
+      config.replay_path.empty() ? "false" : "true", escape(config.replay_path).c_str(),
+      config.replay_capture.format, config.replay_capture.link_type,
+      static_cast<unsigned long long>(config.replay_capture.records),
+      static_cast<unsigned long long>(config.replay_capture.skipped_records),
+      replay.trace_packets(), config.replay_speed, config.replay_loop ? "true" : "false",
+      static_cast<unsigned long long>(replay.loop_period_ns()),
+      static_cast<unsigned long long>(replay.packet_count()),
+      static_cast<unsigned long long>(replay.mean_rate_pps()),
+      static_cast<unsigned long long>(replay.peak_rate_pps()),
+      static_cast<unsigned long long>(replay.padded()),
+      static_cast<unsigned long long>(replay.clipped()),
+      static_cast<unsigned long long>(replay.reordered()));
+  const auto &clock = stats.clock_sync.estimator;
+  std::fprintf(file, "  \"clock_sync\": {\"enabled\": %s, \"rate_hz\": %u, \"probes\": %llu, "
+      "\"replies\": %llu, \"stale_replies\": %llu, \"rounds\": %llu, \"min_delay_ns\": %llu, "
+      "\"offset_ns\": %lld, \"drift_ppb\": %.3f},\n",
+      config.clock_sync_hz ? "true" : "false", config.clock_sync_hz,
+      static_cast<unsigned long long>(stats.clock_sync.probes),
+      static_cast<unsigned long long>(stats.clock_sync.replies),
+      static_cast<unsigned long long>(stats.clock_sync.stale_replies),
+      static_cast<unsigned long long>(clock.samples()),
+      static_cast<unsigned long long>(clock.minimum_delay_ns()),
+      static_cast<long long>(clock.estimate().offset_ns), clock.estimate().drift_ppb);
+  std::fprintf(file, "  \"flows\": {\"count\": %u, \"source_port_base\": %u, \"flow_tag\": %s, "
+      "\"per_flow\": [", config.flows, config.flows ? config.source_port_base : 0U,
+      config.flow_tag ? "true" : "false");
+  if (config.flows) {
+    bool first_flow = true;
+    for (std::size_t index = 0; index < workers.size(); ++index)
+      for (const auto &flow : workers[index].flows) {
+        std::fprintf(file, "%s\n    {\"flow\": %u, \"thread_index\": %zu, \"source_port\": %u, "
+            "\"successful_sends\": %llu, \"failed_sends\": %llu}", first_flow ? "" : ",",
+            flow.flow, index, flow.source_port,
+            static_cast<unsigned long long>(flow.successful_sends),
+            static_cast<unsigned long long>(flow.failed_sends));
+        first_flow = false;
+      }
+    std::fprintf(file, "\n  ");
+  }
+  std::fprintf(file, "]},\n");
   std::fprintf(file, "  \"effective_batch_size_histogram\": {");
   bool first = true;
   for (std::size_t size = 1; size < stats.batch_histogram.size(); ++size) {
@@ -324,13 +482,49 @@ void usage(std::FILE *out) {
       "      --threads N            phase-staggered sender workers, 1..128\n"
       "      --cpus LIST            comma-separated worker CPU list\n"
       "      --pacing-trace PATH    buffered syscall pacing CSV\n"
+      "      --telemetry            publish live counters at /dev/shm/nll-<pid>\n"
+      "      --clock SOURCE         timestamp clock: system or cycles (default system)\n"
+      "      --perf-counters        count cycles, instructions and misses in the send loop\n"
+      "      --payload-pattern SEED fill payloads from SEED and append a CRC32C trailer\n"
+      "      --tx-timestamps PATH   per-packet kernel SCHED/SOFTWARE transmit stamps CSV\n"
+      "      --hugepages POLICY     buffer pages: auto, hugetlb, thp, or normal (default auto)\n"
+      "      --flows N              N sockets on fixed source ports, spread over workers\n"
+      "      --source-port BASE     first flow source port (default 40000)\n"
+      "      --flow-tag             append the flow id after the header (needs --flows)\n"
+      "      --header-version V     1, or 2 to also send each datagram's scheduled time\n"
+      "      --rate-profile SPEC    steady-mode rate over time instead of --rate:\n"
+      "                             ramp:FROM:TO, step:FROM:TO:AT_S,\n"
+      "                             sine:MEAN:AMPLITUDE:PERIOD_S, or file:CSV (s,pps rows)\n"
+      "      --replay PATH          steady-mode sizes and gaps of the UDP datagrams in a\n"
+      "                             pcap/pcapng capture, instead of --rate and --payload-size\n"
+      "      --replay-speed X       divide the captured gaps by X (default 1)\n"
+      "      --replay-loop          repeat the capture until --duration\n"
+      "      --clock-sync HZ        probe receiver clock offset/drift HZ times a second, 1..1000\n"
+      "      --capacity-search      bisect --rate down to the zero-loss rate, one\n"
+      "                             --duration trial per step (needs --control)\n"
+      "      --control PORT         receiver control port for --capacity-search\n"
+      "      --search-min PPS       lowest rate to try (default 1000)\n"
+      "      --search-loss RATIO    tolerated loss per trial, 0..1 (default 0)\n"
+      "      --search-precision R   stop when bounds are within R of the rate (default 0.01)\n"
       "  -h, --help                 show this help\n");
 }
 
 int connected_socket(const Config &config, WorkerStats &stats,
-                     const sockaddr_in &destination) {
+                     const sockaddr_in &destination, std::uint16_t source_port) {
   const int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
   if (fd < 0) { stats.last_error = errno; return -1; }
+  if (source_port) {
+    sockaddr_in source{};
+    source.sin_family = AF_INET;
+    source.sin_port = htons(source_port);
+    source.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (::bind(fd, reinterpret_cast<const sockaddr *>(&source), sizeof(source)) < 0) {
+      stats.last_error = errno;
+      std::fprintf(stderr, "Cannot bind source port %u: %s\n", source_port, std::strerror(errno));
+      ::close(fd);
+      return -1;
+    }
+  }
   if (config.socket_buffer_bytes > 0 &&
       ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &config.socket_buffer_bytes,
                    sizeof(config.socket_buffer_bytes)) < 0)
@@ -342,6 +536,7 @@ int connected_socket(const Config &config, WorkerStats &stats,
   const int recverr = 1;
   if (::setsockopt(fd, IPPROTO_IP, IP_RECVERR, &recverr, sizeof(recverr)) < 0)
     std::fprintf(stderr, "IP_RECVERR request failed: %s\n", std::strerror(errno));
+  if (!config.tx_timestamps_path.empty()) nll::sender::enable_tx_timestamps(fd);
   socklen_t length = sizeof(stats.observed_socket_buffer_bytes);
   if (::getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &stats.observed_socket_buffer_bytes,
                    &length) < 0) stats.observed_socket_buffer_bytes = -1;
@@ -356,7 +551,7 @@ int connected_socket(const Config &config, WorkerStats &stats,
 
 void pace_until(std::uint64_t deadline) {
   for (;;) {
-    const auto now = nll::mono_ns();
+    const auto now = nll::stamp_mono_ns();
     if (now >= deadline || stop_requested.load(std::memory_order_relaxed)) return;
     const auto remaining = deadline - now;
     if (remaining > 300'000) nll::sleep_ns(remaining - 100'000);
@@ -364,10 +559,20 @@ void pace_until(std::uint64_t deadline) {
   }
 }
 
+void publish_progress(nll::telemetry::Publisher &publisher, const WorkerStats &stats,
+                      std::uint64_t planned_sends) noexcept {
+  if (!publisher.enabled()) return;
+  publisher.publish({stats.attempted_sends, stats.successful_sends, stats.failed_sends,
+                     stats.syscall_count, stats.error_returns, stats.lateness_max_ns,
+                     planned_sends});
+}
+
 void run_worker(std::uint32_t worker_index, const Config &config,
                 const sockaddr_in &destination, std::barrier<> &start_barrier,
                 const std::atomic<std::uint64_t> &start_ns,
-                std::atomic<std::uint64_t> &next_sequence, WorkerStats &stats) {
+                std::atomic<std::uint64_t> &next_sequence, WorkerStats &stats,
+                nll::telemetry::Publisher telemetry,
+                nll::sender::TxTimestampCollector *tx_collector) {
   const int requested_cpu = config.cpus.empty()
       ? (config.threads == 1 ? config.cpu : -1) : config.cpus[worker_index];
   stats.affinity = requested_cpu >= 0
@@ -375,12 +580,44 @@ void run_worker(std::uint32_t worker_index, const Config &config,
       : nll::thread::AffinityOutcome{.requested = -1, .observed = sched_getcpu(),
           .observed_cpu_set = nll::thread::current_affinity_set(),
           .success = true, .error = ""};
-  const int socket_fd = connected_socket(config, stats, destination);
+  nll::log::register_thread();
+  // Without --flows, one socket on an ephemeral port. With it, this worker's
+  // share of the flows, each on its own socket and source port; batches
+  // rotate over them.
+  std::vector<int> sockets;
+  bool sockets_ready = true;
+  if (!config.flows) {
+    stats.flows.push_back({.flow = 0, .source_port = 0, .tx_socket = worker_index,
+                           .successful_sends = 0, .failed_sends = 0, .tx_submissions = {}});
+  } else {
+    for (std::uint32_t flow = 0; flow < config.flows; ++flow) {
+      if (nll::sender::flow_owner(flow, config.threads) != worker_index) continue;
+      stats.flows.push_back({.flow = flow,
+          .source_port = nll::sender::flow_source_port(config.source_port_base, flow),
+          .tx_socket = flow, .successful_sends = 0, .failed_sends = 0, .tx_submissions = {}});
+    }
+  }
+  for (const auto &flow : stats.flows) {
+    const int fd = connected_socket(config, stats, destination, flow.source_port);
+    if (fd < 0) { sockets_ready = false; break; }
+    sockets.push_back(fd);
+    if (tx_collector) tx_collector->attach(flow.tx_socket, fd);
+  }
   stats.batch_histogram.resize(config.send_batch_max + 1);
-  std::vector<std::byte> payloads(static_cast<std::size_t>(config.send_batch_max) *
-                                  config.payload_size);
-  std::vector<iovec> vectors(config.send_batch_max);
-  std::vector<mmsghdr> messages(config.send_batch_max);
+  // Allocated by the worker after pinning, so the slabs are local to its CPU.
+  const auto slab_bytes = static_cast<std::size_t>(config.send_batch_max) * config.payload_size;
+  nll::memory::Arena arena(nll::memory::bytes_for<std::byte>(slab_bytes) +
+                               nll::memory::bytes_for<iovec>(config.send_batch_max) +
+                               nll::memory::bytes_for<mmsghdr>(config.send_batch_max) +
+                               nll::memory::bytes_for<std::uint64_t>(config.send_batch_max),
+                           config.page_policy);
+  const auto payloads = arena.make_array<std::byte>(slab_bytes);
+  const auto vectors = arena.make_array<iovec>(config.send_batch_max);
+  const auto messages = arena.make_array<mmsghdr>(config.send_batch_max);
+  // The user-space stamp of each slot, for the TX log: the header's stamp
+  // when -T wrote one, otherwise one read per batch before the fill.
+  const auto user_send_ns = arena.make_array<std::uint64_t>(config.send_batch_max);
+  stats.arena = arena.report();
   for (std::uint32_t index = 0; index < config.send_batch_max; ++index) {
     vectors[index] = {.iov_base = payloads.data() +
           static_cast<std::size_t>(index) * config.payload_size,
@@ -388,13 +625,38 @@ void run_worker(std::uint32_t worker_index, const Config &config,
     messages[index] = {};
     messages[index].msg_hdr.msg_iov = &vectors[index];
     messages[index].msg_hdr.msg_iovlen = 1;
+    if (config.payload_pattern)
+      nll::fill_payload_pattern(static_cast<std::byte *>(vectors[index].iov_base),
+                                config.payload_size, config.pattern_seed);
   }
+  // Opened before the barrier so the perf_event_open calls stay outside the
+  // counted window.
+  nll::perf::StageCounters counters(config.perf_counters);
+  nll::memory::FaultCounter faults(RUSAGE_THREAD);
   start_barrier.arrive_and_wait();
+  faults.start();
+  counters.start();
   const auto start = start_ns.load(std::memory_order_acquire);
+  // Schedules are monotonic, but the v2 header carries CLOCK_REALTIME like
+  // send_unix_ns, so one offset taken here maps every deadline across.
+  const auto realtime_offset = nll::stamp_real_ns() - nll::stamp_mono_ns();
+  const auto header_bytes = nll::message_header_bytes(config.header_version);
   const auto duration_ns = static_cast<std::uint64_t>(config.duration_seconds * 1e9);
   const auto end = start + duration_ns;
-  const auto packet_limit = nll::sender::scheduled_packet_count(duration_ns,
-                                                                 config.rate_pps);
+  // With --rate-profile every deadline and batch comes from the compiled
+  // schedule, walked by this worker's own cursor.
+  const auto *schedule = config.rate_schedule.empty() ? nullptr : &config.rate_schedule;
+  std::size_t segment = 0;
+  // With --replay they come from the capture, and so does each datagram's size.
+  const auto *replay = config.replay_schedule.empty() ? nullptr : &config.replay_schedule;
+  const auto packet_limit = schedule ? schedule->packet_count()
+      : replay ? replay->packet_count()
+      : nll::sender::scheduled_packet_count(duration_ns, config.rate_pps);
+  const auto deadline_of = [&](std::uint64_t index) {
+    return schedule ? start + schedule->offset_ns(index, segment)
+        : replay ? start + replay->offset_ns(index)
+        : nll::sender::deadline_ns(start, index, config.rate_pps);
+  };
   // Resolve the mode once: comparing a std::string on every batch put a strcmp
   // in the innermost pacing loop.
   const Mode mode = config.mode == "flood" ? Mode::flood
@@ -409,9 +671,16 @@ void run_worker(std::uint32_t worker_index, const Config &config,
       worker_packets / expected_batch + 1024, 1ULL << 21);
   stats.lateness_ns.reserve(expected_syscalls);
   if (!config.pacing_trace_path.empty()) stats.trace.reserve(expected_syscalls);
+  if (tx_collector)
+    for (auto &flow : stats.flows)
+      flow.tx_submissions.reserve(std::min<std::uint64_t>(
+          worker_packets / stats.flows.size() + config.send_batch_max, 1ULL << 24));
+  const auto planned_sends = mode == Mode::flood || packet_limit <= worker_index ? 0
+      : (packet_limit - worker_index + config.threads - 1) / config.threads;
   std::uint64_t packet_index = worker_index;
-  while (socket_fd >= 0 && !stop_requested.load(std::memory_order_relaxed) &&
-         nll::mono_ns() < end &&
+  std::size_t next_flow = 0;
+  while (sockets_ready && !stop_requested.load(std::memory_order_relaxed) &&
+         nll::stamp_mono_ns() < end &&
          (mode == Mode::flood || packet_index < packet_limit)) {
     std::uint32_t count = 0;
     std::uint64_t scheduled = 0;
@@ -425,30 +694,77 @@ void run_worker(std::uint32_t worker_index, const Config &config,
       scheduled = nll::sender::deadline_ns(start, burst_start, config.rate_pps);
       pace_until(scheduled);
     } else {
-      count = nll::sender::adaptive_batch_count(packet_index, packet_limit,
-          config.threads, config.rate_pps, config.send_batch_max,
-          config.batch_window_us * 1000ULL);
-      scheduled = nll::sender::deadline_ns(start, packet_index, config.rate_pps);
+      count = schedule
+          ? schedule->batch_count(packet_index, config.threads, config.send_batch_max,
+                                  config.batch_window_us * 1000ULL, segment)
+          : replay
+          ? replay->batch_count(packet_index, config.threads, config.send_batch_max,
+                                config.batch_window_us * 1000ULL)
+          : nll::sender::adaptive_batch_count(packet_index, packet_limit,
+                config.threads, config.rate_pps, config.send_batch_max,
+                config.batch_window_us * 1000ULL);
+      scheduled = deadline_of(packet_index);
       pace_until(scheduled);
     }
     if (!count) break;
+    auto &flow = stats.flows[next_flow];
+    const int socket_fd = sockets[next_flow];
+    next_flow = next_flow + 1 == sockets.size() ? 0 : next_flow + 1;
     const auto first_sequence = nll::sender::allocate_sequence_range(next_sequence, count);
+    const auto batch_real_ns = tx_collector ? nll::stamp_real_ns() : 0;
+    // A steady v2 batch stamps each slot with its own deadline; without a
+    // profile or replay they are walked from the batch's first one.
+    const bool walk_deadlines = mode == Mode::steady && !schedule && !replay &&
+                                config.header_version == nll::message_version_v2;
+    nll::sender::DeadlineWalk slot_deadlines;
+    if (walk_deadlines)
+      slot_deadlines = {start, packet_index, config.threads, config.rate_pps};
     for (std::uint32_t index = 0; index < count; ++index) {
       const auto sequence = first_sequence + index;
       const bool timestamped = config.timestamp_every != 0 &&
                                sequence % config.timestamp_every == 0;
-      nll::message_header message{.magic = 0x6584, .version = 1, .msg_type = 0,
+      nll::message_header message{.magic = 0x6584, .version = config.header_version,
+          .msg_type = config.flow_tag ? nll::msg_flag_flow_tag : std::uint8_t{0},
           .seq_idx = static_cast<std::uint32_t>(sequence),
-          .send_unix_ns = timestamped ? nll::real_ns() : 0};
+          .send_unix_ns = timestamped ? nll::stamp_real_ns() : 0};
+      if (tx_collector) user_send_ns[index] = timestamped ? message.send_unix_ns : batch_real_ns;
       message.to_network();
-      std::memcpy(payloads.data() + static_cast<std::size_t>(index) * config.payload_size,
-                  &message, sizeof(message));
+      auto *slot = payloads.data() + static_cast<std::size_t>(index) * config.payload_size;
+      std::memcpy(slot, &message, sizeof(message));
+      if (replay)
+        vectors[index].iov_len = replay->payload_bytes(
+            packet_index + static_cast<std::uint64_t>(index) * config.threads);
+      if (config.header_version == nll::message_version_v2) {
+        // Steady batches span several send slots; a burst shares one deadline.
+        auto deadline = scheduled;
+        if (mode == Mode::steady && index != 0) {
+          if (walk_deadlines) {
+            slot_deadlines.advance();
+            deadline = slot_deadlines.deadline_ns();
+          } else {
+            deadline = deadline_of(packet_index + static_cast<std::uint64_t>(index) * config.threads);
+          }
+        }
+        nll::message_schedule schedule{
+            .scheduled_unix_ns = mode == Mode::flood ? 0 : deadline + realtime_offset};
+        schedule.to_network();
+        std::memcpy(slot + sizeof(message), &schedule, sizeof(schedule));
+      }
+      if (config.flow_tag) {
+        nll::flow_tag tag{.flow_id = static_cast<std::uint16_t>(flow.flow), .reserved = 0,
+                          .flow_sequence = flow.next_flow_sequence++};
+        tag.to_network();
+        std::memcpy(slot + header_bytes, &tag, sizeof(tag));
+      }
+      if (config.payload_pattern) nll::seal_payload(slot, vectors[index].iov_len);
       messages[index].msg_len = 0;
     }
     stats.attempted_sends += count;
     std::uint32_t offset = 0;
     while (offset < count) {
-      const auto invocation = nll::mono_ns();
+      const auto invocation = nll::stamp_mono_ns();
+      // Worker 0 owns the cycle clock's re-anchoring; the others only read it.
+      if (worker_index == 0) nll::maintain_timestamp_clock(invocation);
       const int result = ::sendmmsg(socket_fd, messages.data() + offset,
                                     count - offset, 0);
       const int saved_errno = errno;
@@ -465,14 +781,23 @@ void run_worker(std::uint32_t worker_index, const Config &config,
         ++stats.error_returns;
         stats.last_error = outcome.error;
         stats.failed_sends += outcome.failed;
+        flow.failed_sends += outcome.failed;
+        // A qdisc drop happens after the datagram was built, so it has
+        // already consumed an OPT_ID key; record it to keep later keys aligned.
+        if (tx_collector && outcome.error == ENOBUFS)
+          flow.tx_submissions.push_back({first_sequence + offset, user_send_ns[offset]});
         break;
       }
       if (outcome.partial) ++stats.partial_returns;
-      const auto completion = nll::mono_ns();
+      const auto completion = nll::stamp_mono_ns();
       const auto successful = outcome.successful;
       stats.successful_sends += successful;
-      stats.successful_bytes += static_cast<std::uint64_t>(successful) *
-                                config.payload_size;
+      flow.successful_sends += successful;
+      if (replay)
+        for (std::uint32_t index = offset; index < offset + successful; ++index)
+          stats.successful_bytes += vectors[index].iov_len;
+      else
+        stats.successful_bytes += static_cast<std::uint64_t>(successful) * config.payload_size;
       ++stats.batch_histogram[successful];
       const auto offset_index = packet_index +
           static_cast<std::uint64_t>(offset) * config.threads;
@@ -481,33 +806,215 @@ void run_worker(std::uint32_t worker_index, const Config &config,
       const auto offset_deadline = mode == Mode::flood ? invocation
           : (mode == Mode::steady && offset == 0)
               ? scheduled
-              : nll::sender::deadline_ns(start, offset_index, config.rate_pps);
+              : deadline_of(offset_index);
       const auto lateness = invocation > offset_deadline ? invocation - offset_deadline : 0;
       ++stats.lateness_samples;
       stats.lateness_sum_ns += lateness;
       stats.lateness_max_ns = std::max(stats.lateness_max_ns, lateness);
       stats.lateness_ns.push_back(lateness);
+      if (tx_collector)
+        for (std::uint32_t index = offset; index < offset + successful; ++index)
+          flow.tx_submissions.push_back({first_sequence + index, user_send_ns[index]});
       if (!config.pacing_trace_path.empty())
         stats.trace.push_back({completion, offset_deadline,
-            first_sequence + offset, successful, worker_index});
+            first_sequence + offset, successful, worker_index,
+            schedule ? schedule->rate_pps(segment)
+                : replay ? replay->mean_rate_pps() : config.rate_pps});
       offset += successful;
     }
     packet_index += static_cast<std::uint64_t>(count) * config.threads;
+    publish_progress(telemetry, stats, planned_sends);
   }
-  if (socket_fd < 0) {
+  stats.counters = counters.stop();
+  stats.page_faults = faults.stop();
+  if (!sockets_ready) {
     stats.attempted_sends = 1;
     stats.failed_sends = 1;
     ++stats.error_returns;
-  } else {
-    ::close(socket_fd);
   }
+  if (!tx_collector)
+    for (const int fd : sockets) ::close(fd);
+  publish_progress(telemetry, stats, planned_sends);
+}
+struct RunWindow {
+  std::uint64_t start_ns;
+  std::uint64_t completion_ns;
+};
+
+// One timed send at config.rate_pps: every worker, from a shared start 100 ms
+// out until the schedule or --duration ends. next_sequence carries over between
+// calls so repeated trials continue one sequence stream.
+RunWindow run_workers(const Config &config, const sockaddr_in &destination,
+                      std::atomic<std::uint64_t> &next_sequence,
+                      std::vector<WorkerStats> &workers,
+                      nll::telemetry::SharedPage *telemetry,
+                      nll::sender::TxTimestampCollector *tx_collector) {
+  std::atomic<std::uint64_t> start_ns{0};
+  start_ns.store(nll::stamp_mono_ns() + 100'000'000ULL, std::memory_order_release);
+  std::barrier start_barrier(static_cast<std::ptrdiff_t>(config.threads + 1));
+  std::vector<std::thread> threads;
+  threads.reserve(config.threads);
+  for (std::uint32_t index = 0; index < config.threads; ++index)
+    threads.emplace_back(run_worker, index, std::cref(config), std::cref(destination),
+                         std::ref(start_barrier), std::cref(start_ns),
+                         std::ref(next_sequence), std::ref(workers[index]),
+                         telemetry ? telemetry->publisher(index) : nll::telemetry::Publisher{},
+                         tx_collector);
+  start_barrier.arrive_and_wait();
+  for (auto &thread : threads) thread.join();
+  return {start_ns.load(std::memory_order_acquire), nll::stamp_mono_ns()};
+}
+
+// After a trial, waits until the receiver has stopped counting: the last
+// datagrams may still be queued in its socket or SPSC ring when the sender's
+// threads have joined. Gives up after a second of continuous arrivals.
+std::optional<nll::control::reply> settled_snapshot(nll::control::Client &control) {
+  auto previous = control.snapshot();
+  for (int attempt = 0; previous && attempt < 100; ++attempt) {
+    nll::sleep_ns(10'000'000ULL);
+    auto current = control.snapshot();
+    if (!current) return std::nullopt;
+    if (current->datagrams_received == previous->datagrams_received &&
+        current->processed_packets == previous->processed_packets &&
+        current->pending_socket_bytes == 0)
+      return current;
+    previous = current;
+  }
+  return previous;
+}
+
+bool write_search_report(const Config &config, const nll::sender::CapacitySearch &search,
+                         const std::vector<nll::sender::TrialResult> &trials,
+                         bool converged, std::uint64_t elapsed_ns) {
+  if (config.stats_path.has_parent_path()) {
+    std::error_code ec;
+    std::filesystem::create_directories(config.stats_path.parent_path(), ec);
+    if (ec) {
+      std::fprintf(stderr, "Cannot create stats directory: %s\n", ec.message().c_str());
+      return false;
+    }
+  }
+  std::FILE *file = std::fopen(config.stats_path.c_str(), "w");
+  if (!file) {
+    std::fprintf(stderr, "Cannot open sender stats: %s\n", std::strerror(errno));
+    return false;
+  }
+  std::fprintf(file,
+      "{\n"
+      "  \"schema_version\": 2,\n"
+      "  \"capacity_search\": true,\n"
+      "  \"destination_ip\": \"%s\",\n"
+      "  \"port\": %u,\n"
+      "  \"control_port\": %u,\n"
+      "  \"payload_size\": %u,\n"
+      "  \"threads\": %u,\n"
+      "  \"trial_seconds\": %.9f,\n"
+      "  \"min_rate_pps\": %llu,\n"
+      "  \"max_rate_pps\": %llu,\n"
+      "  \"loss_tolerance\": %.9f,\n"
+      "  \"precision\": %.9f,\n"
+      "  \"capacity_pps\": %llu,\n"
+      "  \"converged\": %s,\n"
+      "  \"interrupted\": %s,\n"
+      "  \"elapsed_ns\": %llu,\n"
+      "  \"trials\": [",
+      escape(config.destination).c_str(), config.port, config.control_port,
+      config.payload_size, config.threads, config.duration_seconds,
+      static_cast<unsigned long long>(config.search_min_pps),
+      static_cast<unsigned long long>(config.rate_pps), config.search_loss,
+      config.search_precision, static_cast<unsigned long long>(search.capacity()),
+      converged ? "true" : "false",
+      stop_requested.load(std::memory_order_relaxed) ? "true" : "false",
+      static_cast<unsigned long long>(elapsed_ns));
+  for (std::size_t index = 0; index < trials.size(); ++index) {
+    const auto &trial = trials[index];
+    std::fprintf(file, "%s\n    {\"rate_pps\": %llu, \"planned_sends\": %llu, "
+        "\"attempted_sends\": %llu, \"successful_sends\": %llu, \"failed_sends\": %llu, "
+        "\"received\": %llu, \"lost\": %llu, \"receive_sequence_gaps\": %llu, "
+        "\"spsc_overflow\": %llu, \"pending_socket_bytes\": %llu, "
+        "\"mean_processing_latency_ns\": %.1f, \"sender_limited\": %s, \"passed\": %s}",
+        index ? "," : "", static_cast<unsigned long long>(trial.rate_pps),
+        static_cast<unsigned long long>(trial.planned_sends),
+        static_cast<unsigned long long>(trial.attempted_sends),
+        static_cast<unsigned long long>(trial.successful_sends),
+        static_cast<unsigned long long>(trial.failed_sends),
+        static_cast<unsigned long long>(trial.received),
+        static_cast<unsigned long long>(trial.lost),
+        static_cast<unsigned long long>(trial.receive_sequence_gaps),
+        static_cast<unsigned long long>(trial.spsc_overflow),
+        static_cast<unsigned long long>(trial.pending_socket_bytes),
+        trial.mean_processing_latency_ns, trial.sender_limited ? "true" : "false",
+        trial.passed ? "true" : "false");
+  }
+  std::fprintf(file, "%s]\n}\n", trials.empty() ? "" : "\n  ");
+  return std::fclose(file) == 0;
+}
+
+// Runs trials until the search converges. Exit codes follow main(): 1 if the
+// receiver stopped answering or the run was interrupted.
+int run_capacity_search(const Config &config, const sockaddr_in &destination,
+                        nll::telemetry::SharedPage *telemetry) {
+  sockaddr_in control_address = destination;
+  control_address.sin_port = htons(config.control_port);
+  nll::control::Client control(control_address);
+  if (!control.valid()) return 1;
+  const auto search_start = nll::mono_ns();
+  nll::sender::CapacitySearch search(config.search_min_pps, config.rate_pps,
+                                     config.search_precision);
+  std::vector<nll::sender::TrialResult> trials;
+  std::atomic<std::uint64_t> next_sequence{0};
+  bool converged = false;
+  bool answered = true;
+  const auto duration_ns = static_cast<std::uint64_t>(config.duration_seconds * 1e9);
+  while (!stop_requested.load(std::memory_order_relaxed)) {
+    const auto rate = search.next();
+    if (!rate) { converged = true; break; }
+    const auto before = settled_snapshot(control);
+    if (!before) { answered = false; break; }
+    Config trial = config;
+    trial.rate_pps = *rate;
+    std::vector<WorkerStats> workers(config.threads);
+    run_workers(trial, destination, next_sequence, workers, telemetry, nullptr);
+    const auto after = settled_snapshot(control);
+    if (!after) { answered = false; break; }
+    std::uint64_t attempted = 0, successful = 0, failed = 0;
+    for (const auto &worker : workers) {
+      attempted += worker.attempted_sends;
+      successful += worker.successful_sends;
+      failed += worker.failed_sends;
+    }
+    if (stop_requested.load(std::memory_order_relaxed)) break;
+    trials.push_back(nll::sender::judge_trial(*rate,
+        nll::sender::scheduled_packet_count(duration_ns, *rate), attempted, successful,
+        failed, *before, *after, config.search_loss));
+    const auto &result = trials.back();
+    search.record(*rate, result.passed);
+    std::fprintf(stderr, "trial %u: %llu pps, sent %llu, lost %llu, mean latency %.0f ns: %s\n",
+                 search.trials(), static_cast<unsigned long long>(*rate),
+                 static_cast<unsigned long long>(successful),
+                 static_cast<unsigned long long>(result.lost),
+                 result.mean_processing_latency_ns,
+                 result.passed ? "pass" : result.sender_limited ? "sender-limited" : "fail");
+  }
+  if (!answered)
+    std::fprintf(stderr, "Receiver control port %u did not answer\n", config.control_port);
+  const bool report_ok = write_search_report(config, search, trials, converged,
+                                             nll::mono_ns() - search_start);
+  if (converged)
+    std::fprintf(stderr, "capacity: %llu pps\n", static_cast<unsigned long long>(search.capacity()));
+  return converged && report_ok ? 0 : 1;
 }
 } // namespace
 
 int main(int argc, char **argv) {
   Config config;
   enum { send_batch_option = 1000, batch_window_option, threads_option,
-         cpus_option, pacing_trace_option };
+         cpus_option, pacing_trace_option, telemetry_option, clock_option, perf_option,
+         payload_pattern_option, tx_timestamps_option, hugepages_option, flows_option,
+         source_port_option, flow_tag_option, capacity_search_option, control_option,
+         search_min_option, search_loss_option, search_precision_option, header_version_option,
+         rate_profile_option, clock_sync_option, replay_option, replay_speed_option,
+         replay_loop_option };
   const option options[] = {
     {"ip", required_argument, nullptr, 'i'}, {"port", required_argument, nullptr, 'p'},
     {"rate", required_argument, nullptr, 'r'}, {"duration", required_argument, nullptr, 'd'},
@@ -520,6 +1027,26 @@ int main(int argc, char **argv) {
     {"threads", required_argument, nullptr, threads_option},
     {"cpus", required_argument, nullptr, cpus_option},
     {"pacing-trace", required_argument, nullptr, pacing_trace_option},
+    {"telemetry", no_argument, nullptr, telemetry_option},
+    {"clock", required_argument, nullptr, clock_option},
+    {"perf-counters", no_argument, nullptr, perf_option},
+    {"payload-pattern", required_argument, nullptr, payload_pattern_option},
+    {"tx-timestamps", required_argument, nullptr, tx_timestamps_option},
+    {"hugepages", required_argument, nullptr, hugepages_option},
+    {"flows", required_argument, nullptr, flows_option},
+    {"source-port", required_argument, nullptr, source_port_option},
+    {"flow-tag", no_argument, nullptr, flow_tag_option},
+    {"header-version", required_argument, nullptr, header_version_option},
+    {"rate-profile", required_argument, nullptr, rate_profile_option},
+    {"clock-sync", required_argument, nullptr, clock_sync_option},
+    {"replay", required_argument, nullptr, replay_option},
+    {"replay-speed", required_argument, nullptr, replay_speed_option},
+    {"replay-loop", no_argument, nullptr, replay_loop_option},
+    {"capacity-search", no_argument, nullptr, capacity_search_option},
+    {"control", required_argument, nullptr, control_option},
+    {"search-min", required_argument, nullptr, search_min_option},
+    {"search-loss", required_argument, nullptr, search_loss_option},
+    {"search-precision", required_argument, nullptr, search_precision_option},
     {"help", no_argument, nullptr, 'h'}, {nullptr, 0, nullptr, 0}};
   int opt = 0;
   while ((opt = getopt_long(argc, argv, "i:p:r:d:m:b:l:c:s:B:T:h", options, nullptr)) != -1) {
@@ -541,6 +1068,34 @@ int main(int argc, char **argv) {
     case threads_option: if (!parse_unsigned<std::uint32_t>(optarg, 1, 128, config.threads, "threads")) return 2; break;
     case cpus_option: if (!parse_cpu_list(optarg, config.cpus)) { std::fprintf(stderr, "Invalid CPU list: %s\n", optarg); return 2; } break;
     case pacing_trace_option: config.pacing_trace_path = optarg; break;
+    case telemetry_option: config.telemetry = true; break;
+    case clock_option: {
+      const auto clock = nll::parse_clock_source(optarg);
+      if (!clock) { std::fprintf(stderr, "Invalid clock: %s (expected system or cycles)\n", optarg); return 2; }
+      config.clock = *clock; break;
+    }
+    case perf_option: config.perf_counters = true; break;
+    case payload_pattern_option: if (!parse_unsigned<std::uint64_t>(optarg, 0, UINT64_MAX, config.pattern_seed, "payload pattern seed")) return 2; config.payload_pattern = true; break;
+    case tx_timestamps_option: config.tx_timestamps_path = optarg; break;
+    case hugepages_option: {
+      const auto policy = nll::memory::parse_page_policy(optarg);
+      if (!policy) { std::fprintf(stderr, "Invalid hugepages policy: %s (expected auto, hugetlb, thp or normal)\n", optarg); return 2; }
+      config.page_policy = *policy; break;
+    }
+    case flows_option: if (!parse_unsigned<std::uint32_t>(optarg, 1, 65535, config.flows, "flows")) return 2; break;
+    case source_port_option: if (!parse_unsigned<std::uint64_t>(optarg, 1, 65535, value, "source port")) return 2; config.source_port_base = static_cast<std::uint16_t>(value); break;
+    case flow_tag_option: config.flow_tag = true; break;
+    case rate_profile_option: config.rate_profile = optarg; break;
+    case replay_option: config.replay_path = optarg; break;
+    case replay_speed_option: if (!parse_ratio(optarg, 1e-3, 1e6, config.replay_speed, "replay speed")) return 2; break;
+    case replay_loop_option: config.replay_loop = true; break;
+    case clock_sync_option: if (!parse_unsigned<std::uint64_t>(optarg, 1, 1000, value, "clock sync rate")) return 2; config.clock_sync_hz = static_cast<std::uint32_t>(value); break;
+    case header_version_option: if (!parse_unsigned<std::uint64_t>(optarg, nll::message_version_v1, nll::message_version_v2, value, "header version")) return 2; config.header_version = static_cast<std::uint8_t>(value); break;
+    case capacity_search_option: config.capacity_search = true; break;
+    case control_option: if (!parse_unsigned<std::uint64_t>(optarg, 1, 65535, value, "control port")) return 2; config.control_port = static_cast<std::uint16_t>(value); break;
+    case search_min_option: if (!parse_unsigned<std::uint64_t>(optarg, 1, UINT64_MAX, config.search_min_pps, "search minimum")) return 2; break;
+    case search_loss_option: if (!parse_ratio(optarg, 0.0, 1.0, config.search_loss, "search loss")) return 2; break;
+    case search_precision_option: if (!parse_ratio(optarg, 1e-6, 1.0, config.search_precision, "search precision")) return 2; break;
     case 'h': usage(stdout); return 0;
     default: usage(stderr); return 2;
     }
@@ -564,36 +1119,125 @@ int main(int argc, char **argv) {
   if (config.threads > 1 && config.cpus.empty()) {
     std::fprintf(stderr, "Multiple threads require --cpus\n"); return 2;
   }
+  if (config.flows && config.flows < config.threads) {
+    std::fprintf(stderr, "--flows must be at least --threads so every worker owns a flow\n"); return 2;
+  }
+  if (config.flows && config.source_port_base + config.flows - 1 > 65535) {
+    std::fprintf(stderr, "--source-port %u plus %u flows exceeds port 65535\n",
+                 config.source_port_base, config.flows); return 2;
+  }
+  if (config.flow_tag && !config.flows) {
+    std::fprintf(stderr, "--flow-tag requires --flows\n"); return 2;
+  }
+  const std::size_t minimum_payload = nll::message_header_bytes(config.header_version) +
+      (config.flow_tag ? sizeof(nll::flow_tag) : 0) +
+      (config.payload_pattern ? nll::payload_trailer_bytes : 0);
+  // A replay pads short datagrams up to the minimum instead.
+  if (config.replay_path.empty() && config.payload_size < minimum_payload) {
+    std::fprintf(stderr, "%s requires --payload-size of at least %zu\n",
+                 config.payload_pattern ? "--payload-pattern"
+                     : config.flow_tag ? "--flow-tag" : "--header-version 2", minimum_payload);
+    return 2;
+  }
+  if (config.capacity_search) {
+    if (!config.control_port) {
+      std::fprintf(stderr, "--capacity-search requires --control\n"); return 2;
+    }
+    if (config.mode != "steady") {
+      std::fprintf(stderr, "--capacity-search searches steady mode only\n"); return 2;
+    }
+    if (config.search_min_pps > config.rate_pps) {
+      std::fprintf(stderr, "--search-min must not exceed --rate\n"); return 2;
+    }
+    if (!config.pacing_trace_path.empty() || !config.tx_timestamps_path.empty()) {
+      std::fprintf(stderr, "--capacity-search does not write per-trial traces\n"); return 2;
+    }
+    if (config.clock_sync_hz) {
+      std::fprintf(stderr, "--clock-sync applies to a single run\n"); return 2;
+    }
+  } else if (config.control_port) {
+    std::fprintf(stderr, "--control requires --capacity-search\n"); return 2;
+  }
   const auto duration_ns = static_cast<std::uint64_t>(config.duration_seconds * 1e9);
   if (duration_ns == 0) {
     std::fprintf(stderr, "Duration must be at least one nanosecond\n"); return 2;
   }
+  if (!config.rate_profile.empty()) {
+    if (config.mode != "steady" || config.capacity_search) {
+      std::fprintf(stderr, "--rate-profile applies to a single steady-mode run\n"); return 2;
+    }
+    std::vector<nll::sender::RatePoint> points;
+    if (!nll::sender::parse_rate_profile(config.rate_profile, config.duration_seconds, points)) return 2;
+    config.rate_schedule = nll::sender::RateSchedule(points, duration_ns);
+    if (!config.rate_schedule.packet_count()) {
+      std::fprintf(stderr, "--rate-profile schedules no packets\n"); return 2;
+    }
+  }
+  if (config.replay_path.empty() && (config.replay_loop || config.replay_speed != 1.0)) {
+    std::fprintf(stderr, "--replay-speed and --replay-loop require --replay\n"); return 2;
+  }
+  if (!config.replay_path.empty()) {
+    if (config.mode != "steady" || config.capacity_search || !config.rate_profile.empty()) {
+      std::fprintf(stderr, "--replay applies to a single steady-mode run without --rate-profile\n");
+      return 2;
+    }
+    std::vector<nll::sender::ReplayPacket> packets;
+    if (!nll::sender::read_capture(config.replay_path, packets, config.replay_capture)) return 2;
+    config.replay_schedule = nll::sender::ReplaySchedule(packets, config.replay_speed,
+        config.replay_loop, duration_ns, static_cast<std::uint32_t>(minimum_payload));
+    if (config.replay_loop && config.replay_schedule.trace_packets() &&
+        !config.replay_schedule.loop_period_ns()) {
+      std::fprintf(stderr, "--replay-loop needs a capture that spans some time\n"); return 2;
+    }
+    if (!config.replay_schedule.packet_count()) {
+      std::fprintf(stderr, "--replay capture %s has no UDP datagrams to send\n",
+                   config.replay_path.c_str());
+      return 2;
+    }
+    // Each send slot holds the largest datagram of the trace.
+    config.payload_size = config.replay_schedule.largest_payload();
+  }
   sockaddr_in destination{};
   destination.sin_family = AF_INET;
   destination.sin_port = htons(config.port);
   if (::inet_pton(AF_INET, config.destination.c_str(), &destination.sin_addr) != 1) {
     std::fprintf(stderr, "Invalid IPv4 address: %s\n", config.destination.c_str()); return 2;
   }
+  if (!nll::select_timestamp_source(config.clock)) {
+    std::fprintf(stderr, "Cycle counter clock unavailable or failed to calibrate\n"); return 1;
+  }
+  // From here on NLL_* only enqueue; the writer thread formats and writes.
+  nll::log::AsyncScope async_log;
   std::signal(SIGINT, signal_handler);
   std::vector<WorkerStats> workers(config.threads);
+  std::optional<nll::telemetry::SharedPage> telemetry;
+  if (config.telemetry)
+    telemetry.emplace(nll::telemetry::Role::sender, config.mode, config.threads);
+  if (config.capacity_search)
+    return run_capacity_search(config, destination, telemetry ? &*telemetry : nullptr);
   std::atomic<std::uint64_t> next_sequence{0};
-  std::atomic<std::uint64_t> start_ns{0};
-  start_ns.store(nll::mono_ns() + 100'000'000ULL, std::memory_order_release);
-  std::barrier start_barrier(static_cast<std::ptrdiff_t>(config.threads + 1));
-  std::vector<std::thread> threads;
-  threads.reserve(config.threads);
-  for (std::uint32_t index = 0; index < config.threads; ++index)
-    threads.emplace_back(run_worker, index, std::cref(config), std::cref(destination),
-                         std::ref(start_barrier), std::cref(start_ns),
-                         std::ref(next_sequence), std::ref(workers[index]));
-  start_barrier.arrive_and_wait();
-  for (auto &thread : threads) thread.join();
-  const auto completion_ns = nll::mono_ns();
+  std::optional<nll::sender::TxTimestampCollector> tx_collector;
+  if (!config.tx_timestamps_path.empty())
+    tx_collector.emplace(config.flows ? config.flows : config.threads);
+  std::optional<nll::sender::ClockProber> clock_prober;
+  if (config.clock_sync_hz) {
+    clock_prober.emplace(destination, config.clock_sync_hz);
+    if (!clock_prober->start()) return 1;
+  }
+  const auto window = run_workers(config, destination, next_sequence, workers,
+                                  telemetry ? &*telemetry : nullptr,
+                                  tx_collector ? &*tx_collector : nullptr);
+  if (clock_prober) clock_prober->stop();
+  const auto completion_ns = window.completion_ns;
+  if (tx_collector) tx_collector->finish();
 
   Stats stats;
   stats.requested_socket_buffer_bytes = config.socket_buffer_bytes;
+  if (telemetry) stats.telemetry_page = telemetry->path();
+  if (clock_prober) stats.clock_sync = clock_prober->report();
   stats.batch_histogram.resize(config.send_batch_max + 1);
   stats.observed_socket_buffer_bytes = workers.front().observed_socket_buffer_bytes;
+  stats.arena = workers.front().arena;
   for (const auto &worker : workers) {
     stats.attempted_sends += worker.attempted_sends;
     stats.successful_sends += worker.successful_sends;
@@ -611,14 +1255,31 @@ int main(int argc, char **argv) {
     stats.lateness_ns.insert(stats.lateness_ns.end(), worker.lateness_ns.begin(),
                              worker.lateness_ns.end());
     stats.trace.insert(stats.trace.end(), worker.trace.begin(), worker.trace.end());
+    nll::perf::accumulate(stats.counters, worker.counters);
+    nll::memory::accumulate(stats.page_faults, worker.page_faults);
   }
-  const auto start = start_ns.load(std::memory_order_acquire);
+  const auto start = window.start_ns;
   stats.elapsed_ns = completion_ns > start ? completion_ns - start : 0;
   const bool trace_ok = write_trace(config, workers);
+  bool tx_ok = true;
+  if (tx_collector) {
+    const auto sockets = config.flows ? config.flows : config.threads;
+    std::vector<std::vector<nll::sender::TxSubmission>> submissions(sockets);
+    std::vector<std::uint32_t> socket_threads(sockets, 0);
+    for (std::uint32_t index = 0; index < workers.size(); ++index)
+      for (auto &flow : workers[index].flows) {
+        submissions[flow.tx_socket] = std::move(flow.tx_submissions);
+        socket_threads[flow.tx_socket] = index;
+      }
+    tx_ok = nll::sender::write_tx_log(config.tx_timestamps_path, submissions, socket_threads,
+                                      tx_collector->stamps(), stats.tx_log);
+    stats.tx_other_errors = tx_collector->other_errors();
+  }
+  stats.log_messages_dropped = nll::log::dropped_messages();
   const bool stats_ok = write_stats(config, std::move(stats), workers, start,
                                     start + duration_ns);
   // An interrupted run is reported as a failure so a harness cannot mistake a
   // truncated capture for a completed one; the statistics file is still written.
   const bool interrupted = stop_requested.load(std::memory_order_relaxed);
-  return trace_ok && stats_ok && !interrupted ? 0 : 1;
+  return trace_ok && tx_ok && stats_ok && !interrupted ? 0 : 1;
 }
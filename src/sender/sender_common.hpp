@@ -43,6 +43,48 @@ inline std::uint64_t deadline_ns(std::uint64_t start_ns,
                                     : start_ns + static_cast<std::uint64_t>(offset);
 }
 
+// deadline_ns() for first_index, first_index + stride, ... without a 128-bit
+// division per step: the quotient and remainder of index * 1e9 / rate advance
+// by those of stride * 1e9 / rate, so every deadline is exact.
+class DeadlineWalk {
+public:
+  DeadlineWalk() = default;
+  DeadlineWalk(std::uint64_t start_ns, std::uint64_t first_index, std::uint64_t stride,
+               std::uint64_t rate_pps) noexcept
+      : start_ns_(start_ns), rate_pps_(rate_pps) {
+    const auto first = static_cast<uint128>(first_index) * 1'000'000'000ULL;
+    const auto step = static_cast<uint128>(stride) * 1'000'000'000ULL;
+    offset_ = first / rate_pps;
+    remainder_ = first % rate_pps;
+    step_offset_ = step / rate_pps;
+    step_remainder_ = step % rate_pps;
+  }
+
+  [[nodiscard]] uint128 offset_ns() const noexcept { return offset_; }
+  [[nodiscard]] std::uint64_t deadline_ns() const noexcept {
+    const auto maximum = std::numeric_limits<std::uint64_t>::max();
+    return offset_ > maximum - start_ns_ ? maximum
+                                         : start_ns_ + static_cast<std::uint64_t>(offset_);
+  }
+
+  void advance() noexcept {
+    offset_ += step_offset_;
+    remainder_ += step_remainder_;
+    if (remainder_ >= rate_pps_) {
+      remainder_ -= rate_pps_;
+      ++offset_;
+    }
+  }
+
+private:
+  std::uint64_t start_ns_ = 0;
+  std::uint64_t rate_pps_ = 1;
+  uint128 offset_ = 0;
+  uint128 remainder_ = 0;
+  uint128 step_offset_ = 0;
+  uint128 step_remainder_ = 0;
+};
+
 inline std::uint64_t scheduled_packet_count(std::uint64_t duration_ns,
                                             std::uint64_t rate_pps) noexcept {
   const auto product = static_cast<uint128>(duration_ns) * rate_pps;
@@ -58,18 +100,34 @@ inline std::uint32_t adaptive_batch_count(std::uint64_t first_packet_index,
                                           std::uint64_t batch_window_ns) noexcept {
   if (first_packet_index >= packet_limit || packet_stride == 0 || batch_max == 0)
     return 0;
-  const auto first_offset = (static_cast<uint128>(first_packet_index) *
-                             1'000'000'000ULL) / rate_pps;
+  DeadlineWalk walk(0, first_packet_index, packet_stride, rate_pps);
+  const auto first_offset = walk.offset_ns();
   std::uint32_t count = 1;
   while (count < batch_max) {
     const auto index = static_cast<uint128>(first_packet_index) +
                        static_cast<uint128>(count) * packet_stride;
     if (index >= packet_limit) break;
-    const auto offset = (index * 1'000'000'000ULL) / rate_pps;
-    if (offset - first_offset > batch_window_ns) break;
+    walk.advance();
+    if (walk.offset_ns() - first_offset > batch_window_ns) break;
     ++count;
   }
   return count;
 }
 
+// --flows N: flow f is sent from source port base + f by worker f % threads,
+// so each worker owns every threads-th flow and the flow-to-port map, and with
+// it the RSS hash of every 5-tuple, is fixed by the command line alone.
+inline std::uint32_t flow_owner(std::uint32_t flow, std::uint32_t threads) noexcept {
+  return flow % threads;
+}
+
+inline std::uint32_t flows_of_worker(std::uint32_t worker, std::uint32_t flows,
+                                     std::uint32_t threads) noexcept {
+  return worker < flows ? (flows - worker + threads - 1) / threads : 0;
+}
+
+inline std::uint16_t flow_source_port(std::uint16_t base, std::uint32_t flow) noexcept {
+  return static_cast<std::uint16_t>(base + flow);
+}
+
 } // namespace nll::sender
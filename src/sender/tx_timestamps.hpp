@@ -0,0 +1,248 @@
+#pragma once
+
+#include "common/log.hpp"
+#include "common/time.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace nll::sender {
+
+// Kernel transmit timestamps, per datagram.
+//
+// send_unix_ns is stamped in user space before sendmmsg(), so the one-way
+// latency a receiver computes from it includes the sender's own syscall, UDP
+// and qdisc path. With SO_TIMESTAMPING the kernel reports two more points on
+// CLOCK_REALTIME for every datagram: SCHED when it enters the qdisc and
+// SOFTWARE when the driver hands it to the device. Together with the user
+// stamp they split one-way latency into sender stack, wire and receiver parts.
+//
+// The reports arrive on each socket's error queue. Draining them in the send
+// loop would add a syscall per batch to the path being measured, so one
+// collector thread polls every sending socket for POLLERR instead and only
+// stores (socket, key, kind, time). OPT_ID numbers each datagram per socket
+// in submission order; the worker records which sequence it submitted under
+// each key, and the two are joined after the run. Sockets are indexed by
+// worker, or by flow when --flows gives a worker several. OPT_TSONLY returns
+// the stamp without a copy of the packet, so the error queue stays small.
+inline constexpr unsigned tx_timestamp_flags =
+    SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+    SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+
+// Queued stamps are charged to the socket's receive buffer, and the kernel
+// discards new ones once it is full. A send-only socket never needed one, so
+// the default of ~200 KiB holds only a few hundred stamps: request more, up to
+// net.core.rmem_max, so a briefly descheduled collector does not lose them.
+inline constexpr int tx_timestamp_queue_bytes = 8 << 20;
+
+inline bool enable_tx_timestamps(int fd) noexcept {
+  const int queue_bytes = tx_timestamp_queue_bytes;
+  if (::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &queue_bytes, sizeof(queue_bytes)) < 0)
+    NLL_WARN("SO_RCVBUF request for TX timestamps failed: %s\n", std::strerror(errno));
+  const int flags = static_cast<int>(tx_timestamp_flags);
+  if (::setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0) return true;
+  NLL_WARN("SO_TIMESTAMPING request failed: %s\n", std::strerror(errno));
+  return false;
+}
+
+// What the sender handed to the kernel under OPT_ID key == index.
+struct TxSubmission {
+  std::uint64_t sequence;
+  std::uint64_t user_send_real_ns;
+};
+
+enum class TxStampKind : std::uint8_t { sched, software };
+
+struct TxStamp {
+  std::uint32_t socket;
+  std::uint32_t key;
+  TxStampKind kind;
+  std::uint64_t real_ns;
+};
+
+// Returns the stamp in one error-queue message, or false for anything else
+// (an ICMP error, for instance, which IP_RECVERR also queues here).
+inline bool parse_tx_stamp(msghdr &message, std::uint32_t socket, TxStamp &stamp) noexcept {
+  const scm_timestamping *times = nullptr;
+  const sock_extended_err *error = nullptr;
+  for (cmsghdr *control = CMSG_FIRSTHDR(&message); control;
+       control = CMSG_NXTHDR(&message, control)) {
+    if (control->cmsg_level == SOL_SOCKET && control->cmsg_type == SCM_TIMESTAMPING)
+      times = reinterpret_cast<const scm_timestamping *>(CMSG_DATA(control));
+    else if ((control->cmsg_level == SOL_IP && control->cmsg_type == IP_RECVERR) ||
+             (control->cmsg_level == SOL_IPV6 && control->cmsg_type == IPV6_RECVERR))
+      error = reinterpret_cast<const sock_extended_err *>(CMSG_DATA(control));
+  }
+  if (!times || !error || error->ee_errno != ENOMSG ||
+      error->ee_origin != SO_EE_ORIGIN_TIMESTAMPING)
+    return false;
+  if (error->ee_info != SCM_TSTAMP_SCHED && error->ee_info != SCM_TSTAMP_SND) return false;
+  const auto &software = times->ts[0];
+  stamp = {.socket = socket, .key = error->ee_data,
+           .kind = error->ee_info == SCM_TSTAMP_SCHED ? TxStampKind::sched : TxStampKind::software,
+           .real_ns = static_cast<std::uint64_t>(software.tv_sec) * nll::a_billi +
+                      static_cast<std::uint64_t>(software.tv_nsec)};
+  return true;
+}
+
+class TxTimestampCollector {
+public:
+  explicit TxTimestampCollector(std::uint32_t sockets) : fds_(sockets) {
+    for (auto &fd : fds_) fd.store(-1, std::memory_order_relaxed);
+    thread_ = std::thread([this] { run(); });
+  }
+  ~TxTimestampCollector() { finish(); }
+  TxTimestampCollector(const TxTimestampCollector &) = delete;
+  TxTimestampCollector &operator=(const TxTimestampCollector &) = delete;
+
+  // Worker side, once the socket is connected. The collector owns the socket
+  // from here on and closes it in finish(), after the last stamps are read.
+  void attach(std::uint32_t socket, int fd) noexcept {
+    fds_[socket].store(fd, std::memory_order_release);
+  }
+
+  // After every worker has stopped sending. The driver stamps a datagram
+  // shortly after it leaves the qdisc, so a short grace period collects the
+  // tail of the run before the sockets are closed.
+  void finish() {
+    if (!thread_.joinable()) return;
+    nll::sleep_ns(grace_ns);
+    stop_.store(true, std::memory_order_release);
+    thread_.join();
+    for (std::uint32_t socket = 0; socket < fds_.size(); ++socket) {
+      const int fd = fds_[socket].load(std::memory_order_acquire);
+      if (fd < 0) continue;
+      drain(socket, fd);
+      ::close(fd);
+    }
+  }
+
+  [[nodiscard]] const std::vector<TxStamp> &stamps() const noexcept { return stamps_; }
+  [[nodiscard]] std::uint64_t other_errors() const noexcept { return other_errors_; }
+
+private:
+  static constexpr std::uint64_t grace_ns = 50'000'000ULL;
+  static constexpr int poll_timeout_ms = 10;
+
+  void run() {
+    std::vector<pollfd> polled;
+    std::vector<std::uint32_t> owners;
+    while (!stop_.load(std::memory_order_acquire)) {
+      polled.clear();
+      owners.clear();
+      for (std::uint32_t socket = 0; socket < fds_.size(); ++socket) {
+        const int fd = fds_[socket].load(std::memory_order_acquire);
+        if (fd < 0) continue;
+        // POLLERR is always reported; asking for nothing else keeps ordinary
+        // readability from waking the collector.
+        polled.push_back({.fd = fd, .events = 0, .revents = 0});
+        owners.push_back(socket);
+      }
+      if (polled.empty()) { nll::sleep_ns(1'000'000ULL); continue; }
+      if (::poll(polled.data(), polled.size(), poll_timeout_ms) <= 0) continue;
+      for (std::size_t index = 0; index < polled.size(); ++index)
+        if (polled[index].revents & POLLERR) drain(owners[index], polled[index].fd);
+    }
+  }
+
+  void drain(std::uint32_t socket, int fd) {
+    alignas(cmsghdr) char control[256];
+    for (;;) {
+      msghdr message{};
+      message.msg_control = control;
+      message.msg_controllen = sizeof(control);
+      if (::recvmsg(fd, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return;
+      TxStamp stamp{};
+      if (parse_tx_stamp(message, socket, stamp)) stamps_.push_back(stamp);
+      else ++other_errors_;
+    }
+  }
+
+  std::vector<std::atomic<int>> fds_;
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+  // Collector thread only until finish() joins it.
+  std::vector<TxStamp> stamps_;
+  std::uint64_t other_errors_ = 0;
+};
+
+struct TxLogSummary {
+  std::uint64_t records = 0;
+  std::uint64_t sched_stamps = 0;
+  std::uint64_t software_stamps = 0;
+  std::uint64_t unmatched_stamps = 0;
+};
+
+// One CSV row per submitted datagram, ordered by sequence. A stamp the kernel
+// did not deliver (error queue overflow, a device without software TX stamps)
+// is written as 0, the same convention as an unstamped send_unix_ns.
+// submissions and socket_threads are indexed like the collector's sockets.
+inline bool write_tx_log(const std::filesystem::path &path,
+                         const std::vector<std::vector<TxSubmission>> &submissions,
+                         const std::vector<std::uint32_t> &socket_threads,
+                         const std::vector<TxStamp> &stamps, TxLogSummary &summary) {
+  struct Row {
+    std::uint64_t sequence;
+    std::uint32_t thread;
+    std::uint64_t user_ns;
+    std::uint64_t sched_ns;
+    std::uint64_t software_ns;
+  };
+  std::vector<std::size_t> base(submissions.size() + 1, 0);
+  for (std::size_t socket = 0; socket < submissions.size(); ++socket)
+    base[socket + 1] = base[socket] + submissions[socket].size();
+  std::vector<Row> rows;
+  rows.reserve(base.back());
+  for (std::size_t socket = 0; socket < submissions.size(); ++socket)
+    for (const auto &submission : submissions[socket])
+      rows.push_back({submission.sequence, socket_threads[socket],
+                      submission.user_send_real_ns, 0, 0});
+  for (const auto &stamp : stamps) {
+    if (stamp.socket >= submissions.size() || stamp.key >= submissions[stamp.socket].size()) {
+      ++summary.unmatched_stamps;
+      continue;
+    }
+    auto &row = rows[base[stamp.socket] + stamp.key];
+    if (stamp.kind == TxStampKind::sched) { row.sched_ns = stamp.real_ns; ++summary.sched_stamps; }
+    else { row.software_ns = stamp.real_ns; ++summary.software_stamps; }
+  }
+  std::sort(rows.begin(), rows.end(),
+            [](const Row &left, const Row &right) { return left.sequence < right.sequence; });
+  if (path.has_parent_path()) {
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    if (ec) {
+      std::fprintf(stderr, "Cannot create TX timestamp directory: %s\n", ec.message().c_str());
+      return false;
+    }
+  }
+  std::FILE *file = std::fopen(path.c_str(), "w");
+  if (!file) {
+    std::fprintf(stderr, "Cannot open TX timestamp log: %s\n", std::strerror(errno));
+    return false;
+  }
+  std::fprintf(file, "sequence,thread_index,user_send_real_ns,sched_real_ns,software_real_ns\n");
+  for (const auto &row : rows)
+    std::fprintf(file, "%llu,%u,%llu,%llu,%llu\n", static_cast<unsigned long long>(row.sequence),
+                 row.thread, static_cast<unsigned long long>(row.user_ns),
+                 static_cast<unsigned long long>(row.sched_ns),
+                 static_cast<unsigned long long>(row.software_ns));
+  summary.records = rows.size();
+  return std::fclose(file) == 0;
+}
+
+} // namespace nll::sender
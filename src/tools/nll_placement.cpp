@@ -0,0 +1,183 @@
+// Proposes CPU roles for a receiver and sender from the host's topology and
+// the NIC's interrupt affinity, or launches a binary with them applied.
+//
+// Without a command, prints one JSON object: the discovered CPUs (package,
+// core, node, SMT siblings, L2 and last-level cache groups), the NIC's IRQs
+// and RPS/XPS sets, the plan, any rule the host could not satisfy, and the
+// --cpu/--worker-cpu/--cpus arguments that express it. With a command after
+// "--", appends those arguments and execs it, so a harness can write
+//
+//   nll_placement --interface eth0 --worker -- ./receiver_threaded -p 49200
+//   nll_placement --no-receiver --sender-threads 2 -- ./sender --threads 2 ...
+//
+// --root points discovery at a copy of /sys and /proc, for tests and for
+// planning another host from a captured tree.
+
+#include "common/cpu_placement.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+void usage(std::FILE *out) {
+  std::fprintf(out,
+      "Usage: nll_placement [options] [-- COMMAND [ARGS...]]\n\n"
+      "      --interface IF      NIC whose IRQ/RPS affinity anchors the receiver\n"
+      "      --worker            also place an SPSC worker\n"
+      "      --sender-threads N  place N sender threads, 0..128 (default 0)\n"
+      "      --no-receiver       plan a sender-only host\n"
+      "      --root DIR          read sys/ and proc/ under DIR (default /)\n"
+      "  -h, --help              show this help\n");
+}
+
+void print_list(const std::vector<int> &cpus) {
+  std::printf("[");
+  for (std::size_t index = 0; index < cpus.size(); ++index)
+    std::printf("%s%d", index ? ", " : "", cpus[index]);
+  std::printf("]");
+}
+
+std::vector<std::string> role_arguments(const nll::placement::Plan &plan,
+                                        const nll::placement::Request &request) {
+  std::vector<std::string> arguments;
+  if (request.receiver) {
+    if (plan.ingress_cpu >= 0) arguments.insert(arguments.end(), {"--cpu", std::to_string(plan.ingress_cpu)});
+    if (plan.worker_cpu >= 0) arguments.insert(arguments.end(), {"--worker-cpu", std::to_string(plan.worker_cpu)});
+  } else if (plan.sender_cpus.size() == 1) {
+    arguments.insert(arguments.end(), {"--cpu", std::to_string(plan.sender_cpus.front())});
+  } else if (!plan.sender_cpus.empty()) {
+    arguments.insert(arguments.end(), {"--cpus", nll::placement::format_cpu_list(plan.sender_cpus)});
+  }
+  return arguments;
+}
+
+void print_arguments(const std::vector<std::string> &arguments) {
+  std::printf("[");
+  for (std::size_t index = 0; index < arguments.size(); ++index)
+    std::printf("%s\"%s\"", index ? ", " : "", arguments[index].c_str());
+  std::printf("]");
+}
+
+void print_json(const nll::placement::Topology &topology, const nll::placement::Plan &plan,
+                const nll::placement::Request &request) {
+  std::printf("{\n  \"cpus\": [\n");
+  for (std::size_t index = 0; index < topology.cpus.size(); ++index) {
+    const auto &cpu = topology.cpus[index];
+    std::printf("    {\"cpu\": %d, \"package\": %d, \"core\": %d, \"node\": %d, \"smt_siblings\": ",
+                cpu.id, cpu.package, cpu.core, cpu.node);
+    print_list(cpu.smt_siblings);
+    std::printf(", \"l2_shared\": ");
+    print_list(cpu.l2_shared);
+    std::printf(", \"llc_shared\": ");
+    print_list(cpu.llc_shared);
+    std::printf("}%s\n", index + 1 == topology.cpus.size() ? "" : ",");
+  }
+  std::printf("  ],\n  \"nic\": ");
+  if (topology.nic) {
+    const auto &nic = *topology.nic;
+    std::printf("{\"interface\": \"%s\", \"irqs\": ", nic.interface.c_str());
+    print_list(nic.irqs);
+    std::printf(", \"irq_cpus\": ");
+    print_list(nic.irq_cpus);
+    std::printf(", \"busiest_cpus\": ");
+    print_list(nic.busiest_cpus);
+    std::printf(", \"rps_cpus\": ");
+    print_list(nic.rps_cpus);
+    std::printf(", \"xps_cpus\": ");
+    print_list(nic.xps_cpus);
+    std::printf("},\n");
+  } else {
+    std::printf("null,\n");
+  }
+  std::printf("  \"plan\": {\"irq_cpu\": %d, \"ingress_cpu\": %d, \"worker_cpu\": %d, \"sender_cpus\": ",
+              plan.irq_cpu, plan.ingress_cpu, plan.worker_cpu);
+  print_list(plan.sender_cpus);
+  std::printf("},\n  \"notes\": [");
+  for (std::size_t index = 0; index < plan.notes.size(); ++index)
+    std::printf("%s\"%s\"", index ? ", " : "", plan.notes[index].c_str());
+  std::printf("],\n  \"receiver_args\": ");
+  print_arguments(role_arguments(plan, {.receiver = true, .worker = request.worker,
+                                        .sender_threads = 0}));
+  std::printf(",\n  \"sender_args\": ");
+  print_arguments(role_arguments(plan, {.receiver = false, .worker = false,
+                                        .sender_threads = request.sender_threads}));
+  std::printf("\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  enum { interface_option = 1000, worker_option, sender_threads_option, no_receiver_option,
+         root_option };
+  const option options[] = {
+    {"interface", required_argument, nullptr, interface_option},
+    {"worker", no_argument, nullptr, worker_option},
+    {"sender-threads", required_argument, nullptr, sender_threads_option},
+    {"no-receiver", no_argument, nullptr, no_receiver_option},
+    {"root", required_argument, nullptr, root_option},
+    {"help", no_argument, nullptr, 'h'}, {nullptr, 0, nullptr, 0}};
+  std::string interface;
+  std::string root = "/";
+  nll::placement::Request request;
+  int opt = 0;
+  // The leading '+' stops at the first non-option so the command's own flags
+  // are left alone.
+  while ((opt = getopt_long(argc, argv, "+h", options, nullptr)) != -1) {
+    switch (opt) {
+    case interface_option: interface = optarg; break;
+    case worker_option: request.worker = true; break;
+    case sender_threads_option: {
+      char *end = nullptr;
+      const auto value = std::strtoul(optarg, &end, 10);
+      if (!*optarg || *end || value > 128) {
+        std::fprintf(stderr, "Invalid sender threads: %s\n", optarg);
+        return 2;
+      }
+      request.sender_threads = static_cast<std::uint32_t>(value);
+      break;
+    }
+    case no_receiver_option: request.receiver = false; break;
+    case root_option: root = optarg; break;
+    case 'h': usage(stdout); return 0;
+    default: usage(stderr); return 2;
+    }
+  }
+  if (!request.receiver && request.worker) {
+    std::fprintf(stderr, "--worker requires a receiver\n");
+    return 2;
+  }
+  if (!interface.empty() && !nll::placement::discover_nic(root, interface)) {
+    std::fprintf(stderr, "Unknown interface: %s\n", interface.c_str());
+    return 1;
+  }
+  const auto topology = nll::placement::discover(root, interface);
+  if (topology.cpus.empty()) {
+    std::fprintf(stderr, "No CPU topology under %s\n", root.c_str());
+    return 1;
+  }
+  const auto plan = nll::placement::plan(topology, request);
+  if (optind == argc) {
+    print_json(topology, plan, request);
+    return 0;
+  }
+  if (request.receiver && request.sender_threads) {
+    std::fprintf(stderr, "A command takes one role: use --no-receiver or --sender-threads 0\n");
+    return 2;
+  }
+  std::vector<std::string> arguments(argv + optind, argv + argc);
+  const auto placed = role_arguments(plan, request);
+  arguments.insert(arguments.end(), placed.begin(), placed.end());
+  for (const auto &note : plan.notes) std::fprintf(stderr, "nll_placement: %s\n", note.c_str());
+  std::vector<char *> command;
+  for (auto &argument : arguments) command.push_back(argument.data());
+  command.push_back(nullptr);
+  ::execvp(command.front(), command.data());
+  std::perror("execvp");
+  return 1;
+}
@@ -0,0 +1,117 @@
+// Prints live rates from a receiver's or sender's telemetry page.
+//
+// The measured process only ever writes its own cache lines; this tool maps
+// /dev/shm/nll-<pid> read-only and takes seqlock snapshots, so it can watch a
+// timed interval without SSH polling or any syscall on the measured host's hot
+// threads. Run it on the same host, started after the process under test.
+//
+// One JSON object per interval on stdout: cumulative counters, per-second rates
+// over the last interval, and derived values (receiver queue depth, sender
+// schedule progress). Exits when the watched process does.
+//
+// Usage: nll_telemetry PID [interval_ms] [samples]   (samples 0 = until exit)
+
+#include "common/telemetry.hpp"
+#include "common/time.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/types.h>
+
+namespace {
+
+bool process_alive(int pid) { return ::kill(pid, 0) == 0 || errno == EPERM; }
+
+// Counters are summed across blocks; gauges take the maximum.
+nll::telemetry::Counters aggregate(const nll::telemetry::Reader &reader, bool &complete) {
+  nll::telemetry::Counters total{};
+  const bool sender = reader.header().role == nll::telemetry::Role::sender;
+  complete = true;
+  for (std::uint32_t block = 0; block < reader.header().block_count; ++block) {
+    const auto values = reader.snapshot(block);
+    if (!values) { complete = false; continue; }
+    for (std::size_t index = 0; index < total.size(); ++index) {
+      if (sender && index == nll::telemetry::lateness_max_ns)
+        total[index] = std::max(total[index], (*values)[index]);
+      else
+        total[index] += (*values)[index];
+    }
+  }
+  return total;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "Usage: nll_telemetry PID [interval_ms] [samples]\n");
+    return 2;
+  }
+  const int pid = std::atoi(argv[1]);
+  const std::uint64_t interval_ms = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000;
+  const std::uint64_t samples = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 0;
+  if (pid <= 0 || interval_ms == 0) {
+    std::fprintf(stderr, "Invalid PID or interval\n");
+    return 2;
+  }
+  nll::telemetry::Reader reader(pid);
+  if (!reader.valid()) {
+    std::fprintf(stderr, "No telemetry page for PID %d (was --telemetry given?)\n", pid);
+    return 1;
+  }
+  const auto &header = reader.header();
+  const bool sender = header.role == nll::telemetry::Role::sender;
+  const auto &names = sender ? nll::telemetry::sender_counter_names
+                             : nll::telemetry::receiver_counter_names;
+
+  bool complete = true;
+  auto previous = aggregate(reader, complete);
+  auto previous_ns = nll::mono_ns();
+  for (std::uint64_t sample = 0; samples == 0 || sample < samples; ++sample) {
+    nll::sleep_ns(interval_ms * 1'000'000ULL);
+    const bool alive = process_alive(pid);
+    const auto current = aggregate(reader, complete);
+    const auto now = nll::mono_ns();
+    const double seconds = static_cast<double>(now - previous_ns) / 1e9;
+    std::printf("{\"pid\": %d, \"role\": \"%s\", \"variant\": \"%.*s\", \"elapsed_s\": %.3f, "
+                "\"complete\": %s, \"counters\": {",
+                pid, sender ? "sender" : "receiver",
+                static_cast<int>(sizeof(header.variant)), header.variant,
+                static_cast<double>(now - header.start_mono_ns) / 1e9,
+                complete ? "true" : "false");
+    for (std::size_t index = 0; index < current.size(); ++index)
+      std::printf("%s\"%s\": %llu", index ? ", " : "", names[index],
+                  static_cast<unsigned long long>(current[index]));
+    std::printf("}, \"rates_per_s\": {");
+    bool first = true;
+    for (std::size_t index = 0; index < current.size(); ++index) {
+      if (sender && (index == nll::telemetry::lateness_max_ns ||
+                     index == nll::telemetry::planned_sends)) continue;
+      const auto delta = current[index] >= previous[index] ? current[index] - previous[index] : 0;
+      std::printf("%s\"%s\": %.1f", first ? "" : ", ", names[index],
+                  seconds > 0.0 ? static_cast<double>(delta) / seconds : 0.0);
+      first = false;
+    }
+    if (sender) {
+      const auto planned = current[nll::telemetry::planned_sends];
+      std::printf("}, \"progress\": %.4f}\n", planned
+          ? static_cast<double>(current[nll::telemetry::attempted_sends]) / static_cast<double>(planned)
+          : 0.0);
+    } else {
+      const auto enqueued = current[nll::telemetry::valid_packets] -
+                            current[nll::telemetry::spsc_overflow];
+      const auto processed = current[nll::telemetry::processed_packets];
+      std::printf("}, \"queue_depth\": %llu}\n", static_cast<unsigned long long>(
+          enqueued > processed ? enqueued - processed : 0));
+    }
+    std::fflush(stdout);
+    previous = current;
+    previous_ns = now;
+    if (!alive) break;
+  }
+  return 0;
+}
@@ -21,4 +21,4 @@ def binaries(tmp_path_factory: pytest.TempPathFactory) -> dict[str, Path]:
                     "-DCMAKE_BUILD_TYPE=Release"], check=True)
     subprocess.run(["cmake", "--build", str(build), "-j2"], check=True)
     return {name: build / name for name in (
-        "receiver_baseline", "receiver_batched", "receiver_threaded", "sender")}
+        "receiver", "receiver_baseline", "receiver_batched", "receiver_threaded", "sender")}
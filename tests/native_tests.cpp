@@ -1,12 +1,44 @@
+#include "common/arena.hpp"
+#include "common/async_log.hpp"
+#include "common/clock_sync.hpp"
+#include "common/cpu_placement.hpp"
+#include "common/crc32c.hpp"
 #include "common/csv_writer.hpp"
+#include "common/flow_table.hpp"
+#include "common/log_histogram.hpp"
+#include "common/packet.hpp"
+#include "common/perf_counters.hpp"
 #include "common/sequence_tracker.hpp"
 #include "common/spsc_queue.hpp"
+#include "common/telemetry.hpp"
+#include "common/time.hpp"
+#include "receiver/control_server.hpp"
+#include "receiver/packet_batch.hpp"
+#include "receiver/packet_capture.hpp"
+#include "receiver/receiver_common.hpp"
+#include "receiver/work_model.hpp"
+#include "sender/capacity_search.hpp"
+#include "sender/pcap_replay.hpp"
+#include "sender/rate_profile.hpp"
 #include "sender/sender_common.hpp"
+#include "sender/tx_timestamps.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <netinet/in.h>
+#include <string>
 #include <thread>
+#include <tuple>
+#include <unistd.h>
+#include <utility>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -100,6 +132,38 @@ TEST(SequenceTracker, ReportsArrivalsOlderThanTheRetainedWindow) {
   EXPECT_EQ(tracker.reordered(), 1U);
 }
 
+// One burst and several singletons with the same total loss must be told apart
+// by the burst histogram, and each hole is stamped with the revealing arrival.
+TEST(SequenceTracker, RecordsGapEventsAndBurstLengths) {
+  nll::SequenceTracker tracker;
+  tracker.observe(0, 100);
+  tracker.observe(5, 200);  // 1..4 lost: one burst of 4
+  tracker.observe(7, 300);  // 6 lost: singleton
+  tracker.observe(9, 400);  // 8 lost: singleton
+  tracker.observe(8, 500);  // reordered fill does not create an event
+  const auto &timeline = tracker.gap_timeline();
+  ASSERT_EQ(timeline.recorded(), 3U);
+  ASSERT_EQ(timeline.retained(), 3U);
+  EXPECT_EQ(timeline.event(0).first_sequence, 1U);
+  EXPECT_EQ(timeline.event(0).length, 4U);
+  EXPECT_EQ(timeline.event(0).revealed_ns, 200U);
+  EXPECT_EQ(timeline.event(2).first_sequence, 8U);
+  EXPECT_EQ(timeline.burst_histogram()[0], 2U); // length 1
+  EXPECT_EQ(timeline.burst_histogram()[2], 1U); // lengths 4..7
+}
+
+TEST(SequenceTracker, GapTimelineRetainsTheMostRecentEvents) {
+  nll::SequenceTracker tracker;
+  const auto events = nll::GapTimeline::event_capacity + 10;
+  for (std::uint32_t index = 0; index <= events; ++index) tracker.observe(index * 2, index);
+  const auto &timeline = tracker.gap_timeline();
+  EXPECT_EQ(timeline.recorded(), events);
+  ASSERT_EQ(timeline.retained(), nll::GapTimeline::event_capacity);
+  EXPECT_EQ(timeline.event(0).first_sequence, 21U);
+  EXPECT_EQ(timeline.event(timeline.retained() - 1).first_sequence, events * 2 - 1);
+  EXPECT_EQ(timeline.burst_histogram()[0], events);
+}
+
 TEST(SPSCQueue, EmptyFullAndWraparound) {
   nll::SPSCQueue<std::uint64_t, 8> queue;
   EXPECT_TRUE(queue.empty());
@@ -161,6 +225,728 @@ TEST(SPSCQueue, ShutdownDrainsPublishedData) {
     EXPECT_EQ(drained[index], index);
 }
 
+TEST(Telemetry, SharedPageRoundTripsPublishedCounters) {
+  nll::telemetry::SharedPage page(nll::telemetry::Role::receiver, "test", 2);
+  ASSERT_TRUE(page.valid());
+  auto ingress = page.publisher(0);
+  EXPECT_FALSE(page.publisher(2).enabled());
+  ingress.publish({1, 2, 3, 4, 5, 6, 7});
+  ingress.publish({10, 20, 30, 40, 50, 60, 70});
+  nll::telemetry::Reader reader(static_cast<int>(::getpid()));
+  ASSERT_TRUE(reader.valid());
+  EXPECT_EQ(reader.header().role, nll::telemetry::Role::receiver);
+  EXPECT_EQ(reader.header().block_count, 2U);
+  const auto values = reader.snapshot(0);
+  ASSERT_TRUE(values.has_value());
+  EXPECT_EQ(*values, (nll::telemetry::Counters{10, 20, 30, 40, 50, 60, 70}));
+  EXPECT_EQ(reader.snapshot(1), nll::telemetry::Counters{});
+}
+
+// Every snapshot must be one whole publication, never a mix of two.
+TEST(Telemetry, SeqlockSnapshotsAreNeverTorn) {
+  nll::telemetry::SharedPage page(nll::telemetry::Role::sender, "test", 1);
+  ASSERT_TRUE(page.valid());
+  nll::telemetry::Reader reader(static_cast<int>(::getpid()));
+  ASSERT_TRUE(reader.valid());
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    auto publisher = page.publisher(0);
+    for (std::uint64_t value = 1; value <= 200'000; ++value)
+      publisher.publish({value, value, value, value, value, value, value});
+    done.store(true, std::memory_order_release);
+  });
+  bool torn = false;
+  while (!done.load(std::memory_order_acquire)) {
+    const auto values = reader.snapshot(0);
+    if (!values) continue;
+    for (const auto value : *values) torn |= value != (*values)[0];
+  }
+  writer.join();
+  EXPECT_FALSE(torn);
+}
+
+TEST(CycleClock, TracksMonotonicRawAfterCalibration) {
+  nll::CycleClock clock;
+  if (!clock.calibrate(5'000'000ULL)) GTEST_SKIP() << "no constant-rate cycle counter";
+  EXPECT_GT(clock.frequency_hz(), 1e6);
+  for (int sample = 0; sample < 5; ++sample) {
+    nll::sleep_ns(2'000'000ULL);
+    const auto before = nll::mono_ns();
+    const auto stamp = clock.mono_ns();
+    const auto after = nll::mono_ns();
+    // Calibration error over a few ms is far below this bound; a scheduling
+    // hiccup between the reads only widens [before, after].
+    EXPECT_GE(stamp + 20'000, before);
+    EXPECT_LE(stamp, after + 20'000);
+  }
+  const auto real_error = static_cast<long long>(clock.real_ns()) -
+                          static_cast<long long>(nll::real_ns());
+  EXPECT_LT(std::llabs(real_error), 1'000'000LL);
+}
+
+// CycleClock stamp minus clock_gettime, from the tightest of a few brackets,
+// so a preemption between the reads does not count as clock error.
+long long cycle_clock_error_ns(const nll::CycleClock &clock, bool real) {
+  long long error = 0;
+  std::uint64_t best_span = ~0ULL;
+  for (int attempt = 0; attempt < 8; ++attempt) {
+    const auto before = real ? nll::real_ns() : nll::mono_ns();
+    const auto stamp = real ? clock.real_ns() : clock.mono_ns();
+    const auto after = real ? nll::real_ns() : nll::mono_ns();
+    if (after - before >= best_span) continue;
+    best_span = after - before;
+    error = static_cast<long long>(stamp) - static_cast<long long>(before + best_span / 2);
+  }
+  return error;
+}
+
+// Re-anchoring slews drift back out without ever stepping mono stamps backwards.
+TEST(CycleClock, ReanchoringKeepsStampsMonotonic) {
+  nll::CycleClock clock;
+  if (!clock.calibrate(1'000'000ULL)) GTEST_SKIP() << "no constant-rate cycle counter";
+  std::uint64_t previous = clock.mono_ns();
+  bool backwards = false;
+  const auto read_monotonic = [&] {
+    for (int read = 0; read < 100; ++read) {
+      const auto stamp = clock.mono_ns();
+      backwards |= stamp < previous;
+      previous = stamp;
+    }
+  };
+  for (int round = 0; round < 50; ++round) {
+    read_monotonic();
+    clock.reanchor();
+  }
+  EXPECT_FALSE(backwards);
+  EXPECT_EQ(clock.reanchors(), 50U);
+
+  // A calibration 2000 ppm fast puts stamps ~10 us ahead within 5 ms. The
+  // reanchors that follow must pull them back and hold them there, not keep
+  // the lead or add to it.
+  clock.detune(2'000);
+  nll::sleep_ns(5'000'000ULL);
+  EXPECT_GT(cycle_clock_error_ns(clock, false), 5'000);
+  long long worst_mono = 0, worst_real = 0;
+  for (int round = 0; round < 40; ++round) {
+    nll::sleep_ns(2'000'000ULL);
+    if (round >= 10) {
+      worst_mono = std::max(worst_mono, std::llabs(cycle_clock_error_ns(clock, false)));
+      worst_real = std::max(worst_real, std::llabs(cycle_clock_error_ns(clock, true)));
+    }
+    read_monotonic();
+    clock.reanchor();
+  }
+  EXPECT_FALSE(backwards);
+  EXPECT_LT(worst_mono, 3'000);
+  EXPECT_LT(worst_real, 3'000);
+}
+
+TEST(PerfCounters, DisabledGroupReportsNothing) {
+  nll::perf::StageCounters counters(false);
+  EXPECT_FALSE(counters.enabled());
+  counters.start();
+  EXPECT_FALSE(counters.stop().available);
+}
+
+// Context switches are a software event, so this holds even without a PMU.
+TEST(PerfCounters, GroupCountsOnlyTheEnabledWindow) {
+  nll::perf::StageCounters counters(true);
+  if (!counters.enabled()) GTEST_SKIP() << "perf_event_open unavailable";
+  for (int sleep = 0; sleep < 5; ++sleep) nll::sleep_ns(100'000ULL);
+  counters.start();
+  for (int sleep = 0; sleep < 5; ++sleep) nll::sleep_ns(100'000ULL);
+  const auto reading = counters.stop();
+  ASSERT_TRUE(reading.available);
+  EXPECT_GT(reading.time_enabled_ns, 0U);
+  if (reading.counted[nll::perf::context_switches]) {
+    EXPECT_GE(reading.values[nll::perf::context_switches], 5U);
+    EXPECT_LT(reading.values[nll::perf::context_switches], 50U);
+  }
+}
+
+TEST(Crc32c, MatchesTheCheckValueOnEveryPath) {
+  const char check[] = "123456789";
+  EXPECT_EQ(nll::crc32c(check, 9), 0xE306'9283U);
+  // Lengths around the eight-byte stride exercise both the word and tail loops.
+  std::vector<std::byte> data(1024);
+  nll::fill_payload_pattern(data.data(), data.size(), 3);
+  for (const std::size_t size : {0UL, 1UL, 7UL, 8UL, 9UL, 63UL, 1024UL}) {
+    const auto *bytes = data.data();
+    EXPECT_EQ(~nll::crc32c_detail::portable(~0U, bytes, size),
+              ~nll::crc32c_detail::hardware(~0U, bytes, size)) << size;
+    EXPECT_EQ(nll::crc32c(bytes, size),
+              nll::crc32c(bytes + size / 2, size - size / 2, nll::crc32c(bytes, size / 2))) << size;
+  }
+}
+
+TEST(Crc32c, SealedPayloadDetectsAFlippedBit) {
+  std::vector<std::byte> payload(256);
+  nll::fill_payload_pattern(payload.data(), payload.size(), 7);
+  nll::seal_payload(payload.data(), payload.size());
+  EXPECT_TRUE(nll::payload_intact(payload.data(), payload.size()));
+  payload[100] ^= std::byte{0x10};
+  EXPECT_FALSE(nll::payload_intact(payload.data(), payload.size()));
+
+  nll::receiver::Stats stats;
+  nll::receiver::verify_payload(stats, payload.data(), payload.size(), false);
+  nll::receiver::verify_payload(stats, payload.data(), payload.size(), true);
+  EXPECT_EQ(stats.crc_checked_packets, 1U);
+  EXPECT_EQ(stats.crc_corrupt_packets, 1U);
+}
+
+TEST(LoopPolicy, DispatchRunsExactlyTheMatchingInstantiation) {
+  for (std::size_t index = 0; index < nll::receiver::loop_policy_count; ++index) {
+    const auto policy = nll::receiver::loop_policy_from_index(index);
+    EXPECT_EQ(nll::receiver::loop_policy_index(policy), index);
+    int calls = 0;
+    std::size_t selected = nll::receiver::loop_policy_count;
+    nll::receiver::dispatch_loop(policy, [&]<nll::receiver::LoopPolicy Policy>() {
+      ++calls;
+      selected = nll::receiver::loop_policy_index(Policy);
+    });
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(selected, index);
+  }
+  nll::receiver::Config config;
+  config.sample_every = 0;
+  config.packet_stamps = false;
+  const auto count_only = nll::receiver::loop_policy(config);
+  EXPECT_FALSE(count_only.sampling || count_only.work || count_only.bounded ||
+               count_only.timestamping);
+}
+
+// A datagram as a sender writes it: the header, the v2 schedule, then zero
+// padding, cut to length.
+std::vector<std::byte> encode_datagram(std::uint8_t version, std::uint32_t sequence,
+                                       std::uint64_t sent, std::uint64_t scheduled = 0,
+                                       std::size_t length = 64, std::uint16_t magic = 0x6584,
+                                       std::uint8_t type = nll::msg_type_data) {
+  nll::message_header header{.magic = magic, .version = version, .msg_type = type,
+                             .seq_idx = sequence, .send_unix_ns = sent};
+  nll::message_schedule schedule{.scheduled_unix_ns = scheduled};
+  header.to_network();
+  schedule.to_network();
+  std::vector<std::byte> full(std::max<std::size_t>(length, sizeof(header) + sizeof(schedule)));
+  std::memcpy(full.data(), &header, sizeof(header));
+  std::memcpy(full.data() + sizeof(header), &schedule, sizeof(schedule));
+  full.resize(length);
+  return full;
+}
+
+// Decodes and accounts datagrams as one receive batch, the way ingress does.
+template <nll::receiver::LoopPolicy Policy = nll::receiver::general_loop>
+void receive_batch(nll::receiver::Stats &stats, nll::SequenceTracker &sequences,
+                   nll::receiver::PacketBatch &batch, const std::vector<std::vector<std::byte>> &datagrams,
+                   std::uint64_t receive_real_ns, std::uint64_t receive_mono_ns,
+                   std::uint64_t sample_every) {
+  batch.clear();
+  for (const auto &datagram : datagrams) batch.add(datagram.data(), datagram.size());
+  batch.decode(stats);
+  nll::receiver::account_batch<Policy>(stats, sequences, batch, receive_real_ns, receive_mono_ns,
+                                       sample_every);
+}
+
+TEST(LoopPolicy, CountOnlyProcessingSkipsWorkAndStamps) {
+  constexpr nll::receiver::LoopPolicy count_only{
+      .sampling = false, .work = false, .bounded = false, .timestamping = false};
+  nll::BinaryLogger logger("/dev/null");
+  nll::receiver::WorkKernel work(nll::receiver::WorkModel::compute, 1'000, 4096);
+  const auto checksum = work.checksum();
+  nll::receiver::Stats stats;
+  nll::SequenceTracker sequences;
+  nll::receiver::ProcessingStats processing;
+  nll::receiver::PacketBatch batch;
+  receive_batch<count_only>(stats, sequences, batch, {encode_datagram(1, 0, 0)}, 0, 1'000, 1);
+  ASSERT_EQ(batch.accepted().size(), 1U);
+  EXPECT_TRUE(batch.sampled().empty());
+  EXPECT_EQ(stats.sampled_packets, 0U);
+  const nll::receiver::ReceivedPacket packet{.message = batch.message(batch.accepted()[0]),
+      .receive_real_ns = 0, .receive_mono_ns = 1'000, .sampled = false};
+  nll::receiver::process_packet<count_only>(logger, processing, packet, work);
+  EXPECT_EQ(processing.processed_packets, 1U);
+  EXPECT_EQ(processing.latency_sum_ns, 0U);
+  EXPECT_EQ(processing.first_processing_mono_ns, 1'000U);
+  EXPECT_EQ(work.checksum(), checksum);
+
+  nll::receiver::process_packet(logger, processing, packet, work);
+  EXPECT_NE(work.checksum(), checksum);
+}
+
+TEST(FlowTable, SeparatesInterleavedSourcesAndBoundsTheirCount) {
+  std::vector<nll::FlowTable::Entry> slots(nll::FlowTable::slots_for(2));
+  nll::FlowTable table(slots, 2);
+  const auto first = nll::FlowTable::source_key(0x0100007f, htons(40000));
+  const auto second = nll::FlowTable::source_key(0x0100007f, htons(40001));
+  // Globally 0..9 is dense; per source, first lost 4 and second reordered 5/7.
+  for (const auto &[key, sequence] : {std::pair{first, 0U}, {second, 1U}, {first, 2U},
+                                     {second, 3U}, {second, 7U}, {second, 5U}, {first, 6U},
+                                     {first, 8U}, {second, 9U}})
+    ASSERT_NE(table.observe(key, sequence / 2, sequence), nullptr);
+  EXPECT_EQ(table.flows(), 2U);
+  const auto entry_for = [&](std::uint64_t key) {
+    for (const auto &entry : table.slots())
+      if (entry.key == key) return entry;
+    return nll::FlowTable::Entry{};
+  };
+  EXPECT_EQ(entry_for(first).packets, 4U);
+  EXPECT_EQ(entry_for(first).lost(), 1U);
+  EXPECT_EQ(entry_for(first).gap_events, 1U);
+  EXPECT_EQ(entry_for(first).reordered, 0U);
+  EXPECT_EQ(entry_for(second).lost(), 0U);
+  EXPECT_EQ(entry_for(second).reordered, 1U);
+  EXPECT_EQ(entry_for(second).last_receive_mono_ns, 9U);
+  EXPECT_EQ(nll::FlowTable::port_of(second), htons(40001));
+  EXPECT_EQ(nll::FlowTable::address_of(second), 0x0100007fU);
+
+  EXPECT_EQ(table.observe(nll::FlowTable::source_key(0x0200007f, htons(40000)), 0, 10), nullptr);
+  EXPECT_EQ(table.untracked_packets(), 1U);
+  EXPECT_EQ(table.flows(), 2U);
+}
+
+TEST(LogHistogram, QuantilesStayWithinOneSubBucket) {
+  nll::LogHistogram histogram;
+  EXPECT_EQ(histogram.quantile(.99), 0U);
+  for (std::uint64_t value = 1; value <= 100'000; ++value) histogram.record(value * 1'000);
+  EXPECT_EQ(histogram.count(), 100'000U);
+  EXPECT_EQ(histogram.min(), 1'000U);
+  EXPECT_EQ(histogram.max(), 100'000'000U);
+  for (const double q : {.5, .9, .99, .999}) {
+    const auto exact = static_cast<double>(q * 100'000'000);
+    const auto reported = static_cast<double>(histogram.quantile(q));
+    EXPECT_GE(reported, exact) << q;
+    EXPECT_LE(reported, exact * (1.0 + 1.0 / 16)) << q;
+  }
+  EXPECT_EQ(histogram.quantile(1.0), histogram.max());
+  for (std::uint64_t value : {0ULL, 15ULL, 16ULL, 1'000'000ULL, 1ULL << 50})
+    EXPECT_GE(nll::LogHistogram::bucket_upper(nll::LogHistogram::bucket_index(value)),
+              std::min<std::uint64_t>(value, nll::LogHistogram::bucket_upper(
+                  nll::LogHistogram::bucket_count - 1))) << value;
+
+  nll::LogHistogram other;
+  other.record(7);
+  histogram.merge(other);
+  EXPECT_EQ(histogram.min(), 7U);
+  EXPECT_EQ(histogram.count(), 100'001U);
+}
+
+TEST(HeaderV2, ReceiverMeasuresFromScheduleAndSend) {
+  nll::receiver::Stats stats;
+  nll::SequenceTracker sequences;
+  nll::receiver::PacketBatch batch;
+  // Cut after the shared 16 bytes: a v2 header without its schedule is short.
+  receive_batch(stats, sequences, batch, {encode_datagram(2, 3, 5'000, 1'000, 16)}, 6'000, 1, 0);
+  EXPECT_EQ(stats.short_packets, 1U);
+  EXPECT_TRUE(batch.accepted().empty());
+
+  // The sender ran 4 us behind its schedule: only intent latency shows it.
+  receive_batch(stats, sequences, batch, {encode_datagram(2, 3, 5'000, 1'000)}, 6'000, 2, 0);
+  ASSERT_EQ(batch.accepted().size(), 1U);
+  EXPECT_EQ(batch.scheduled_ns()[0], 1'000U);
+  EXPECT_EQ(batch.message(0).seq_idx, 3U);
+  EXPECT_EQ(stats.header_v2_packets, 1U);
+  EXPECT_EQ(stats.service_latency_ns.max(), 1'000U);
+  EXPECT_EQ(stats.intent_latency_ns.max(), 5'000U);
+  receive_batch(stats, sequences, batch, {encode_datagram(2, 4, 5'000, 1'000)}, 4'000, 3, 0);
+  EXPECT_EQ(stats.negative_latency_samples, 1U);
+  EXPECT_EQ(stats.intent_latency_ns.count(), 2U);
+
+  receive_batch(stats, sequences, batch, {encode_datagram(3, 5, 5'000)}, 6'000, 4, 0);
+  EXPECT_EQ(stats.unsupported_version, 1U);
+  EXPECT_EQ(stats.valid_packets, 2U);
+}
+
+TEST(Interarrival, EveryArrivalFeedsSpacingAndRfc3550Jitter) {
+  nll::receiver::Stats stats;
+  nll::SequenceTracker sequences;
+  nll::receiver::PacketBatch batch;
+  constexpr nll::receiver::LoopPolicy count_only{
+      .sampling = false, .work = false, .bounded = false, .timestamping = false};
+  const std::uint64_t received[] = {10'000, 11'000, 12'500, 13'000};
+  for (std::uint32_t index = 0; index < 4; ++index)
+    receive_batch<count_only>(stats, sequences, batch,
+                              {encode_datagram(1, index, 1'000 * (index + 1))}, 0, received[index], 0);
+  EXPECT_EQ(stats.interarrival_ns.count(), 3U);
+  EXPECT_EQ(stats.interarrival_ns.min(), 500U);
+  EXPECT_EQ(stats.interarrival_ns.max(), 1'500U);
+  // Transit deltas 0, +500, -500: J = 31.25, then 60.55 in RFC 3550 terms.
+  EXPECT_EQ(stats.jitter_samples, 4U);
+  EXPECT_EQ(stats.jitter_q4_ns >> 4, 60U);
+
+  // Datagrams of one batch share its receive stamp: the first carries the
+  // spacing since the last batch, the rest arrived with it.
+  receive_batch<count_only>(stats, sequences, batch,
+                            {encode_datagram(1, 4, 5'000), encode_datagram(1, 5, 6'000),
+                             encode_datagram(1, 6, 7'000)}, 0, 15'000, 0);
+  EXPECT_EQ(stats.interarrival_ns.count(), 6U);
+  EXPECT_EQ(stats.interarrival_ns.min(), 0U);
+  EXPECT_EQ(stats.interarrival_ns.max(), 2'000U);
+  EXPECT_EQ(stats.jitter_samples, 7U);
+}
+
+TEST(PacketBatch, ClassifiesEveryOutcomeAndSamplesByIndex) {
+  nll::receiver::Stats stats;
+  nll::SequenceTracker sequences;
+  nll::receiver::PacketBatch batch;
+  // v1, v2, a 16-byte v1, a duplicate, a clock probe, then short, bad-magic,
+  // unknown-version and truncated-v2 rejects, and v2 without a schedule.
+  receive_batch(stats, sequences, batch,
+                {encode_datagram(1, 0, 1'000), encode_datagram(2, 1, 2'000, 1'500),
+                 encode_datagram(1, 2, 0, 0, 16), encode_datagram(1, 1, 2'000),
+                 encode_datagram(1, 9, 3'000, 0, 48, 0x6584, nll::msg_type_clock_probe),
+                 encode_datagram(1, 3, 3'000, 0, 10), encode_datagram(1, 4, 4'000, 0, 64, 0x1234),
+                 encode_datagram(3, 5, 5'000), encode_datagram(2, 6, 6'000, 5'000, 20),
+                 encode_datagram(2, 8, 7'000, 0, 24)},
+                8'000, 10'000, 2);
+  EXPECT_EQ(std::vector<std::uint16_t>(batch.accepted().begin(), batch.accepted().end()),
+            (std::vector<std::uint16_t>{0, 1, 2, 3, 9}));
+  EXPECT_EQ(std::vector<std::uint16_t>(batch.probes().begin(), batch.probes().end()),
+            std::vector<std::uint16_t>{4});
+  // Even sequences of the accepted: 0, 2 and 8.
+  EXPECT_EQ(std::vector<std::uint16_t>(batch.sampled().begin(), batch.sampled().end()),
+            (std::vector<std::uint16_t>{0, 2, 9}));
+  EXPECT_EQ(stats.sampled_packets, 3U);
+  EXPECT_EQ(stats.short_packets, 2U);
+  EXPECT_EQ(stats.invalid_magic, 1U);
+  EXPECT_EQ(stats.unsupported_version, 1U);
+  EXPECT_EQ(stats.header_v2_packets, 2U);
+  EXPECT_EQ(stats.valid_packets, 5U);
+  EXPECT_EQ(batch.scheduled_ns()[1], 1'500U);
+  EXPECT_EQ(batch.scheduled_ns()[9], 0U);
+  EXPECT_EQ(batch.send_ns()[3], 2'000U);
+  // Send stamps 1000, 2000, 2000 and 7000 are measured; the zero one is not.
+  EXPECT_EQ(stats.service_latency_ns.count(), 4U);
+  EXPECT_EQ(stats.intent_latency_ns.count(), 1U);
+  EXPECT_EQ(stats.intent_latency_ns.max(), 6'500U);
+  EXPECT_EQ(stats.jitter_samples, 4U);
+  EXPECT_EQ(stats.interarrival_ns.count(), 4U);
+  EXPECT_EQ(stats.interarrival_ns.max(), 0U);
+  EXPECT_EQ(sequences.unique(), 4U);
+  EXPECT_EQ(sequences.duplicates(), 1U);
+  EXPECT_EQ(sequences.gaps(), 5U);  // 3..7
+
+  // Whichever swap was selected agrees with message_header::to_host.
+  nll::receiver::batch_detail::HeaderRow vector_rows[3], portable_rows[3];
+  for (std::size_t index = 0; index < std::size(vector_rows); ++index)
+    for (std::size_t byte = 0; byte < vector_rows[index].size(); ++byte)
+      vector_rows[index][byte] = portable_rows[index][byte] = std::byte(index * 16 + byte * 7 + 1);
+  nll::receiver::batch_detail::selected()(vector_rows, std::size(vector_rows));
+  nll::receiver::batch_detail::portable(portable_rows, std::size(portable_rows));
+  for (std::size_t index = 0; index < std::size(vector_rows); ++index)
+    EXPECT_EQ(vector_rows[index], portable_rows[index]) << index;
+}
+
+TEST(KernelDrops, RisesInTheCounterAreAttributedBetweenSequences) {
+  nll::receiver::KernelDropTimeline timeline;
+  timeline.observe(2, 5, 100);  // two dropped before the first datagram read
+  timeline.observe(2, 6, 110);
+  timeline.observe(9, 14, 120);
+  timeline.observe(9, 15, 130);
+  EXPECT_EQ(timeline.dropped(), 9U);
+  ASSERT_EQ(timeline.retained(), 2U);
+  EXPECT_TRUE(timeline.event(0).at_start);
+  EXPECT_EQ(timeline.event(1).after_sequence, 6U);
+  EXPECT_EQ(timeline.event(1).before_sequence, 14U);
+  EXPECT_EQ(timeline.event(1).dropped, 7U);
+  EXPECT_EQ(timeline.event(1).revealed_ns, 120U);
+  // The 32-bit counter wraps; the difference still holds.
+  timeline.observe(3, 20, 140);
+  EXPECT_EQ(timeline.event(2).dropped, 3U - 9U);
+
+  alignas(cmsghdr) std::byte buffer[CMSG_SPACE(sizeof(std::uint32_t))]{};
+  msghdr message{};
+  message.msg_control = buffer;
+  message.msg_controllen = sizeof(buffer);
+  EXPECT_EQ(nll::receiver::drop_counter(msghdr{}), 0U);
+  auto *control = CMSG_FIRSTHDR(&message);
+  control->cmsg_level = SOL_SOCKET;
+  control->cmsg_type = SO_RXQ_OVFL;
+  control->cmsg_len = CMSG_LEN(sizeof(std::uint32_t));
+  const std::uint32_t counter = 42;
+  std::memcpy(CMSG_DATA(control), &counter, sizeof(counter));
+  EXPECT_EQ(nll::receiver::drop_counter(message), 42U);
+}
+
+TEST(SocketMemory, SamplesQueuedBytesAgainstTheReceiveBuffer) {
+  const int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(fd, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  ASSERT_EQ(::bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)), 0);
+  ASSERT_EQ(::getsockname(fd, reinterpret_cast<sockaddr *>(&address), &length), 0);
+
+  nll::receiver::SocketMemoryStats stats;
+  nll::receiver::SocketMemorySampler idle(fd, 0);
+  idle.tick(1'000, stats);
+  EXPECT_FALSE(idle.enabled());
+  EXPECT_EQ(stats.occupancy_bytes.count(), 0U);
+
+  nll::receiver::SocketMemorySampler sampler(fd, 1'000);
+  sampler.tick(5'000, stats);  // empty queue
+  const char payload[256] = {};
+  for (int i = 0; i < 4; ++i)
+    ASSERT_EQ(::sendto(fd, payload, sizeof(payload), 0, reinterpret_cast<const sockaddr *>(&address),
+                       sizeof(address)), static_cast<ssize_t>(sizeof(payload)));
+  sampler.tick(5'500, stats);  // within the interval: skipped
+  sampler.tick(6'000, stats);
+  ::close(fd);
+  EXPECT_EQ(stats.failures, 0U);
+  ASSERT_EQ(stats.occupancy_bytes.count(), 2U);
+  EXPECT_EQ(stats.occupancy_bytes.min(), 0U);
+  // Charged at truesize, so more than the payload itself.
+  EXPECT_GE(stats.occupancy_bytes.max(), 4 * sizeof(payload));
+  EXPECT_GT(stats.receive_buffer_bytes, 0U);
+}
+
+TEST(AsyncLog, RendersCapturedArgumentsAsPrintfWould) {
+  nll::log::LogRecord record;
+  record.format = "%s=%d %u %-5ld|%llx %.3f %*d %c";
+  const std::string name = "port";
+  nll::log::detail::capture(record, name.c_str());
+  nll::log::detail::capture(record, -42);
+  nll::log::detail::capture(record, 7U);
+  nll::log::detail::capture(record, 12L);
+  nll::log::detail::capture(record, 0xABCULL);
+  nll::log::detail::capture(record, 1.5);
+  nll::log::detail::capture(record, 4);
+  nll::log::detail::capture(record, static_cast<short>(9));
+  char expected[256];
+  char rendered[256];
+  // Eight arguments fill the record; the %c has none left and stays literal.
+  std::snprintf(expected, sizeof(expected), "%s=%d %u %-5ld|%llx %.3f %*d %%c", "port", -42, 7U,
+                12L, 0xABCULL, 1.5, 4, 9);
+  nll::log::render(record, rendered, sizeof(rendered));
+  EXPECT_STREQ(rendered, expected);
+
+  const void *pointer = &record;
+  nll::log::LogRecord rest;
+  rest.format = "%c %s %p 100%%";
+  nll::log::detail::capture(rest, 'x');
+  nll::log::detail::capture(rest, static_cast<const char *>(nullptr));
+  nll::log::detail::capture(rest, pointer);
+  std::snprintf(expected, sizeof(expected), "%c %s %p 100%%", 'x', "(null)", pointer);
+  nll::log::render(rest, rendered, sizeof(rendered));
+  EXPECT_STREQ(rendered, expected);
+
+  // Strings past the record's capacity are truncated, never overrun.
+  const std::string long_text(400, 'a');
+  nll::log::LogRecord truncated;
+  truncated.format = "%s|%s";
+  nll::log::detail::capture(truncated, long_text.c_str());
+  nll::log::detail::capture(truncated, "b");
+  nll::log::render(truncated, rendered, sizeof(rendered));
+  EXPECT_EQ(std::string(rendered), std::string(nll::log::LogRecord::string_capacity - 1, 'a') + "|");
+}
+
+TEST(AsyncLog, WritesEveryThreadsRecordsAndCountsDrops) {
+  std::FILE *out = std::tmpfile();
+  ASSERT_NE(out, nullptr);
+  const auto sink = [](std::FILE *file, int level, std::uint64_t, const char *text) {
+    std::fprintf(file, "%d %s", level, text);
+  };
+  {
+    nll::log::AsyncLogger logger(out, sink);
+    // Not started: nothing drains, so the ring fills and the rest are dropped.
+    for (std::size_t index = 0; index < nll::log::AsyncLogger::ring_capacity + 9; ++index)
+      EXPECT_TRUE(logger.push(2, 0, "queued %zu\n", index));
+    EXPECT_EQ(logger.dropped(), 10U);
+    EXPECT_EQ(logger.drain(), nll::log::AsyncLogger::ring_capacity - 1);
+
+    logger.start();
+    std::thread other([&] {
+      for (int index = 0; index < 100; ++index) logger.push(1, 0, "other %d\n", index);
+    });
+    for (int index = 0; index < 100; ++index) logger.push(3, 0, "main %d\n", index);
+    other.join();
+    logger.stop();
+  }
+  std::rewind(out);
+  char line[128];
+  std::size_t lines = 0, other_lines = 0, drop_reports = 0;
+  while (std::fgets(line, sizeof(line), out)) {
+    ++lines;
+    if (std::strncmp(line, "1 other ", 8) == 0) ++other_lines;
+    if (std::strstr(line, "10 log messages dropped")) ++drop_reports;
+  }
+  std::fclose(out);
+  EXPECT_EQ(other_lines, 100U);
+  EXPECT_EQ(drop_reports, 1U);
+  EXPECT_EQ(lines, nll::log::AsyncLogger::ring_capacity - 1 + 200 + 1);
+}
+
+TEST(AsyncLog, EverySenderWorkerCanRegisterARingUpFront) {
+  std::FILE *out = std::tmpfile();
+  ASSERT_NE(out, nullptr);
+  {
+    nll::log::AsyncLogger logger(out, [](std::FILE *, int, std::uint64_t, const char *) {});
+    // --threads 128, the main thread and a few helpers.
+    std::atomic<std::size_t> registered{0};
+    std::vector<std::thread> threads;
+    for (int index = 0; index < 128 + 4; ++index)
+      threads.emplace_back([&] { registered += logger.register_thread() ? 1 : 0; });
+    for (auto &thread : threads) thread.join();
+    EXPECT_EQ(registered.load(), 128U + 4U);
+    // Registered, so this push takes the ring rather than the synchronous path.
+    EXPECT_TRUE(logger.register_thread());
+    EXPECT_TRUE(logger.push(2, 0, "ready\n"));
+    EXPECT_EQ(logger.drain(), 1U);
+  }
+  std::fclose(out);
+}
+
+TEST(ClockSync, RoundsYieldOffsetAndDelayAndTheFitRecoversDrift) {
+  // Receiver 40 us ahead, 30 us each way, 5 us turnaround.
+  nll::clock_sync::Sample sample{.round = 1, .local_mono_ns = 0, .t1 = 1'000'000,
+      .t2 = 1'070'000, .t3 = 1'075'000, .t4 = 1'065'000};
+  ASSERT_TRUE(nll::clock_sync::complete(sample));
+  EXPECT_EQ(sample.offset_ns, 40'000);
+  EXPECT_EQ(sample.delay_ns, 60'000U);
+  auto broken = sample;
+  broken.t4 = broken.t1 + 1'000;  // returned before the receiver turned around
+  EXPECT_FALSE(nll::clock_sync::complete(broken));
+  broken.t4 = 0;
+  EXPECT_FALSE(nll::clock_sync::complete(broken));
+
+  // 10 Hz rounds on a 500 ppb drift; every fourth queued behind the load with
+  // a lopsided extra 400 us outbound, which the delay filter must discard.
+  nll::clock_sync::Estimator estimator;
+  for (std::uint32_t round = 0; round < 100; ++round) {
+    const std::uint64_t now = 1'000'000'000ULL + round * 100'000'000ULL;
+    const std::int64_t offset = 40'000 + static_cast<std::int64_t>(round) * 50;  // 500 ns/s
+    const std::uint64_t queued = round % 4 == 3 ? 400'000 : 0;
+    nll::clock_sync::Sample round_sample{.round = round, .local_mono_ns = now, .t1 = now,
+        .t2 = now + 30'000 + queued + offset, .t3 = now + 35'000 + queued + offset,
+        .t4 = now + 65'000 + queued};
+    ASSERT_TRUE(nll::clock_sync::complete(round_sample));
+    estimator.add(round_sample);
+  }
+  const auto &estimate = estimator.estimate();
+  EXPECT_NEAR(estimate.drift_ppb, 500.0, 1.0);
+  EXPECT_NEAR(static_cast<double>(estimate.offset_ns), 40'000 + 99 * 50, 20.0);
+  EXPECT_EQ(estimate.used, 48U);  // 64 held, the 16 queued rounds filtered
+  EXPECT_EQ(estimator.minimum_delay_ns(), 60'000U);
+  EXPECT_EQ(estimator.samples(), 100U);
+}
+
+TEST(ClockResponder, LogsRoundsAcrossChunksInOrder) {
+  nll::receiver::ClockResponder responder;
+  responder.enable();
+  sockaddr_in source{};
+  source.sin_family = AF_INET;
+  // t3 is stamped on the real clock inside handle(), so t1/t2 sit just before
+  // it and each round's t4, carried by the next probe, well after.
+  const auto base = nll::stamp_real_ns() - 1'000'000;
+  const auto rounds = nll::receiver::ClockResponder::chunk_rounds + 3;
+  for (std::uint32_t round = 1; round <= rounds + 1; ++round) {
+    nll::message_header message{.magic = 0x6584, .version = nll::message_version_v1,
+                                .msg_type = nll::msg_type_clock_probe, .seq_idx = round,
+                                .send_unix_ns = base + round};
+    nll::clock_exchange exchange{.previous_round = round - 1, .reserved = 0, .origin_unix_ns = 0,
+                                 .receive_unix_ns = 0,
+                                 .previous_return_unix_ns = base + 60'000'000'000ULL};
+    auto wire = message;
+    wire.to_network();
+    exchange.to_network();
+    std::byte datagram[sizeof(wire) + sizeof(exchange)];
+    std::memcpy(datagram, &wire, sizeof(wire));
+    std::memcpy(datagram + sizeof(wire), &exchange, sizeof(exchange));
+    responder.handle(-1, datagram, sizeof(datagram), &source, message, base + round, round);
+  }
+  EXPECT_EQ(responder.logged_rounds(), rounds);
+  EXPECT_EQ(responder.reply_failures(), rounds + 1);  // no socket to reply on
+  const auto path = std::filesystem::temp_directory_path() / "nll_clock_log_test.csv";
+  ASSERT_TRUE(responder.write_log(path));
+  std::ifstream log(path);
+  std::string line;
+  std::getline(log, line);
+  std::getline(log, line);
+  std::uint32_t expected = 1, lines = 0;
+  while (std::getline(log, line)) {
+    EXPECT_EQ(std::stoul(line.substr(0, line.find(','))), expected++);
+    ++lines;
+  }
+  EXPECT_EQ(lines, rounds);
+  std::filesystem::remove(path);
+}
+
+TEST(PacketCapture, WritesSampledDatagramsAsPcapng) {
+  const auto path = std::filesystem::temp_directory_path() / "nll_capture_test.pcapng";
+  sockaddr_in source{};
+  source.sin_family = AF_INET;
+  source.sin_addr.s_addr = htonl(0x0a000001);
+  source.sin_port = htons(40000);
+  const std::vector<std::byte> payload(300, std::byte{0x5a});
+  {
+    nll::receiver::PacketCapture capture(path, 128, 2, 49200);
+    ASSERT_TRUE(capture.enabled());
+    // A receiver's monotonic stamps are far from zero; the first block is due
+    // flush_interval_ns after its first datagram, not after boot.
+    constexpr std::uint64_t mono_start = 5'000'000'000ULL;
+    for (std::uint64_t index = 0; index < 10; ++index) {
+      capture.record(payload.data(), 100 + index, &source, 1'000'000'000ULL + index * 1'000,
+                     mono_start + index);
+      capture.tick(mono_start + index + 1'000);  // the block is not due yet
+    }
+    EXPECT_TRUE(capture.finish());
+    EXPECT_EQ(capture.stats().captured, 5U);
+    EXPECT_EQ(capture.stats().dropped, 0U);
+    EXPECT_EQ(capture.stats().blocks_written, 1U);
+    EXPECT_EQ(capture.stats().write_errors, 0U);
+    EXPECT_EQ(capture.stats().bytes_written, std::filesystem::file_size(path));
+  }
+  // The sender's replay reader decodes the rebuilt IPv4 and UDP headers; the
+  // UDP length survives the snap length.
+  std::vector<nll::sender::ReplayPacket> packets;
+  nll::sender::CaptureSummary summary;
+  ASSERT_TRUE(nll::sender::read_capture(path, packets, summary));
+  EXPECT_STREQ(summary.format, "pcapng");
+  EXPECT_EQ(summary.link_type, 228U);
+  ASSERT_EQ(packets.size(), 5U);
+  for (std::size_t index = 0; index < packets.size(); ++index) {
+    EXPECT_EQ(packets[index].payload_bytes, 101 + 2 * index);
+    EXPECT_EQ(packets[index].capture_ns, 1'000'000'000ULL + (2 * index + 1) * 1'000);
+  }
+  std::ifstream input(path, std::ios::binary);
+  const std::vector<unsigned char> bytes((std::istreambuf_iterator<char>(input)), {});
+  constexpr std::size_t first_packet = 28 + 32;  // after the section and interface blocks
+  ASSERT_GT(bytes.size(), first_packet + 64);
+  std::uint32_t interface_snaplen = 0;
+  std::memcpy(&interface_snaplen, bytes.data() + 28 + 12, sizeof(interface_snaplen));
+  EXPECT_EQ(interface_snaplen, 128U);
+  std::uint32_t captured = 0;
+  std::memcpy(&captured, bytes.data() + first_packet + 20, sizeof(captured));
+  EXPECT_EQ(captured, 128U);
+  const auto *ip = bytes.data() + first_packet + 28;
+  EXPECT_EQ(ip[0], 0x45);
+  EXPECT_EQ(std::vector<unsigned char>(ip + 12, ip + 16), (std::vector<unsigned char>{10, 0, 0, 1}));
+  EXPECT_EQ((ip[22] << 8) | ip[23], 49200);
+  EXPECT_EQ(ip[28], 0x5a);
+  std::filesystem::remove(path);
+}
+
+TEST(WorkKernel, EveryModelCalibratesToAFixedUnitCount) {
+  using nll::receiver::WorkModel;
+  for (const auto model : {WorkModel::hash, WorkModel::chase, WorkModel::compute}) {
+    nll::receiver::WorkKernel kernel(model, 2'000, 64 * 1024);
+    const auto calibration = kernel.calibration();
+    EXPECT_FALSE(kernel.idle());
+    EXPECT_GT(calibration.ns_per_unit, 0.0) << nll::receiver::work_model_name(model);
+    EXPECT_GE(calibration.units_per_packet, 1U) << nll::receiver::work_model_name(model);
+    nll::message_header message{.magic = 0x6584, .version = 1, .msg_type = 0,
+                                .seq_idx = 7, .send_unix_ns = 11};
+    const auto before = kernel.checksum();
+    kernel.run(message);
+    message.seq_idx = 8;
+    kernel.run(message);
+    // The payload feeds the key, so distinct datagrams leave distinct traces.
+    EXPECT_NE(kernel.checksum(), before) << nll::receiver::work_model_name(model);
+  }
+  nll::receiver::WorkKernel spin(WorkModel::spin, 1'000, 0);
+  EXPECT_EQ(spin.calibration().units_per_packet, 0U);
+  EXPECT_TRUE(nll::receiver::WorkKernel(WorkModel::hash, 0, 4096).idle());
+}
+
 TEST(SenderPacing, IntegerDeadlinesAndAdaptiveBatchesDoNotDrift) {
   constexpr std::uint64_t start = 123'456'789;
   EXPECT_EQ(nll::sender::deadline_ns(start, 950'000, 950'000),
@@ -173,6 +959,15 @@ TEST(SenderPacing, IntegerDeadlinesAndAdaptiveBatchesDoNotDrift) {
             2U);
   EXPECT_EQ(nll::sender::adaptive_batch_count(0, 1000, 2, 950'000, 64, 10'000),
             5U);
+  // The division-free walk lands on deadline_ns() at every step.
+  for (const auto &[first, stride, rate] : {std::tuple{0ULL, 1ULL, 950'000ULL},
+                                            {7ULL, 3ULL, 150'000ULL},
+                                            {(1ULL << 40) + 5, 128ULL, 999'983ULL}}) {
+    nll::sender::DeadlineWalk walk(start, first, stride, rate);
+    for (std::uint64_t step = 0; step < 5'000; ++step, walk.advance())
+      ASSERT_EQ(walk.deadline_ns(), nll::sender::deadline_ns(start, first + step * stride, rate))
+          << first << " " << stride << " " << step;
+  }
 }
 
 // The scheduling window, not --send-batch-max, sets the batch size whenever
@@ -218,4 +1013,490 @@ TEST(SenderSubmission, AtomicRangesAreUniqueAndContiguous) {
   EXPECT_EQ(next.load(), 64U);
 }
 
+TEST(SenderFlows, EveryFlowHasOneOwnerAndDistinctPort) {
+  constexpr std::uint32_t flows = 10, threads = 4;
+  std::vector<std::uint32_t> owned(threads, 0);
+  for (std::uint32_t flow = 0; flow < flows; ++flow) ++owned[nll::sender::flow_owner(flow, threads)];
+  for (std::uint32_t worker = 0; worker < threads; ++worker)
+    EXPECT_EQ(owned[worker], nll::sender::flows_of_worker(worker, flows, threads));
+  EXPECT_EQ(owned, (std::vector<std::uint32_t>{3, 3, 2, 2}));
+  EXPECT_EQ(nll::sender::flow_source_port(40000, 0), 40000);
+  EXPECT_EQ(nll::sender::flow_source_port(65530, 5), 65535);
+
+  nll::flow_tag tag{.flow_id = 0x0102, .reserved = 0, .flow_sequence = 0x03040506};
+  tag.to_network();
+  const auto *bytes = reinterpret_cast<const unsigned char *>(&tag);
+  EXPECT_EQ(bytes[0], 0x01);
+  EXPECT_EQ(bytes[1], 0x02);
+  EXPECT_EQ(bytes[4], 0x03);
+  EXPECT_EQ(bytes[7], 0x06);
+  tag.to_host();
+  EXPECT_EQ(tag.flow_id, 0x0102);
+  EXPECT_EQ(tag.flow_sequence, 0x03040506U);
+}
+
+TEST(RateSchedule, FollowsProfilesWithoutDrift) {
+  using nll::sender::RatePoint;
+  using nll::sender::RateSchedule;
+  constexpr std::uint64_t second = 1'000'000'000ULL;
+  // A constant profile reproduces the exact constant-rate deadlines.
+  const RatePoint constant[] = {{0.0, 950'000.0}};
+  const RateSchedule steady(constant, 2 * second);
+  EXPECT_EQ(steady.packet_count(), nll::sender::scheduled_packet_count(2 * second, 950'000));
+  std::size_t cursor = 0;
+  for (std::uint64_t index = 0; index < steady.packet_count(); index += 997) {
+    const auto expected = nll::sender::deadline_ns(0, index, 950'000);
+    const auto actual = steady.offset_ns(index, cursor);
+    EXPECT_LE(actual > expected ? actual - expected : expected - actual, 1U) << index;
+  }
+  cursor = 0;
+  EXPECT_EQ(steady.batch_count(0, 1, 64, 10'000, cursor),
+            nll::sender::adaptive_batch_count(0, steady.packet_count(), 1, 950'000, 64, 10'000));
+
+  std::vector<RatePoint> points;
+  ASSERT_TRUE(nll::sender::parse_rate_profile("step:1000:3000:0.5", 1.0, points));
+  const RateSchedule step(points, second);
+  EXPECT_EQ(step.packet_count(), 2'000U);
+  EXPECT_EQ(step.peak_rate_pps(), 3'000U);
+  cursor = 0;
+  EXPECT_EQ(step.offset_ns(500, cursor), second / 2);
+  EXPECT_EQ(step.rate_pps(cursor), 3'000U);
+  EXPECT_NEAR(static_cast<double>(step.offset_ns(503, cursor)), 0.501e9, 1.0);
+  // Walking backwards still finds the right segment.
+  EXPECT_NEAR(static_cast<double>(step.offset_ns(10, cursor)), 0.010e9, 1.0);
+
+  // Under a ramp from 0 the first N packets take sqrt(N / 1000) seconds.
+  ASSERT_TRUE(nll::sender::parse_rate_profile("ramp:0:2000", 1.0, points));
+  const RateSchedule ramp(points, second);
+  EXPECT_EQ(ramp.packet_count(), 1'000U);
+  cursor = 0;
+  EXPECT_NEAR(static_cast<double>(ramp.offset_ns(250, cursor)), 0.5e9, 1e6);
+
+  ASSERT_TRUE(nll::sender::parse_rate_profile("sine:1000:500:0.25", 1.0, points));
+  EXPECT_NEAR(static_cast<double>(RateSchedule(points, second).packet_count()), 1'000.0, 2.0);
+
+  for (const char *invalid : {"ramp:1", "step:1:2", "sine:10:20:1", "sine:10:5:0", "pulse:1:2",
+                              "ramp:-1:5", "file:", "file:/nonexistent/profile.csv"})
+    EXPECT_FALSE(nll::sender::parse_rate_profile(invalid, 1.0, points)) << invalid;
+}
+
+// Little- or big-endian integer fields for the hand-built captures below.
+void append_bytes(std::vector<unsigned char> &out, std::uint64_t value, std::size_t size,
+                  bool big_endian = false) {
+  for (std::size_t index = 0; index < size; ++index)
+    out.push_back(static_cast<unsigned char>(value >> (8 * (big_endian ? size - 1 - index : index))));
+}
+
+// IPv4 header and UDP header for a datagram of payload bytes, cut short the
+// way a small snaplen would.
+std::vector<unsigned char> ipv4_datagram(std::uint16_t payload, std::uint8_t protocol = 17) {
+  std::vector<unsigned char> packet(28 + std::min<std::size_t>(payload, 16), 0x5a);
+  std::fill_n(packet.begin(), 28, 0);
+  packet[0] = 0x45;
+  packet[9] = protocol;
+  packet[24] = static_cast<unsigned char>((payload + 8) >> 8);
+  packet[25] = static_cast<unsigned char>((payload + 8) & 0xff);
+  return packet;
+}
+
+TEST(PcapReplay, ReadsCapturesAndSchedulesTheirGaps) {
+  const auto directory = std::filesystem::temp_directory_path();
+  // Classic pcap, microseconds, Ethernet, one VLAN-tagged frame and one TCP segment.
+  std::vector<unsigned char> pcap;
+  for (const auto &[value, size] : {std::pair{0xa1b2c3d4ULL, 4}, {2, 2}, {4, 2}, {0, 4}, {0, 4},
+                                    {65535, 4}, {1, 4}})
+    append_bytes(pcap, value, size);
+  const auto add_frame = [&](std::uint64_t microseconds, bool vlan, const std::vector<unsigned char> &ip) {
+    std::vector<unsigned char> frame(12, 0);
+    if (vlan) frame.insert(frame.end(), {0x81, 0x00, 0x00, 0x07});
+    frame.insert(frame.end(), {0x08, 0x00});
+    frame.insert(frame.end(), ip.begin(), ip.end());
+    append_bytes(pcap, 10 + microseconds / 1'000'000, 4);
+    append_bytes(pcap, microseconds % 1'000'000, 4);
+    append_bytes(pcap, frame.size(), 4);
+    append_bytes(pcap, frame.size(), 4);
+    pcap.insert(pcap.end(), frame.begin(), frame.end());
+  };
+  add_frame(0, false, ipv4_datagram(100));
+  add_frame(250, true, ipv4_datagram(20));
+  add_frame(250, false, ipv4_datagram(20, 6));
+  add_frame(1000, false, ipv4_datagram(1400));
+  const auto pcap_path = directory / "nll_replay_test.pcap";
+  std::ofstream(pcap_path, std::ios::binary).write(reinterpret_cast<const char *>(pcap.data()),
+                                                   static_cast<std::streamsize>(pcap.size()));
+
+  std::vector<nll::sender::ReplayPacket> packets;
+  nll::sender::CaptureSummary summary;
+  ASSERT_TRUE(nll::sender::read_capture(pcap_path, packets, summary));
+  EXPECT_STREQ(summary.format, "pcap");
+  EXPECT_EQ(summary.link_type, 1U);
+  EXPECT_EQ(summary.records, 4U);
+  EXPECT_EQ(summary.skipped_records, 1U);
+  ASSERT_EQ(packets.size(), 3U);
+  EXPECT_EQ(packets[1].capture_ns - packets[0].capture_ns, 250'000U);
+  EXPECT_EQ(packets[2].payload_bytes, 1400U);
+
+  // Twice as fast, with the 20-byte datagram padded to a 24-byte header.
+  const nll::sender::ReplaySchedule fast(packets, 2.0, false, 1'000'000'000ULL, 24);
+  EXPECT_EQ(fast.packet_count(), 3U);
+  EXPECT_EQ(fast.offset_ns(1), 125'000U);
+  EXPECT_EQ(fast.offset_ns(2), 500'000U);
+  EXPECT_EQ(fast.payload_bytes(1), 24U);
+  EXPECT_EQ(fast.padded(), 1U);
+  EXPECT_EQ(fast.largest_payload(), 1400U);
+  EXPECT_EQ(fast.batch_count(0, 1, 8, 200'000), 2U);
+  EXPECT_EQ(fast.batch_count(1, 2, 8, 1'000'000), 1U);
+
+  // Looping repeats the trace one mean gap after its last packet, until the duration.
+  const nll::sender::ReplaySchedule looped(packets, 1.0, true, 3'000'000, 24);
+  EXPECT_EQ(looped.loop_period_ns(), 1'500'000U);
+  EXPECT_EQ(looped.packet_count(), 6U);
+  EXPECT_EQ(looped.offset_ns(4), 1'750'000U);
+  EXPECT_EQ(looped.payload_bytes(5), 1400U);
+  EXPECT_EQ(looped.mean_rate_pps(), 2'000U);
+  EXPECT_EQ(looped.peak_rate_pps(), 2'000U);
+  EXPECT_EQ(nll::sender::ReplaySchedule(packets, 1.0, false, 500'000, 24).packet_count(), 2U);
+
+  // Big-endian pcapng: Linux cooked capture, nanosecond if_tsresol, and a
+  // packet stamped before its predecessor.
+  std::vector<unsigned char> pcapng;
+  for (const auto &[value, size] : {std::pair{0x0a0d0d0aULL, 4}, {28, 4}, {0x1a2b3c4d, 4}, {1, 2},
+                                    {0, 2}, {~0ULL, 8}, {28, 4},
+                                    {1, 4}, {32, 4}, {113, 2}, {0, 2}, {65535, 4},
+                                    {9, 2}, {1, 2}, {0x09000000, 4}, {0, 4}, {32, 4}})
+    append_bytes(pcapng, value, size, true);
+  for (const auto &[nanoseconds, payload] : {std::pair{5'000'000'000ULL, 64}, {5'000'002'000ULL, 32},
+                                             {5'000'001'000ULL, 48}}) {
+    std::vector<unsigned char> frame(14, 0);
+    frame.insert(frame.end(), {0x08, 0x00});
+    const auto ip = ipv4_datagram(static_cast<std::uint16_t>(payload));
+    frame.insert(frame.end(), ip.begin(), ip.end());
+    const auto padded = (frame.size() + 3) / 4 * 4;
+    for (const auto &[value, size] : {std::pair{6ULL, 4}, {32 + padded, 4}, {0, 4},
+                                      {nanoseconds >> 32, 4}, {nanoseconds & 0xffffffff, 4},
+                                      {frame.size(), 4}, {frame.size(), 4}})
+      append_bytes(pcapng, value, size, true);
+    frame.resize(padded, 0);
+    pcapng.insert(pcapng.end(), frame.begin(), frame.end());
+    append_bytes(pcapng, 32 + padded, 4, true);
+  }
+  const auto pcapng_path = directory / "nll_replay_test.pcapng";
+  std::ofstream(pcapng_path, std::ios::binary).write(reinterpret_cast<const char *>(pcapng.data()),
+                                                     static_cast<std::streamsize>(pcapng.size()));
+  ASSERT_TRUE(nll::sender::read_capture(pcapng_path, packets, summary));
+  EXPECT_STREQ(summary.format, "pcapng");
+  EXPECT_EQ(summary.link_type, 113U);
+  ASSERT_EQ(packets.size(), 3U);
+  EXPECT_EQ(packets[1].capture_ns, 5'000'002'000ULL);
+  EXPECT_EQ(packets[2].payload_bytes, 48U);
+  const nll::sender::ReplaySchedule merged(packets, 1.0, false, 1'000'000'000ULL, 16);
+  EXPECT_EQ(merged.reordered(), 1U);
+  EXPECT_EQ(merged.offset_ns(2), 2'000U);
+
+  // A capture cut mid-record, and a file that is not a capture, are rejected.
+  pcap.resize(pcap.size() - 3);
+  std::ofstream(pcap_path, std::ios::binary | std::ios::trunc).write(
+      reinterpret_cast<const char *>(pcap.data()), static_cast<std::streamsize>(pcap.size()));
+  EXPECT_FALSE(nll::sender::read_capture(pcap_path, packets, summary));
+  std::ofstream(pcapng_path, std::ios::trunc) << "not a capture\n";
+  EXPECT_FALSE(nll::sender::read_capture(pcapng_path, packets, summary));
+  std::filesystem::remove(pcap_path);
+  std::filesystem::remove(pcapng_path);
+}
+
+TEST(CapacitySearch, BisectsToTheHighestPassingRate) {
+  const auto search_for = [](std::uint64_t threshold) {
+    nll::sender::CapacitySearch search(1000, 100000, 0.01);
+    while (const auto rate = search.next()) search.record(*rate, *rate <= threshold);
+    return search;
+  };
+  const auto bounded = search_for(37000);
+  EXPECT_LE(bounded.capacity(), 37000U);
+  EXPECT_GE(bounded.capacity(), 37000U - 370U);
+  EXPECT_LE(bounded.trials(), 12U);
+  EXPECT_EQ(search_for(200000).capacity(), 100000U);
+  EXPECT_EQ(search_for(200000).trials(), 1U);
+  EXPECT_EQ(search_for(500).capacity(), 0U);
+  EXPECT_EQ(search_for(500).trials(), 2U);
+
+  nll::control::reply before{}, after{};
+  before.unique_valid_packets = 100;
+  after.unique_valid_packets = 1090;
+  after.processed_packets = 990;
+  after.processing_latency_sum_ns = 990 * 2000;
+  const auto lossy = nll::sender::judge_trial(1000, 1000, 1000, 1000, 0, before, after, 0.0);
+  EXPECT_EQ(lossy.lost, 10U);
+  EXPECT_DOUBLE_EQ(lossy.mean_processing_latency_ns, 2000.0);
+  EXPECT_FALSE(lossy.passed);
+  EXPECT_TRUE(nll::sender::judge_trial(1000, 1000, 1000, 1000, 0, before, after, 0.01).passed);
+  const auto late = nll::sender::judge_trial(1000, 1000, 900, 900, 0, before, after, 0.5);
+  EXPECT_TRUE(late.sender_limited);
+  EXPECT_FALSE(late.passed);
+}
+
+TEST(CapacitySearch, QueueOverflowFailsTheTrial) {
+  // Every datagram reached ingress, but the worker's queue dropped three.
+  nll::control::reply before{}, after{};
+  before.unique_valid_packets = 100;
+  before.spsc_overflow = 2;
+  after.unique_valid_packets = 1100;
+  after.spsc_overflow = 5;
+  const auto overflowed = nll::sender::judge_trial(1000, 1000, 1000, 1000, 0, before, after, 0.0);
+  EXPECT_EQ(overflowed.spsc_overflow, 3U);
+  EXPECT_EQ(overflowed.lost, 3U);
+  EXPECT_FALSE(overflowed.passed);
+}
+
+TEST(ControlServer, AnswersWithTheLastPublishedTotals) {
+  // A port the kernel just handed out, so the server can bind it.
+  const int probe = ::socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(::bind(probe, reinterpret_cast<sockaddr *>(&address), sizeof(address)), 0);
+  socklen_t length = sizeof(address);
+  ASSERT_EQ(::getsockname(probe, reinterpret_cast<sockaddr *>(&address), &length), 0);
+  ::close(probe);
+
+  nll::receiver::Config config;
+  config.control_port = ntohs(address.sin_port);
+  nll::receiver::ControlServer server(config, -1);
+  ASSERT_FALSE(server.failed());
+  nll::receiver::Stats stats;
+  stats.datagrams_received = 12;
+  stats.valid_packets = 11;
+  nll::SequenceTracker sequences;
+  for (const std::uint64_t sequence : {0U, 1U, 2U, 4U}) sequences.observe(sequence, sequence);
+  server.publish_ingress(stats, sequences);
+  nll::receiver::ProcessingStats processing;
+  processing.processed_packets = 9;
+  processing.latency_sum_ns = 900;
+  server.publish_processing(processing);
+
+  nll::control::Client client(address);
+  ASSERT_TRUE(client.valid());
+  const auto reply = client.snapshot();
+  ASSERT_TRUE(reply.has_value());
+  EXPECT_EQ(reply->datagrams_received, 12U);
+  EXPECT_EQ(reply->valid_packets, 11U);
+  EXPECT_EQ(reply->unique_valid_packets, 4U);
+  EXPECT_EQ(reply->receive_sequence_gaps, 1U);
+  EXPECT_EQ(reply->processed_packets, 9U);
+  EXPECT_EQ(reply->processing_latency_sum_ns, 900U);
+  EXPECT_EQ(server.stop(), 1U);
+}
+
+TEST(TxTimestamps, CollectorJoinsKernelStampsBySequence) {
+  const int receiver = ::socket(AF_INET, SOCK_DGRAM, 0);
+  const int sender = ::socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(receiver, 0);
+  ASSERT_GE(sender, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(::bind(receiver, reinterpret_cast<sockaddr *>(&address), sizeof(address)), 0);
+  socklen_t length = sizeof(address);
+  ASSERT_EQ(::getsockname(receiver, reinterpret_cast<sockaddr *>(&address), &length), 0);
+  ASSERT_EQ(::connect(sender, reinterpret_cast<sockaddr *>(&address), sizeof(address)), 0);
+  ASSERT_TRUE(nll::sender::enable_tx_timestamps(sender));
+
+  nll::sender::TxTimestampCollector collector(1);
+  collector.attach(0, sender);
+  // Keys follow submission order; sequences deliberately do not.
+  std::vector<std::vector<nll::sender::TxSubmission>> submissions(1);
+  for (const std::uint64_t sequence : {7U, 3U, 5U}) {
+    const auto user_ns = nll::stamp_real_ns();
+    ASSERT_EQ(::send(sender, &sequence, sizeof(sequence), 0),
+              static_cast<ssize_t>(sizeof(sequence)));
+    submissions[0].push_back({sequence, user_ns});
+  }
+  collector.finish();
+  ::close(receiver);
+
+  const auto path = std::filesystem::temp_directory_path() / "nll_tx_timestamps_test.csv";
+  nll::sender::TxLogSummary summary;
+  ASSERT_TRUE(nll::sender::write_tx_log(path, submissions, {0}, collector.stamps(), summary));
+  EXPECT_EQ(summary.records, 3U);
+  EXPECT_EQ(summary.sched_stamps, 3U);
+  EXPECT_EQ(summary.software_stamps, 3U);
+  EXPECT_EQ(summary.unmatched_stamps, 0U);
+
+  std::ifstream log(path);
+  std::string line;
+  std::getline(log, line);
+  EXPECT_EQ(line, "sequence,thread_index,user_send_real_ns,sched_real_ns,software_real_ns");
+  std::vector<std::uint64_t> sequences;
+  while (std::getline(log, line)) {
+    unsigned long long sequence = 0, user_ns = 0, sched_ns = 0, software_ns = 0;
+    unsigned thread = 0;
+    ASSERT_EQ(std::sscanf(line.c_str(), "%llu,%u,%llu,%llu,%llu", &sequence, &thread,
+                          &user_ns, &sched_ns, &software_ns), 5);
+    EXPECT_EQ(thread, 0U);
+    EXPECT_LE(user_ns, sched_ns);
+    EXPECT_LE(sched_ns, software_ns);
+    sequences.push_back(sequence);
+  }
+  EXPECT_EQ(sequences, (std::vector<std::uint64_t>{3, 5, 7}));
+  std::filesystem::remove(path);
+}
+
+// Builds a throwaway sys/ and proc/ tree for placement discovery.
+class FakeHostTree {
+public:
+  FakeHostTree()
+      : root_(std::filesystem::temp_directory_path() /
+              ("nll_placement_" + std::to_string(::getpid()) + "_" + std::to_string(counter_++))) {}
+  ~FakeHostTree() { std::filesystem::remove_all(root_); }
+
+  void write(const std::string &relative, const std::string &content) {
+    const auto path = root_ / relative;
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream(path) << content << '\n';
+  }
+  void cpu(int id, int core, const std::string &siblings, const std::string &l2,
+           const std::string &llc) {
+    const auto base = "sys/devices/system/cpu/cpu" + std::to_string(id);
+    write(base + "/topology/physical_package_id", "0");
+    write(base + "/topology/core_id", std::to_string(core));
+    write(base + "/topology/thread_siblings_list", siblings);
+    write(base + "/cache/index0/level", "1");
+    write(base + "/cache/index0/type", "Data");
+    write(base + "/cache/index0/shared_cpu_list", siblings);
+    write(base + "/cache/index1/level", "1");
+    write(base + "/cache/index1/type", "Instruction");
+    write(base + "/cache/index1/shared_cpu_list", siblings);
+    write(base + "/cache/index2/level", "2");
+    write(base + "/cache/index2/type", "Unified");
+    write(base + "/cache/index2/shared_cpu_list", l2);
+    if (llc.empty()) return;
+    write(base + "/cache/index3/level", "3");
+    write(base + "/cache/index3/type", "Unified");
+    write(base + "/cache/index3/shared_cpu_list", llc);
+  }
+  [[nodiscard]] const std::filesystem::path &root() const noexcept { return root_; }
+
+private:
+  static inline int counter_ = 0;
+  std::filesystem::path root_;
+};
+
+TEST(CpuPlacement, ParsesSysfsListsAndMasks) {
+  EXPECT_EQ(nll::placement::parse_cpu_list("0-3,8,10-11\n"),
+            (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_FALSE(nll::placement::parse_cpu_list("3-1"));
+  EXPECT_FALSE(nll::placement::parse_cpu_list("a"));
+  EXPECT_EQ(nll::placement::parse_cpu_mask("00000001,0000000a"),
+            (std::vector<int>{1, 3, 32}));
+  EXPECT_EQ(nll::placement::parse_cpu_mask("00000000"), std::vector<int>{});
+  EXPECT_FALSE(nll::placement::parse_cpu_mask("0x1"));
+}
+
+TEST(CpuPlacement, SmtHostKeepsRolesOnSeparateCoresAroundTheBusiestIrq) {
+  // Four cores with two threads each, one L2 per core, one shared L3. The NIC
+  // IRQ is spread over every CPU but has been serviced mostly on CPU 2.
+  FakeHostTree tree;
+  tree.write("sys/devices/system/cpu/online", "0-7");
+  for (int id = 0; id < 8; ++id) {
+    const auto pair = std::to_string(id % 4) + "," + std::to_string(id % 4 + 4);
+    tree.cpu(id, id % 4, pair, pair, "0-7");
+  }
+  tree.write("sys/devices/system/node/node0/cpulist", "0-7");
+  tree.write("sys/class/net/eth0/queues/rx-0/rps_cpus", "00");
+  tree.write("sys/class/net/eth0/queues/tx-0/xps_cpus", "0f");
+  tree.write("proc/interrupts",
+             "           CPU0       CPU1       CPU2       CPU3       CPU4       CPU5       CPU6       CPU7\n"
+             " 130:         10          0       9000          0          0          0          0          0  PCI-MSI 524288-edge      eth0-TxRx-0\n"
+             " 131:          0          0          0       50000          0          0          0          0  PCI-MSI 524289-edge      eth01\n"
+             "NMI:          0          0          0          0          0          0          0          0   Non-maskable interrupts");
+  tree.write("proc/irq/130/smp_affinity_list", "0-7");
+
+  const auto topology = nll::placement::discover(tree.root(), "eth0");
+  ASSERT_EQ(topology.cpus.size(), 8U);
+  EXPECT_EQ(topology.cpus[6].smt_siblings, (std::vector<int>{2, 6}));
+  EXPECT_EQ(topology.cpus[6].l2_shared, (std::vector<int>{2, 6}));
+  EXPECT_EQ(topology.cpus[6].llc_shared.size(), 8U);
+  ASSERT_TRUE(topology.nic);
+  EXPECT_EQ(topology.nic->irqs, std::vector<int>{130});
+  EXPECT_EQ(topology.nic->busiest_cpus, (std::vector<int>{2, 0}));
+  EXPECT_EQ(topology.nic->xps_cpus, (std::vector<int>{0, 1, 2, 3}));
+
+  const auto plan = nll::placement::plan(topology, {.receiver = true, .worker = true,
+                                                    .sender_threads = 2});
+  EXPECT_EQ(plan.irq_cpu, 2);
+  EXPECT_EQ(plan.ingress_cpu, 6);  // the IRQ core's SMT sibling shares its L2
+  EXPECT_EQ(plan.worker_cpu, 0);   // another physical core behind the same L3
+  EXPECT_EQ(plan.sender_cpus, (std::vector<int>{1, 3}));
+  EXPECT_TRUE(plan.notes.empty());
+}
+
+TEST(CpuPlacement, SharedL2HostReportsTheSenderItCouldNotIsolate) {
+  // Raspberry Pi 4: four cores, no SMT, one L2 shared by all, no L3. The IRQ
+  // is pinned to CPU 0 and RPS steers protocol work to CPU 1.
+  FakeHostTree tree;
+  tree.write("sys/devices/system/cpu/online", "0-3");
+  for (int id = 0; id < 4; ++id) tree.cpu(id, id, std::to_string(id), "0-3", "");
+  tree.write("sys/class/net/eth0/queues/rx-0/rps_cpus", "0");
+  tree.write("proc/interrupts",
+             "           CPU0       CPU1       CPU2       CPU3\n"
+             "  40:    123456          0          0          0     GICv2 189 Level     eth0\n");
+  tree.write("proc/irq/40/effective_affinity_list", "0");
+
+  auto topology = nll::placement::discover(tree.root(), "eth0");
+  EXPECT_EQ(topology.cpus[0].llc_shared, (std::vector<int>{0, 1, 2, 3}));
+  auto plan = nll::placement::plan(topology, {.receiver = true, .worker = true,
+                                              .sender_threads = 1});
+  EXPECT_EQ(plan.irq_cpu, 0);
+  EXPECT_EQ(plan.ingress_cpu, 1);
+  EXPECT_EQ(plan.worker_cpu, 2);
+  EXPECT_EQ(plan.sender_cpus, std::vector<int>{3});
+  EXPECT_EQ(plan.notes, std::vector<std::string>{"sender shares L2 with the receiver"});
+
+  tree.write("sys/class/net/eth0/queues/rx-0/rps_cpus", "2");
+  topology = nll::placement::discover(tree.root(), "eth0");
+  plan = nll::placement::plan(topology, {.receiver = true, .worker = false,
+                                         .sender_threads = 0});
+  EXPECT_EQ(plan.irq_cpu, 1);
+  EXPECT_EQ(plan.ingress_cpu, 0);
+  EXPECT_FALSE(nll::placement::discover_nic(tree.root(), "eth1"));
+}
+
+TEST(Arena, PrefaultedAllocationsTakeNoFaultsWhenTouched) {
+  for (const auto policy : {nll::memory::PagePolicy::automatic, nll::memory::PagePolicy::normal}) {
+    constexpr std::size_t slab = 3U << 20;
+    nll::memory::Arena arena(nll::memory::bytes_for<std::byte>(slab) +
+                             nll::memory::bytes_for<std::uint64_t>(7), policy);
+    const auto &report = arena.report();
+    EXPECT_EQ(report.requested, policy);
+    if (policy == nll::memory::PagePolicy::normal) {
+      EXPECT_EQ(report.backing, nll::memory::PagePolicy::normal);
+    }
+    EXPECT_EQ(report.mapped_bytes % nll::memory::huge_page_bytes, 0U);
+    const auto bytes = arena.make_array<std::byte>(slab);
+    const auto words = arena.make_array<std::uint64_t>(7);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(words.data()) % alignof(std::uint64_t), 0U);
+    EXPECT_EQ(words[6], 0U);
+
+    nll::memory::FaultCounter faults(RUSAGE_THREAD);
+    faults.start();
+    for (std::size_t offset = 0; offset < bytes.size(); offset += 4096) bytes[offset] = std::byte{1};
+    EXPECT_EQ(faults.stop().minor, 0U) << nll::memory::page_policy_name(report.backing);
+    EXPECT_THROW(static_cast<void>(arena.allocate(report.mapped_bytes, 1)), std::bad_alloc);
+  }
+}
+
+TEST(Arena, DestroysNonTrivialObjectsInReverseOrder) {
+  std::vector<int> destroyed;
+  struct Probe {
+    std::vector<int> *log;
+    int id;
+    ~Probe() { log->push_back(id); }
+  };
+  {
+    nll::memory::Arena arena(2 * nll::memory::bytes_for<Probe>(), nll::memory::PagePolicy::normal);
+    arena.make<Probe>(&destroyed, 1);
+    arena.make<Probe>(&destroyed, 2);
+  }
+  EXPECT_EQ(destroyed, (std::vector<int>{2, 1}));
+}
+
 } // namespace
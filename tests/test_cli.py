@@ -11,16 +11,40 @@ def test_receiver_help_and_work_aliases(binaries, name):
     help_result = subprocess.run([binary, "--help"], capture_output=True, text=True)
     assert help_result.returncode == 0
     assert "--work" in help_result.stdout and "-W" in help_result.stdout
+    assert "--telemetry" in help_result.stdout
+    assert "--timeseries" in help_result.stdout and "--interval-ms" in help_result.stdout
+    assert "--clock" in help_result.stdout and "--perf-counters" in help_result.stdout
+    assert "--work-model" in help_result.stdout and "--working-set" in help_result.stdout
+    assert "--verify-crc" in help_result.stdout and "--no-packet-stamps" in help_result.stdout
+    assert "--hugepages" in help_result.stdout and "--control" in help_result.stdout
+    assert "--per-source" in help_result.stdout and "--kernel-drops" in help_result.stdout
+    assert "--meminfo-us" in help_result.stdout and "--clock-log" in help_result.stdout
+    assert "--capture" in help_result.stdout and "--capture-snaplen" in help_result.stdout
     assert subprocess.run([binary, "--work", "1", "--help"], capture_output=True).returncode == 0
     assert subprocess.run([binary, "-W", "1", "--help"], capture_output=True).returncode == 0
 
 
 @pytest.mark.parametrize("name", ["receiver_baseline", "receiver_batched", "receiver_threaded"])
-@pytest.mark.parametrize("arguments", [["--work"], ["--work", "bad"], ["--work", "-1"]])
+@pytest.mark.parametrize("arguments", [["--work"], ["--work", "bad"], ["--work", "-1"],
+                                       ["--hugepages", "gigantic"], ["--control", "49200"],
+                                       ["--per-source", "0"], ["--per-source", "65537"],
+                                       ["--meminfo-us", "0"], ["--meminfo-us", "1000001"],
+                                       ["--capture-snaplen", "63"], ["--capture-every", "0"]])
 def test_receiver_rejects_missing_or_invalid_work(binaries, name, arguments):
     assert subprocess.run([binaries[name], *arguments], capture_output=True).returncode != 0
 
 
+def test_engine_front_end_selects_ingress_and_topology(binaries):
+    result = subprocess.run([binaries["receiver"], "--help"], capture_output=True, text=True)
+    assert result.returncode == 0
+    for option in ("--ingress", "--topology", "--batch", "--worker-cpu"):
+        assert option in result.stdout
+    for arguments in (["--ingress", "epoll"], ["--topology", "ring"]):
+        assert subprocess.run([binaries["receiver"], *arguments], capture_output=True).returncode == 2
+    threaded = subprocess.run([binaries["receiver_threaded"], "--help"], capture_output=True, text=True).stdout
+    assert "--ingress" not in threaded and "--topology" not in threaded
+
+
 def test_variant_help_only_exposes_relevant_options(binaries):
     baseline = subprocess.run([binaries["receiver_baseline"], "--help"], capture_output=True, text=True).stdout
     batched = subprocess.run([binaries["receiver_batched"], "--help"], capture_output=True, text=True).stdout
@@ -40,7 +64,28 @@ def test_variant_help_only_exposes_relevant_options(binaries):
                                          ["--threads", "0"],
                                          ["--threads", "2"],
                                          ["--threads", "2", "--cpus", "0"],
-                                         ["--cpus", "0,0"]])
+                                         ["--cpus", "0,0"],
+                                         ["--payload-pattern", "1", "--payload-size", "16"],
+                                         ["--flows", "0"],
+                                         ["--flows", "1", "--threads", "2", "--cpus", "0,1"],
+                                         ["--flows", "2", "--source-port", "65535"],
+                                         ["--flow-tag"],
+                                         ["--flows", "1", "--flow-tag", "--payload-size", "16"],
+                                         ["--capacity-search"],
+                                         ["--control", "49201"],
+                                         ["--capacity-search", "--control", "49201", "--mode", "flood"],
+                                         ["--capacity-search", "--control", "49201", "--search-min", "2000"],
+                                         ["--capacity-search", "--control", "49201", "--search-loss", "1.5"],
+                                         ["--header-version", "3"],
+                                         ["--header-version", "2", "--payload-size", "16"],
+                                         ["--rate-profile", "ramp:1000"],
+                                         ["--rate-profile", "step:0:0:0.5"],
+                                         ["--rate-profile", "ramp:1000:2000", "--mode", "burst"],
+                                         ["--clock-sync", "0"], ["--clock-sync", "1001"],
+                                         ["--capacity-search", "--control", "49201", "--clock-sync", "10"],
+                                         ["--replay", "/nonexistent/trace.pcap"], ["--replay-loop"],
+                                         ["--replay", "/dev/null", "--mode", "flood"],
+                                         ["--replay", "/dev/null", "--replay-speed", "0"]])
 def test_sender_validation(binaries, arguments):
     assert subprocess.run([binaries["sender"], *arguments], capture_output=True).returncode != 0
 
@@ -49,5 +94,9 @@ def test_sender_help_exposes_batch_flood_trace_and_thread_controls(binaries):
     result = subprocess.run([binaries["sender"], "--help"], capture_output=True, text=True)
     assert result.returncode == 0
     for option in ("flood", "--send-batch-max", "--batch-window-us", "--threads",
-                   "--cpus", "--pacing-trace"):
+                   "--cpus", "--pacing-trace", "--telemetry", "--clock", "--perf-counters",
+                   "--payload-pattern", "--tx-timestamps", "--hugepages", "--flows",
+                   "--source-port", "--flow-tag", "--capacity-search", "--control",
+                   "--search-min", "--search-loss", "--search-precision", "--header-version",
+                   "--rate-profile", "--clock-sync", "--replay", "--replay-speed", "--replay-loop"):
         assert option in result.stdout
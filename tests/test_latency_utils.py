@@ -7,7 +7,8 @@ import pandas as pd
 import pytest
 
 from latency_utils import (HEADER_FORMAT, LEGACY_FORMAT, LOG_MAGIC, VERSIONED_FORMAT,
-                           load_binary_file, remove_clock_drift, sequence_statistics)
+                           apply_clock_log, load_binary_file, load_clock_log,
+                           remove_clock_drift, sequence_statistics)
 
 
 def test_loads_legacy_log_and_derives_metrics(tmp_path):
@@ -134,3 +135,19 @@ def test_header_only_trace_loads_as_an_empty_frame(tmp_path):
     frame = load_binary_file(path)
     assert frame.empty
     assert "receive_latency_us" in frame.columns
+
+
+def test_clock_log_offsets_are_interpolated_and_removed(tmp_path):
+    path = tmp_path / "clock.csv"
+    path.write_text("# clock-v1: offset is receiver minus sender CLOCK_REALTIME\n"
+                    "round,completed_mono_ns,t1_sender_unix_ns,t2_receiver_unix_ns,t3_receiver_unix_ns,"
+                    "t4_sender_unix_ns,offset_ns,delay_ns,estimated_offset_ns,drift_ppb,rounds_used\n"
+                    "2,0,0,2000,0,0,0,10,3000,0,2\n"
+                    "1,0,0,1000,0,0,0,10,1000,0,1\n")
+    clock = load_clock_log(path)
+    assert clock.t2_receiver_unix_ns.tolist() == [1000, 2000]
+    frame = pd.DataFrame({"rx_ns": [500, 1500, 2500], "receive_latency_ns": [5000, 5000, 5000]})
+    synced = apply_clock_log(frame, clock)
+    assert synced.clock_offset_ns.tolist() == [1000, 2000, 3000]
+    assert synced.receive_latency_synced_ns.tolist() == [4000, 3000, 2000]
+    assert apply_clock_log(frame, clock.iloc[0:0]).receive_latency_synced_ns.isna().all()
@@ -1,5 +1,6 @@
 from __future__ import annotations
 
+import csv
 import json
 import os
 import signal
@@ -40,12 +41,13 @@ def wait_for_udp_bind(process: subprocess.Popen, port: int, timeout: float = 3.0
 
 
 def run_receiver(binary, tmp_path, count: int, work: int = 0, batch: int = 8,
-                 shutdown_with_signal: bool = False):
+                 shutdown_with_signal: bool = False, extra: tuple[str, ...] = ()):
     port = free_port(); trace = tmp_path / f"{binary.name}_{work}.bin"; stats = tmp_path / f"{binary.name}_{work}.json"
     command = [binary, "--port", str(port), "--output", trace, "--stats", stats,
                "--max-packets", "0" if shutdown_with_signal else str(count),
                "--work", str(work)]
     if binary.name != "receiver_baseline": command += ["--batch", str(batch)]
+    command += extra
     process = subprocess.Popen(command, stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True)
     try:
         wait_for_udp_bind(process, port)
@@ -73,6 +75,7 @@ def test_known_count_timestamp_order_and_stats(binaries, tmp_path, name):
     assert stats["unique_valid_packets"] == stats["unique_processed_packets"] == 64
     assert stats["receive_sequence_gaps"] == stats["receive_duplicates"] == 0
     assert stats["short_packets"] == stats["invalid_magic"] == stats["unsupported_version"] == stats["spsc_overflow"] == 0
+    assert stats["receive_loss_bursts"] == {"events_recorded": 0, "burst_length_histogram": {}, "events": []}
     assert (frame.rx_ns >= frame.tx_ns).all()
     assert (frame.processing_start_ns >= frame.rx_ns).all()
     assert (frame.processing_finish_ns >= frame.processing_start_ns).all()
@@ -88,6 +91,17 @@ def test_work_increases_recorded_processing_time(binaries, tmp_path, name):
     assert worked.processing_time_ns.median() > zero.processing_time_ns.median() + 100_000
 
 
+@pytest.mark.parametrize("ingress", ["recvfrom", "recvmmsg"])
+@pytest.mark.parametrize("topology", ["inline", "spsc"])
+def test_engine_reaches_every_ingress_and_topology(binaries, tmp_path, ingress, topology):
+    frame, stats = run_receiver(binaries["receiver"], tmp_path, 64,
+                                extra=("--ingress", ingress, "--topology", topology))
+    assert (stats["ingress"], stats["topology"]) == (ingress, topology)
+    assert stats["datagrams_received"] == 64
+    assert stats["valid_packets"] == stats["processed_packets"] == len(frame) == 64
+    assert ("worker_affinity" in stats) == (topology == "spsc")
+
+
 def test_threaded_receive_timestamp_survives_queue_backlog(binaries, tmp_path):
     frame, stats = run_receiver(binaries["receiver_threaded"], tmp_path, 500,
                                 work=200_000, batch=64, shutdown_with_signal=True)
@@ -209,6 +223,60 @@ def test_spsc_pressure_is_reported_separately(binaries, tmp_path):
     assert stats["processed_packets"] + stats["spsc_overflow"] == stats["valid_packets"]
 
 
+@pytest.mark.parametrize("name", ["receiver_baseline", "receiver_threaded"])
+def test_receiver_captures_every_nth_datagram_to_pcapng(binaries, tmp_path, name):
+    capture = tmp_path / f"{name}.pcapng"
+    _, stats = run_receiver(binaries[name], tmp_path, 40,
+                            extra=("--capture", str(capture), "--capture-every", "2"))
+    assert stats["capture"]["captured"] == 20 and stats["capture"]["dropped"] == 0
+    assert stats["capture"]["bytes_written"] == capture.stat().st_size
+    data = capture.read_bytes(); position = 0; packets = []
+    while position < len(data):
+        block_type, length = struct.unpack_from("<II", data, position)
+        if block_type == 6:
+            captured = struct.unpack_from("<I", data, position + 20)[0]
+            packets.append(data[position + 28:position + 28 + captured])
+        position += length
+    assert position == len(data) and len(packets) == 20
+    # IPv4 and UDP headers from 127.0.0.1, then the datagram itself.
+    assert all(len(value) == 28 + 64 and value[12:16] == bytes([127, 0, 0, 1]) for value in packets)
+    assert [struct.unpack("!HBBIQ", value[28:44])[3] for value in packets] == list(range(1, 40, 2))
+
+
+def test_receiver_answers_clock_probes_outside_sequence_accounting(binaries, tmp_path):
+    port = free_port(); clock_log = tmp_path / "clock.csv"; stats_path = tmp_path / "clock.json"
+    process = subprocess.Popen([binaries["receiver_batched"], "--port", str(port),
+        "--output", tmp_path / "clock.bin", "--stats", stats_path, "--batch", "8",
+        "--max-packets", "0", "--clock-log", clock_log])
+    wait_for_udp_bind(process, port)
+    exchange = "!IIQQQ"
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as prober:
+        prober.settimeout(2)
+        previous_return = 0
+        for round_number in (1, 2, 3):
+            t1 = time.time_ns()
+            probe = struct.pack("!HBBIQ", 0x6584, 1, 1, round_number, t1)
+            prober.sendto(probe + struct.pack(exchange, round_number - 1, 0, 0, 0, previous_return),
+                          ("127.0.0.1", port))
+            reply = prober.recv(64)
+            previous_return = time.time_ns()
+            magic, version, msg_type, sequence, t3 = struct.unpack_from("!HBBIQ", reply)
+            _, _, origin, t2, _ = struct.unpack_from(exchange, reply, 16)
+            assert (magic, version, msg_type, sequence, origin) == (0x6584, 1, 2, round_number, t1)
+            assert t1 <= t2 <= t3 <= previous_return
+        prober.sendto(packet(0), ("127.0.0.1", port))
+    time.sleep(0.2); process.send_signal(signal.SIGINT); process.wait(timeout=8)
+    stats = json.loads(stats_path.read_text())
+    assert process.returncode == 0
+    assert stats["valid_packets"] == 1 and stats["receive_sequence_gaps"] == 0
+    assert stats["clock_sync"]["probes"] == stats["clock_sync"]["replies"] == 3
+    # Rounds 1 and 2 complete when the following probe brings back their t4.
+    assert stats["clock_sync"]["rounds"] == 2
+    rows = [line for line in clock_log.read_text().splitlines() if line[0].isdigit()]
+    assert [int(row.split(",")[0]) for row in rows] == [1, 2]
+    assert all(abs(int(row.split(",")[6])) < 50_000_000 for row in rows)
+
+
 def test_sender_stats_payload_sequence_steady_and_burst(binaries, tmp_path):
     for mode, burst in (("steady", 1), ("burst", 5)):
         port = free_port(); received = []; stop = threading.Event()
@@ -240,15 +308,19 @@ def test_sender_can_disable_timestamp_clock_reads(binaries, tmp_path):
     with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as server:
         server.bind(("127.0.0.1", port)); server.settimeout(1)
         stats_path = tmp_path / "sender_no_timestamps.json"
+        tx_path = tmp_path / "tx.csv"
         process = subprocess.Popen([binaries["sender"], "--ip", "127.0.0.1",
             "--port", str(port), "--rate", "100", "--duration", ".03",
-            "--timestamp-every", "0", "--stats", stats_path])
+            "--timestamp-every", "0", "--tx-timestamps", tx_path, "--stats", stats_path])
         while process.poll() is None:
             try: received.append(server.recvfrom(65535)[0])
             except TimeoutError: pass
         process.wait()
     assert process.returncode == 0 and received
     assert all(struct.unpack("!HBBIQ", value[:16])[4] == 0 for value in received)
+    # The TX log keeps the user-space send time the header went without.
+    rows = list(csv.DictReader(tx_path.read_text().splitlines()))
+    assert rows and all(int(row["user_send_real_ns"]) > 0 for row in rows)
 
 
 def test_sender_failures_are_counted(binaries, tmp_path):
@@ -301,6 +373,49 @@ def test_sender_sendmmsg_batches_preserve_payload_sequence_and_sampling(
                for sequence, timestamp in zip(sequences, timestamps))
 
 
+def test_sender_replays_capture_sizes_and_gaps(binaries, tmp_path):
+    # Three bursts of four datagrams, 20 ms apart, as a microsecond pcap over Ethernet.
+    sizes = [40, 200, 1200, 16] * 3
+    capture = tmp_path / "bursts.pcap"
+    with capture.open("wb") as output:
+        output.write(struct.pack("<IHHiIII", 0xa1b2c3d4, 2, 4, 0, 0, 96, 1))
+        for index, size in enumerate(sizes):
+            microseconds = index // 4 * 20_000 + index % 4 * 5
+            ip = struct.pack("!BBHHHBBH4s4s", 0x45, 0, 28 + size, 0, 0, 64, 17, 0,
+                             bytes(4), bytes(4)) + struct.pack("!HHHH", 1, 2, 8 + size, 0)
+            frame = bytes(12) + b"\x08\x00" + ip
+            output.write(struct.pack("<IIII", 1, microseconds, len(frame), len(frame) + size))
+            output.write(frame)
+    port = free_port(); received = []; stop = threading.Event()
+    def receive():
+        with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as server:
+            server.bind(("127.0.0.1", port)); server.settimeout(.02)
+            while not stop.is_set():
+                try: received.append(server.recvfrom(65535)[0])
+                except TimeoutError: pass
+    thread = threading.Thread(target=receive); thread.start()
+    stats_path = tmp_path / "replay.json"
+    trace_path = tmp_path / "replay.csv"
+    result = subprocess.run([
+        binaries["sender"], "--ip", "127.0.0.1", "--port", str(port), "--replay", capture,
+        "--duration", "1", "--send-batch-max", "8", "--batch-window-us", "50",
+        "--header-version", "2", "--pacing-trace", trace_path,
+        "--stats", stats_path], capture_output=True, timeout=3)
+    time.sleep(.05); stop.set(); thread.join()
+    assert result.returncode == 0, result.stderr
+    stats = json.loads(stats_path.read_text())
+    replay = stats["replay"]
+    assert replay["format"] == "pcap" and replay["trace_packets"] == 12
+    assert replay["planned_packets"] == 12 and replay["padded_packets"] == 3
+    # Each burst leaves in one sendmmsg; the 16-byte datagrams grow to the v2 header.
+    assert stats["effective_batch_size_histogram"] == {"4": 3}
+    assert stats["successful_bytes"] == sum(max(size, 24) for size in sizes)
+    assert [len(payload) for payload in received] == [max(size, 24) for size in sizes]
+    assert [struct.unpack("!HBBIQ", payload[:16])[3] for payload in received] == list(range(12))
+    scheduled = [int(line.split(",")[1]) for line in trace_path.read_text().splitlines()[1:]]
+    assert [later - earlier for earlier, later in zip(scheduled, scheduled[1:])] == [20_000_000] * 2
+
+
 def test_sender_flood_mode_and_two_worker_sequences(binaries, tmp_path):
     allowed = sorted(os.sched_getaffinity(0))
     if len(allowed) < 2: